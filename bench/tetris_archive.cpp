@@ -0,0 +1,225 @@
+// Builds, inspects and checks replay archives.
+//
+//   tetris_archive generate out.tarc [--games 100] [--seed 1] [--pieces 500]
+//                  [--interval 32]
+//       records autoplayer games, seeds seed, seed + 1, ...
+//   tetris_archive convert out.tarc [--interval 32] replay.trpl...
+//       re-simulates replay files into one archive
+//   tetris_archive seek in.tarc game piece
+//       prints the state of a game at the start of a piece
+//   tetris_archive verify in.tarc [--samples 4]
+//       seeks to random pieces of every game, plays each to the end and
+//       checks the final state, reporting the time per seek
+
+#include "archive.h"
+#include "autoplayer.h"
+#include "logger.h"
+#include "replay.h"
+#include "simulation.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kGridWidth{10};
+constexpr int kGridHeight{20};
+
+// parses a whole decimal number that fits the value's type, returns false on
+// anything else
+template <typename T> bool ParseNumber(const std::string &text, T &value) {
+  char *end = nullptr;
+  errno = 0;
+  long long parsed = std::strtoll(text.c_str(), &end, 10);
+  if (end == text.c_str() or *end != '\0' or errno != 0 or
+      parsed < std::numeric_limits<T>::min() or
+      parsed > std::numeric_limits<T>::max())
+    return false;
+  value = static_cast<T>(parsed);
+  return true;
+}
+
+// reads the value of a "--name value" option, the value keeps its default if
+// the option is missing. Returns false and prints why if it is no number
+template <typename T>
+bool GetOption(std::vector<std::string> &args, const std::string &name,
+               T &value) {
+  for (std::size_t i = 0; i + 1 < args.size(); i++) {
+    if (args[i] == name) {
+      std::string text = args[i + 1];
+      args.erase(args.begin() + i, args.begin() + i + 2);
+      if (ParseNumber(text, value))
+        return true;
+      std::cerr << name << " takes a whole number, not " << text << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+int Generate(const std::string &path, std::vector<std::string> &args) {
+  int games{100};
+  std::uint32_t seed{1};
+  std::int64_t pieces{500};
+  int interval{32};
+  if (!GetOption(args, "--games", games) or
+      !GetOption(args, "--seed", seed) or
+      !GetOption(args, "--pieces", pieces) or
+      !GetOption(args, "--interval", interval))
+    return 1;
+  ArchiveWriter writer(interval);
+  if (!writer.Open(path))
+    return 1;
+  AutoPlayer::Config config;
+  config.timeBudgetUs = 0;
+  config.threads = 1;
+  for (int g = 0; g < games; g++) {
+    Simulation simulation(kGridWidth, kGridHeight, seed + g);
+    AutoPlayer player(config);
+    std::vector<Input> inputs;
+    std::size_t next = 0;
+    writer.BeginGame(simulation);
+    while (!simulation.IsGameOver() and
+           static_cast<std::int64_t>(simulation.GetPieceCount()) <= pieces) {
+      player.HandleInput(simulation, inputs);
+      Input input = next < inputs.size() ? inputs[next++] : Input{};
+      writer.Record(simulation, input);
+      simulation.Step(input);
+    }
+    writer.EndGame(simulation);
+  }
+  return writer.Close() ? 0 : 1;
+}
+
+int Convert(const std::string &path, std::vector<std::string> &args) {
+  int interval{32};
+  if (!GetOption(args, "--interval", interval))
+    return 1;
+  ArchiveWriter writer(interval);
+  if (!writer.Open(path))
+    return 1;
+  int failed = 0;
+  for (const std::string &replayPath : args) {
+    Replay replay;
+    if (!Replay::Load(replayPath, replay)) {
+      std::cerr << replayPath << ": cannot be read\n";
+      failed++;
+      continue;
+    }
+    Simulation simulation(replay.width, replay.height, replay.seed);
+    ReplayPlayer player(replay);
+    writer.BeginGame(simulation);
+    while (!player.IsDone(simulation)) {
+      Input input = player.GetInput(simulation.GetTick());
+      writer.Record(simulation, input);
+      simulation.Step(input);
+    }
+    writer.EndGame(simulation);
+  }
+  return writer.Close() and failed == 0 ? 0 : 1;
+}
+
+int Seek(const ArchiveReader &reader, int game, std::uint64_t piece) {
+  ArchiveReader::Cursor cursor;
+  Clock::time_point start = Clock::now();
+  std::unique_ptr<Simulation> simulation = reader.Seek(game, piece, cursor);
+  double us =
+      std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+  if (!simulation) {
+    std::cerr << "game " << game << " has no piece " << piece << "\n";
+    return 1;
+  }
+  const Field &field = simulation->GetField();
+  std::cout << "game " << game << " piece " << piece << " ("
+            << simulation->GetPiece().GetName() << "): tick "
+            << simulation->GetTick() << ", score " << simulation->GetScore()
+            << ", level " << simulation->GetLevel() << ", found in " << us
+            << " us\n";
+  for (int y = 0; y < field.GetHeight(); y++) {
+    for (int x = 0; x < field.GetWidth(); x++)
+      std::cout << (field.IsOccupied(x, y) ? '#' : '.');
+    std::cout << "\n";
+  }
+  return 0;
+}
+
+int Verify(const ArchiveReader &reader, std::vector<std::string> &args) {
+  int samples{4};
+  if (!GetOption(args, "--samples", samples))
+    return 1;
+  std::mt19937 rng(1);
+  int checked = 0;
+  int failed = 0;
+  double seekUs = 0;
+  for (int g = 0; g < reader.GetGameCount(); g++) {
+    ArchiveReader::GameInfo info = reader.GetGame(g);
+    for (int s = 0; s < samples; s++) {
+      std::uint64_t piece = 1 + rng() % info.pieces;
+      ArchiveReader::Cursor cursor;
+      Clock::time_point start = Clock::now();
+      std::unique_ptr<Simulation> simulation = reader.Seek(g, piece, cursor);
+      seekUs += std::chrono::duration<double, std::micro>(Clock::now() -
+                                                          start)
+                    .count();
+      checked++;
+      if (simulation) {
+        while (!cursor.IsDone(*simulation))
+          simulation->Step(cursor.GetInput(simulation->GetTick()));
+      }
+      if (!simulation or !cursor.Matches(*simulation)) {
+        std::cout << "game " << g << " from piece " << piece
+                  << " differs from the recording\n";
+        failed++;
+      }
+    }
+  }
+  std::cout << checked - failed << " of " << checked << " seeks in "
+            << reader.GetGameCount() << " games match, "
+            << (checked > 0 ? seekUs / checked : 0) << " us per seek\n";
+  return failed == 0 ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Logger::Instance().SetLevel(LogLevel::kOff);
+  std::vector<std::string> args(argv + 1, argv + argc);
+  if (args.size() >= 2) {
+    std::string command = args[0];
+    std::string path = args[1];
+    args.erase(args.begin(), args.begin() + 2);
+    if (command == "generate")
+      return Generate(path, args);
+    if (command == "convert")
+      return Convert(path, args);
+    ArchiveReader reader;
+    if ((command == "seek" or command == "verify") and !reader.Open(path)) {
+      std::cerr << path << ": not a readable archive\n";
+      return 1;
+    }
+    int game{0};
+    std::int64_t piece{0};
+    if (command == "seek" and args.size() == 2 and
+        ParseNumber(args[0], game) and ParseNumber(args[1], piece) and
+        piece >= 0)
+      return Seek(reader, game, static_cast<std::uint64_t>(piece));
+    if (command == "verify")
+      return Verify(reader, args);
+  }
+  std::cerr << "usage: " << argv[0]
+            << " generate out.tarc [--games 100] [--seed 1] [--pieces 500]"
+               " [--interval 32]\n"
+            << "       " << argv[0]
+            << " convert out.tarc [--interval 32] replay.trpl...\n"
+            << "       " << argv[0] << " seek in.tarc game piece\n"
+            << "       " << argv[0] << " verify in.tarc [--samples 4]\n";
+  return 1;
+}
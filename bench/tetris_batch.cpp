@@ -0,0 +1,321 @@
+// Runs many headless games concurrently and summarizes their results.
+//
+// Every game gets its own seed (the base seed plus the game's index), so a
+// run with the same options always plays the same games, whatever the number
+// of threads. Games are submitted to a work-stealing thread pool and played
+// either by the autoplayer or by a seeded random player:
+//
+//   tetris_batch [--games 1000] [--threads 0] [--seed 1] [--player ai|random]
+//                [--max-pieces 500] [--width 10] [--height 20] [--beam 4]
+//                [--lookahead 1] [--cache 32768] [--kernel avx2|sse2|scalar]
+//                [--out summary.json]
+
+#include "autoplayer.h"
+#include "logger.h"
+#include "simulation.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  int games{1000};
+  int threads{0};
+  std::uint32_t seed{1};
+  std::string player{"ai"};
+  int maxPieces{500};
+  int width{10};
+  int height{20};
+  int beam{4};
+  int lookahead{1};
+  int cache{1 << 15}; // transposition table entries per autoplayer
+  FeatureKernel kernel{GetFeatureKernel()};
+  std::string outPath;
+};
+
+struct GameResult {
+  int score{0};
+  int rowsCleared{0};
+  std::uint64_t pieces{0};
+  std::uint64_t ticks{0};
+  bool gameOver{false};
+  double ms{0}; // wall time to play the game
+  std::uint64_t placements{0}; // autoplayer search counters
+  std::uint64_t cacheHits{0};
+  double searchSeconds{0};
+};
+
+// statistics of one metric over all games
+struct Summary {
+  std::string name;
+  double mean{0};
+  double min{0};
+  double p50{0};
+  double p99{0};
+  double max{0};
+};
+
+constexpr int kRandomInputPeriod{100}; // ticks between random inputs
+
+// plays one game to its end or to the piece limit
+GameResult Play(const Options &options, std::uint32_t seed) {
+  Clock::time_point start = Clock::now();
+  Simulation simulation(options.width, options.height, seed);
+  std::vector<Input> inputs;
+  std::size_t next = 0;
+
+  std::unique_ptr<AutoPlayer> autoPlayer;
+  if (options.player == "ai") {
+    AutoPlayer::Config config;
+    config.beamWidth = options.beam;
+    config.lookahead = options.lookahead;
+    config.timeBudgetUs = 0; // searches every level so games are repeatable
+    config.threads = 1;      // the games already use every core
+    config.cacheEntries = options.cache;
+    config.kernel = options.kernel;
+    autoPlayer = std::make_unique<AutoPlayer>(config);
+  }
+  std::mt19937 rng(seed ^ 0x9e3779b9u);
+  const Action actions[] = {Action::kMoveLeft, Action::kMoveRight,
+                            Action::kRotate, Action::kDrop};
+
+  while (!simulation.IsGameOver() and
+         simulation.GetPieceCount() <
+             static_cast<std::uint64_t>(options.maxPieces)) {
+    if (autoPlayer) {
+      autoPlayer->HandleInput(simulation, inputs);
+    } else if (simulation.GetTick() % kRandomInputPeriod == 0) {
+      inputs.emplace_back();
+      inputs.back().Add(actions[rng() % 4]);
+    }
+    simulation.Step(next < inputs.size() ? inputs[next++] : Input{});
+    if (next == inputs.size()) {
+      inputs.clear();
+      next = 0;
+    }
+  }
+
+  GameResult r;
+  r.score = simulation.GetScore();
+  r.rowsCleared = simulation.GetRowsCleared();
+  r.pieces = simulation.GetPieceCount();
+  r.ticks = simulation.GetTick();
+  r.gameOver = simulation.IsGameOver();
+  r.ms = std::chrono::duration<double, std::milli>(Clock::now() - start)
+             .count();
+  if (autoPlayer) {
+    const AutoPlayer::Stats &stats = autoPlayer->GetStats();
+    r.placements = stats.placements;
+    r.cacheHits = stats.cacheHits;
+    r.searchSeconds = stats.searchSeconds;
+  }
+  return r;
+}
+
+template <typename Get>
+Summary Summarize(const std::string &name,
+                  const std::vector<GameResult> &results, Get &&get) {
+  std::vector<double> values;
+  values.reserve(results.size());
+  for (const GameResult &r : results)
+    values.push_back(static_cast<double>(get(r)));
+  std::sort(values.begin(), values.end());
+  Summary s;
+  s.name = name;
+  if (values.empty())
+    return s;
+  for (double v : values)
+    s.mean += v;
+  s.mean /= values.size();
+  auto percentile = [&](double p) {
+    return values[static_cast<std::size_t>(p / 100 * (values.size() - 1))];
+  };
+  s.min = values.front();
+  s.p50 = percentile(50);
+  s.p99 = percentile(99);
+  s.max = values.back();
+  return s;
+}
+
+// autoplayer counters summed over all games
+struct SearchTotals {
+  std::uint64_t placements{0};
+  std::uint64_t cacheHits{0};
+  double seconds{0};
+  double GetPlacementsPerSecond() const {
+    return seconds > 0 ? placements / seconds : 0;
+  };
+  double GetCacheHitRate() const {
+    return placements > 0 ? static_cast<double>(cacheHits) / placements : 0;
+  };
+};
+
+void WriteJson(std::ostream &out, const Options &options, int threads,
+               double seconds, int gameOvers, const SearchTotals &search,
+               const std::vector<Summary> &summaries) {
+  out << "{\n  \"games\": " << options.games << ", \"threads\": " << threads
+      << ", \"seed\": " << options.seed << ", \"player\": \""
+      << options.player << "\", \"game_overs\": " << gameOvers
+      << ",\n  \"seconds\": " << seconds
+      << ", \"games_per_second\": " << options.games / seconds
+      << ",\n  \"kernel\": \"" << GetFeatureKernelName(options.kernel)
+      << "\", \"cache_entries\": " << options.cache
+      << ", \"placements\": " << search.placements
+      << ", \"placements_per_second\": " << search.GetPlacementsPerSecond()
+      << ", \"cache_hit_rate\": " << search.GetCacheHitRate()
+      << ",\n  \"metrics\": [\n";
+  for (std::size_t i = 0; i < summaries.size(); i++) {
+    const Summary &s = summaries[i];
+    out << "    {\"name\": \"" << s.name << "\", \"mean\": " << s.mean
+        << ", \"min\": " << s.min << ", \"p50\": " << s.p50
+        << ", \"p99\": " << s.p99 << ", \"max\": " << s.max << "}"
+        << (i + 1 < summaries.size() ? ",\n" : "\n");
+  }
+  out << "  ]\n}\n";
+}
+
+// parses a whole decimal number that fits the value's type, returns false on
+// anything else
+template <typename T> bool ParseNumber(const char *text, T &value) {
+  char *end = nullptr;
+  errno = 0;
+  long long parsed = std::strtoll(text, &end, 10);
+  if (end == text or *end != '\0' or errno != 0 or
+      parsed < std::numeric_limits<T>::min() or
+      parsed > std::numeric_limits<T>::max())
+    return false;
+  value = static_cast<T>(parsed);
+  return true;
+}
+
+bool ParseOptions(int argc, char *argv[], Options &options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc)
+      return false;
+    const char *value = argv[++i];
+    bool valid = true;
+    if (arg == "--games") {
+      valid = ParseNumber(value, options.games);
+    } else if (arg == "--threads") {
+      valid = ParseNumber(value, options.threads);
+    } else if (arg == "--seed") {
+      valid = ParseNumber(value, options.seed);
+    } else if (arg == "--player") {
+      options.player = value;
+    } else if (arg == "--max-pieces") {
+      valid = ParseNumber(value, options.maxPieces);
+    } else if (arg == "--width") {
+      valid = ParseNumber(value, options.width);
+    } else if (arg == "--height") {
+      valid = ParseNumber(value, options.height);
+    } else if (arg == "--beam") {
+      valid = ParseNumber(value, options.beam);
+    } else if (arg == "--lookahead") {
+      valid = ParseNumber(value, options.lookahead);
+    } else if (arg == "--cache") {
+      valid = ParseNumber(value, options.cache);
+    } else if (arg == "--kernel") {
+      if (!ParseFeatureKernel(value, options.kernel) or
+          !IsSupported(options.kernel))
+        return false;
+    } else if (arg == "--out") {
+      options.outPath = value;
+    } else {
+      return false;
+    }
+    if (!valid)
+      return false;
+  }
+  return options.games > 0 and options.maxPieces >= 0 and
+         options.width >= Field::kMinWidth and
+         options.width <= Field::kMaxWidth and options.height > 0 and
+         options.height <= Field::kMaxHeight and
+         (options.player == "ai" or options.player == "random");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, options)) {
+    std::cerr << "usage: " << argv[0]
+              << " [--games 1000] [--threads 0] [--seed 1]"
+                 " [--player ai|random] [--max-pieces 500] [--width 10]"
+                 " [--height 20] [--beam 4] [--lookahead 1]"
+                 " [--cache 32768] [--kernel avx2|sse2|scalar]"
+                 " [--out summary.json]\n";
+    return 1;
+  }
+  Logger::Instance().SetLevel(LogLevel::kOff);
+
+  std::vector<GameResult> results(options.games);
+  Clock::time_point start = Clock::now();
+  int threads;
+  {
+    ThreadPool pool(options.threads);
+    threads = pool.GetThreads();
+    for (int i = 0; i < options.games; i++) {
+      pool.Submit([&options, &results, i] {
+        results[i] =
+            Play(options, options.seed + static_cast<std::uint32_t>(i));
+      });
+    }
+    pool.Wait();
+  }
+  double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  int gameOvers = 0;
+  SearchTotals search;
+  for (const GameResult &r : results) {
+    gameOvers += r.gameOver;
+    search.placements += r.placements;
+    search.cacheHits += r.cacheHits;
+    search.seconds += r.searchSeconds;
+  }
+  std::vector<Summary> summaries = {
+      Summarize("score", results, [](const GameResult &r) { return r.score; }),
+      Summarize("rows_cleared", results,
+                [](const GameResult &r) { return r.rowsCleared; }),
+      Summarize("pieces", results,
+                [](const GameResult &r) { return r.pieces; }),
+      Summarize("ticks", results, [](const GameResult &r) { return r.ticks; }),
+      Summarize("game_ms", results, [](const GameResult &r) { return r.ms; }),
+  };
+  std::cerr << options.games << " games on " << threads << " threads in "
+            << seconds << " s (" << options.games / seconds << " games/s), "
+            << gameOvers << " ended by game over\n";
+  if (options.player == "ai") {
+    std::cerr << "  search (" << GetFeatureKernelName(options.kernel)
+              << "): " << search.GetPlacementsPerSecond()
+              << " placements/s per thread, "
+              << 100 * search.GetCacheHitRate() << "% from the cache\n";
+  }
+  for (const Summary &s : summaries) {
+    std::cerr << "  " << s.name << ": mean " << s.mean << ", min " << s.min
+              << ", p50 " << s.p50 << ", p99 " << s.p99 << ", max " << s.max
+              << "\n";
+  }
+
+  if (options.outPath.empty()) {
+    WriteJson(std::cout, options, threads, seconds, gameOvers, search,
+              summaries);
+  } else {
+    std::ofstream out(options.outPath);
+    WriteJson(out, options, threads, seconds, gameOvers, search, summaries);
+  }
+  return 0;
+}
@@ -0,0 +1,358 @@
+// Microbenchmarks of the Field, Piece, PieceGenerator and Simulation hot
+// paths, of saving and restoring a GameState and of every board feature
+// kernel the CPU supports.
+//
+// Runs without a display and prints one JSON document with the time and the
+// heap allocations per operation of every benchmark, for several grid sizes
+// and fill densities. Exits with 1 if a vector feature kernel disagrees with
+// the scalar one, or if clearing rows on the 10x1000 grid costs more than
+// kMaxClearGrowth times as much as on the 10x20 grid at the same density:
+//
+//   tetris_bench [--out results.json] [--min-time-ms 50]
+
+#include "alloc_counter.h"
+#include "board_features.h"
+#include "field.h"
+#include "game_state.h"
+#include "logger.h"
+#include "piece.h"
+#include "simulation.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+  std::string name;
+  int width;
+  int height;
+  double density;
+  std::uint64_t ops;
+  double nsPerOp;
+  double allocsPerOp;
+};
+
+// keeps the compiler from optimizing away a benchmarked result
+template <typename T> void Consume(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+double minTimeMs{50};
+bool mismatch{false}; // a feature kernel gave other results than the scalar
+// a clear only touches the rows it moves, so its cost must not grow with the
+// height of the grid
+constexpr double kMaxClearGrowth = 4;
+
+// runs batches of `batch` operations until the minimum time has passed. The
+// setup runs before each batch and is neither timed nor counted, `op(i)`
+// performs the i-th operation of a batch, or `opsPerCall` operations at once
+template <typename Setup, typename Op>
+Result Measure(const std::string &name, int width, int height, double density,
+               std::size_t batch, Setup &&setup, Op &&op,
+               std::size_t opsPerCall = 1) {
+  Result r{name, width, height, density, 0, 0, 0};
+  std::uint64_t allocs{0};
+  Clock::duration elapsed{0};
+  while (elapsed < std::chrono::duration<double, std::milli>(minTimeMs)) {
+    setup();
+    std::uint64_t a0 = AllocCounter::GetAllocations();
+    Clock::time_point t0 = Clock::now();
+    for (std::size_t i = 0; i < batch; i++)
+      op(i);
+    elapsed += Clock::now() - t0;
+    allocs += AllocCounter::GetAllocations() - a0;
+    r.ops += batch * opsPerCall;
+  }
+  r.nsPerOp =
+      std::chrono::duration<double, std::nano>(elapsed).count() / r.ops;
+  r.allocsPerOp = static_cast<double>(allocs) / r.ops;
+  std::cerr << name << " " << width << "x" << height << " density=" << density
+            << ": " << r.nsPerOp << " ns/op, " << r.allocsPerOp
+            << " allocs/op\n";
+  return r;
+}
+
+// fills the bottom `density` fraction of the field with garbage rows, each
+// with random cells and at least one hole so no row is full
+std::shared_ptr<Field> MakeField(int width, int height, double density,
+                                 std::mt19937_64 &rng) {
+  auto field = std::make_shared<Field>(width, height);
+  int rows = static_cast<int>(density * height);
+  for (int y = height - rows; y < height; y++) {
+    Field::Row row = rng() & field->GetFullRow();
+    row &= ~(Field::Row{1} << (rng() % width));
+    field->SetRow(y, row);
+  }
+  return field;
+}
+
+// returns a field filled like MakeField whose bottom `lines` rows are full
+// except for column 0, so dropping a vertical long piece into that column
+// clears them all from under the stack
+std::shared_ptr<Field> MakeClearField(int width, int height, int lines,
+                                      double density, std::mt19937_64 &rng) {
+  auto field = MakeField(width, height, density, rng);
+  for (int y = height - lines; y < height; y++)
+    field->SetRow(y, field->GetFullRow() & ~Field::Row{1});
+  return field;
+}
+
+// copies of a field held as boards of the given type, the way the autoplayer
+// tries placements: copying the field, adding a landed piece without clearing
+// rows and adding a vertical long piece that completes the 1 or 4 full rows
+// at the bottom of the clear fields, below the rest of the stack
+template <typename Board>
+void BenchPlacement(const std::string &prefix, const Field &field,
+                    const std::vector<std::shared_ptr<Field>> &clears,
+                    double density, std::vector<Result> &results) {
+  int width = field.GetWidth();
+  int height = field.GetHeight();
+  Board source(width, height);
+  source.SetRows(field.GetRows());
+  std::vector<Board> boards(256, source);
+  results.push_back(Measure(
+      prefix + ".copy", width, height, density, boards.size(), [] {},
+      [&](std::size_t i) { boards[i] = source; }));
+
+  Piece landed(PieceType::kT, width, height);
+  landed.SetField(&field);
+  landed.Drop();
+  results.push_back(Measure(
+      prefix + ".add_piece", width, height, density, boards.size(),
+      [&] { std::fill(boards.begin(), boards.end(), source); },
+      [&](std::size_t i) { boards[i].AddPiece(landed); }));
+
+  Piece bar(PieceType::kLong, width, height);
+  bar.MoveTo(0, height - 2, 1);
+  for (std::size_t c = 0; c < clears.size(); c++) {
+    Board full(width, height);
+    full.SetRows(clears[c]->GetRows());
+    results.push_back(Measure(
+        prefix + ".clear_" + std::to_string(c == 0 ? 1 : 4) + "_lines",
+        width, height, density, boards.size(),
+        [&] { std::fill(boards.begin(), boards.end(), full); },
+        [&](std::size_t i) { boards[i].AddPiece(bar); }));
+  }
+}
+
+void BenchGrid(int width, int height, double density,
+               std::vector<Result> &results) {
+  std::mt19937_64 rng(width * 1000003 + height * 7919 + density * 100);
+  std::shared_ptr<Field> field = MakeField(width, height, density, rng);
+  constexpr std::size_t kBatch{1024};
+
+  // random cells queried through a piece attached to the field
+  Piece probe(PieceType::kT, width, height);
+  probe.SetField(field.get());
+  std::vector<Cell> cells(kBatch);
+  for (Cell &c : cells)
+    c = Cell{static_cast<int>(rng() % width), static_cast<int>(rng() % height)};
+  results.push_back(Measure(
+      "piece.cell_occupied", width, height, density, kBatch, [] {},
+      [&](std::size_t i) {
+        Consume(probe.CellOccupied(cells[i].x, cells[i].y));
+      }));
+
+  // collision tests of a piece at its spawn position
+  const Direction directions[] = {Direction::kDown, Direction::kLeft,
+                                  Direction::kRight};
+  const char *directionNames[] = {"piece.is_blocked_down",
+                                  "piece.is_blocked_left",
+                                  "piece.is_blocked_right"};
+  for (int d = 0; d < 3; d++) {
+    results.push_back(Measure(
+        directionNames[d], width, height, density, kBatch, [] {},
+        [&](std::size_t) { Consume(probe.IsBlocked(directions[d])); }));
+  }
+
+  results.push_back(Measure(
+      "piece.rotate", width, height, density, kBatch, [] {},
+      [&](std::size_t) { probe.Rotate(Rotation::kForward); }));
+
+  // every drop needs a fresh piece since a dropped piece is no longer free
+  std::vector<Piece> pieces(kBatch, Piece(PieceType::kT, width, height));
+  results.push_back(Measure(
+      "piece.drop", width, height, density, kBatch,
+      [&] {
+        for (Piece &p : pieces) {
+          p = Piece(static_cast<PieceType>(rng() % kNumPieceTypes), width,
+                    height);
+          p.SetField(field.get());
+        }
+      },
+      [&](std::size_t i) { pieces[i].Drop(); }));
+
+  // the bottom 1 and 4 rows of these are full but for column 0
+  std::vector<std::shared_ptr<Field>> clears;
+  for (int lines : {1, 4})
+    clears.push_back(MakeClearField(width, height, lines, density, rng));
+  BenchPlacement<Field>("field", *field, clears, density, results);
+  if (StandardField::HasSize(width, height))
+    BenchPlacement<StandardField>("standard_field", *field, clears, density,
+                                  results);
+
+  // features of a batch of boards filled like the field, by every kernel
+  constexpr std::size_t kBoards{256};
+  std::vector<Field::Row> boards;
+  for (std::size_t i = 0; i < kBoards; i++) {
+    std::shared_ptr<Field> board = MakeField(width, height, density, rng);
+    boards.insert(boards.end(), board->GetRows(), board->GetRows() + height);
+  }
+  BoardFeatureBatch reference;
+  ComputeFeatures(boards.data(), kBoards, width, height, reference,
+                  FeatureKernel::kScalar);
+  for (FeatureKernel kernel :
+       {FeatureKernel::kScalar, FeatureKernel::kSse2, FeatureKernel::kAvx2}) {
+    if (!IsSupported(kernel))
+      continue;
+    std::string name =
+        std::string("features.") + GetFeatureKernelName(kernel);
+    BoardFeatureBatch features;
+    results.push_back(Measure(
+        name, width, height, density, 1, [] {},
+        [&](std::size_t) {
+          ComputeFeatures(boards.data(), kBoards, width, height, features,
+                          kernel);
+          Consume(features.holes[0]);
+        },
+        kBoards));
+    if (features.aggregateHeight != reference.aggregateHeight or
+        features.maxHeight != reference.maxHeight or
+        features.holes != reference.holes or
+        features.bumpiness != reference.bumpiness or
+        features.rowTransitions != reference.rowTransitions or
+        features.columnTransitions != reference.columnTransitions or
+        features.wells != reference.wells) {
+      std::cerr << name << " differs from features.scalar\n";
+      mismatch = true;
+    }
+  }
+
+  PieceGenerator generator(42);
+  results.push_back(Measure(
+      "generator.generate_piece", width, height, density, kBatch, [] {},
+      [&](std::size_t) {
+        Consume(generator.GeneratePiece(width, height, field.get()));
+      }));
+
+  // the whole life of a piece in the simulation: it is moved, dropped,
+  // added to the field and replaced by the next one. Games that end are
+  // restarted between batches, steady play must not allocate. The field
+  // starts empty, so this only runs once per grid size
+  if (density > 0)
+    return;
+  constexpr std::size_t kLifecycleBatch{4};
+  std::unique_ptr<Simulation> simulation;
+  int game = 0;
+  results.push_back(Measure(
+      "simulation.piece_lifecycle", width, height, density, kLifecycleBatch,
+      [&] {
+        if (!simulation or simulation->IsGameOver() or
+            simulation->GetField().GetRow(height / 2) != 0)
+          simulation = std::make_unique<Simulation>(width, height, game++);
+      },
+      [&](std::size_t i) {
+        Input move;
+        move.Add(i % 2 ? Action::kMoveLeft : Action::kMoveRight);
+        Input drop;
+        drop.Add(Action::kDrop);
+        for (std::size_t k = 0; k < i % (width / 2); k++)
+          simulation->Step(move);
+        simulation->Step(drop);
+      }));
+
+  // saving the whole game and restoring it, e.g. to try moves and take them
+  // back, on the game left by the lifecycle benchmark
+  if (height > GameState::kMaxHeight)
+    return;
+  GameState state;
+  results.push_back(Measure(
+      "simulation.save_state", width, height, density, kBatch, [] {},
+      [&](std::size_t) {
+        simulation->Save(state);
+        Consume(state.tick);
+      }));
+  results.push_back(Measure(
+      "simulation.restore_state", width, height, density, kBatch, [] {},
+      [&](std::size_t) { simulation->Restore(state); }));
+}
+
+// returns false and prints the benchmarks whose clears on the 10x1000 grid
+// are more than kMaxClearGrowth times slower than on the 10x20 grid
+bool CheckClearCost(const std::vector<Result> &results) {
+  bool flat = true;
+  for (const Result &tall : results) {
+    if (tall.width != 10 or tall.height != 1000 or
+        tall.name.find(".clear_") == std::string::npos)
+      continue;
+    for (const Result &low : results) {
+      if (low.name != tall.name or low.width != 10 or low.height != 20 or
+          low.density != tall.density)
+        continue;
+      if (tall.nsPerOp > kMaxClearGrowth * low.nsPerOp) {
+        std::cerr << tall.name << " density=" << tall.density << ": "
+                  << tall.nsPerOp << " ns/op on 10x1000 but " << low.nsPerOp
+                  << " ns/op on 10x20\n";
+        flat = false;
+      }
+    }
+  }
+  return flat;
+}
+
+void WriteJson(std::ostream &out, const std::vector<Result> &results) {
+  out << "{\n  \"benchmarks\": [\n";
+  for (std::size_t i = 0; i < results.size(); i++) {
+    const Result &r = results[i];
+    out << "    {\"name\": \"" << r.name << "\", \"width\": " << r.width
+        << ", \"height\": " << r.height << ", \"density\": " << r.density
+        << ", \"ops\": " << r.ops << ", \"ns_per_op\": " << r.nsPerOp
+        << ", \"allocs_per_op\": " << r.allocsPerOp << "}"
+        << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  out << "  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::string outPath;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--out" and i + 1 < argc) {
+      outPath = argv[++i];
+    } else if (arg == "--min-time-ms" and i + 1 < argc) {
+      minTimeMs = std::atof(argv[++i]);
+    } else {
+      std::cerr << "usage: " << argv[0]
+                << " [--out results.json] [--min-time-ms 50]\n";
+      return 1;
+    }
+  }
+  Logger::Instance().SetLevel(LogLevel::kOff);
+
+  std::vector<Result> results;
+  const int grids[][2] = {{10, 20}, {20, 40}, {64, 64}, {10, 1000}};
+  for (auto &grid : grids) {
+    for (double density : {0.0, 0.5, 0.9})
+      BenchGrid(grid[0], grid[1], density, results);
+  }
+
+  if (outPath.empty()) {
+    WriteJson(std::cout, results);
+  } else {
+    std::ofstream out(outPath);
+    WriteJson(out, results);
+  }
+  bool flat = CheckClearCost(results);
+  return mismatch or !flat ? 1 : 0;
+}
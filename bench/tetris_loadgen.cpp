@@ -0,0 +1,302 @@
+// Load generator for tetris_server: connects many clients, each of which
+// joins a game, sends a random input every few milliseconds and applies the
+// deltas it receives to its own copy of the field.
+//
+// Clients are spread over a few threads, each multiplexing its clients with
+// epoll. Prints one JSON document with the deltas received and the latency
+// from sending an input until a delta reports it applied:
+//
+//   tetris_loadgen [--address unix:/tmp/tetris.sock] [--clients 1000]
+//                  [--threads 1] [--seconds 10] [--input-ms 100]
+//                  [--width 10] [--height 20] [--seed 1] [--out results.json]
+
+#include "histogram.h"
+#include "logger.h"
+#include "protocol.h"
+#include "simulation.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::string address{"unix:/tmp/tetris.sock"};
+  int clients{1000};
+  int threads{1};
+  double seconds{10};
+  int inputMs{100};
+  int width{10};
+  int height{20};
+  std::uint32_t seed{1};
+  std::string outPath;
+};
+
+struct Client {
+  int fd{-1};
+  std::string inbox;
+  Field::Row rows[Protocol::kMaxRows]{};
+  std::deque<Clock::time_point> sent; // inputs not yet reported applied
+  std::uint32_t applied{0};
+  Clock::time_point nextInput;
+};
+
+// counters of one thread's clients
+struct Result {
+  int connected{0};
+  std::uint64_t inputs{0};
+  std::uint64_t deltas{0};
+  std::uint64_t bytes{0};
+  std::uint64_t games{0};
+  std::uint64_t errors{0}; // malformed messages and lost connections
+  LatencyHistogram latency; // input sent until a delta reports it applied
+};
+
+// decodes the received deltas of a client
+void Receive(Client &client, const Options &options, Result &result) {
+  char buffer[4096];
+  ssize_t n;
+  while ((n = ::recv(client.fd, buffer, sizeof(buffer), 0)) > 0) {
+    client.inbox.append(buffer, n);
+    result.bytes += n;
+  }
+  if (n == 0 or (n < 0 and errno != EAGAIN and errno != EWOULDBLOCK)) {
+    result.errors++;
+    ::close(client.fd);
+    client.fd = -1;
+    return;
+  }
+  std::size_t offset = 0;
+  Protocol::MessageType type;
+  const std::uint8_t *payload;
+  std::size_t size;
+  Protocol::Delta delta;
+  Clock::time_point now = Clock::now();
+  while (Protocol::NextMessage(client.inbox, offset, type, payload, size)) {
+    if (type != Protocol::MessageType::kDelta or
+        !Protocol::DecodeDelta(payload, size, options.width, options.height,
+                               delta, client.rows)) {
+      result.errors++;
+      continue;
+    }
+    result.deltas++;
+    result.games += (delta.flags & Protocol::kReset) != 0;
+    for (; client.applied < delta.inputsApplied and !client.sent.empty();
+         client.applied++) {
+      result.latency.Record(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              now - client.sent.front())
+              .count());
+      client.sent.pop_front();
+    }
+  }
+  client.inbox.erase(0, offset);
+}
+
+// runs a share of the clients until the deadline
+void Run(const Options &options, int first, int count,
+         Clock::time_point deadline, Result &result) {
+  std::mt19937 rng(options.seed + first);
+  const Action actions[] = {Action::kMoveLeft, Action::kMoveRight,
+                            Action::kRotate, Action::kDrop};
+  std::chrono::milliseconds period(options.inputMs);
+  int epoll = ::epoll_create1(EPOLL_CLOEXEC);
+  std::vector<Client> clients(count);
+  std::string message;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < count; i++) {
+    Client &client = clients[i];
+    std::string error;
+    client.fd = Protocol::Connect(options.address, error);
+    if (client.fd < 0) {
+      std::cerr << error << "\n";
+      result.errors++;
+      continue;
+    }
+    result.connected++;
+    message.clear();
+    Protocol::EncodeJoin(message,
+                         Protocol::Join{options.seed + first + i,
+                                        options.width, options.height});
+    ::send(client.fd, message.data(), message.size(), MSG_NOSIGNAL);
+    // spreads the inputs of the clients over the period
+    client.nextInput = start + period * (rng() % 1000) / 1000;
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = &client;
+    ::epoll_ctl(epoll, EPOLL_CTL_ADD, client.fd, &event);
+  }
+
+  std::vector<epoll_event> events(256);
+  while (Clock::now() < deadline) {
+    int n = ::epoll_wait(epoll, events.data(), events.size(), 1);
+    for (int i = 0; i < n; i++) {
+      Client &client = *static_cast<Client *>(events[i].data.ptr);
+      if (client.fd >= 0)
+        Receive(client, options, result);
+    }
+    Clock::time_point now = Clock::now();
+    for (Client &client : clients) {
+      if (client.fd < 0 or now < client.nextInput)
+        continue;
+      Input input;
+      input.Add(actions[rng() % 4]);
+      message.clear();
+      Protocol::EncodeInput(message, input.actions);
+      if (::send(client.fd, message.data(), message.size(), MSG_NOSIGNAL) ==
+          static_cast<ssize_t>(message.size())) {
+        client.sent.push_back(now);
+        result.inputs++;
+      }
+      client.nextInput += period;
+    }
+  }
+  for (Client &client : clients) {
+    if (client.fd >= 0)
+      ::close(client.fd);
+  }
+  ::close(epoll);
+}
+
+void WriteJson(std::ostream &out, const Options &options,
+               const Result &result, double seconds) {
+  const LatencyHistogram &latency = result.latency;
+  out << "{\n  \"address\": \"" << options.address
+      << "\", \"clients\": " << options.clients
+      << ", \"connected\": " << result.connected
+      << ", \"threads\": " << options.threads
+      << ", \"seconds\": " << seconds
+      << ",\n  \"inputs\": " << result.inputs
+      << ", \"deltas\": " << result.deltas
+      << ", \"deltas_per_second\": " << result.deltas / seconds
+      << ", \"bytes\": " << result.bytes << ", \"games\": " << result.games
+      << ", \"errors\": " << result.errors
+      << ",\n  \"input_to_delta_ms\": {\"mean\": " << latency.GetMean() / 1e6
+      << ", \"p50\": " << latency.GetPercentile(50) / 1e6
+      << ", \"p99\": " << latency.GetPercentile(99) / 1e6
+      << ", \"max\": " << latency.GetMax() / 1e6 << "}\n}\n";
+}
+
+// parses a whole decimal number that fits the value's type, returns false on
+// anything else
+template <typename T> bool ParseNumber(const char *text, T &value) {
+  char *end = nullptr;
+  errno = 0;
+  long long parsed = std::strtoll(text, &end, 10);
+  if (end == text or *end != '\0' or errno != 0 or
+      parsed < std::numeric_limits<T>::min() or
+      parsed > std::numeric_limits<T>::max())
+    return false;
+  value = static_cast<T>(parsed);
+  return true;
+}
+
+bool ParseOptions(int argc, char *argv[], Options &options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc)
+      return false;
+    const char *value = argv[++i];
+    bool valid = true;
+    if (arg == "--address") {
+      options.address = value;
+    } else if (arg == "--clients") {
+      valid = ParseNumber(value, options.clients);
+    } else if (arg == "--threads") {
+      valid = ParseNumber(value, options.threads);
+    } else if (arg == "--seconds") {
+      options.seconds = std::atof(value);
+    } else if (arg == "--input-ms") {
+      valid = ParseNumber(value, options.inputMs);
+    } else if (arg == "--width") {
+      valid = ParseNumber(value, options.width);
+    } else if (arg == "--height") {
+      valid = ParseNumber(value, options.height);
+    } else if (arg == "--seed") {
+      valid = ParseNumber(value, options.seed);
+    } else if (arg == "--out") {
+      options.outPath = value;
+    } else {
+      return false;
+    }
+    if (!valid)
+      return false;
+  }
+  return options.clients > 0 and options.threads > 0 and
+         options.seconds > 0 and options.inputMs > 0 and
+         options.width >= Protocol::kMinWidth and
+         options.width <= Field::kMaxWidth and
+         options.height >= Protocol::kMinHeight and
+         options.height <= Protocol::kMaxRows;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, options)) {
+    std::cerr << "usage: " << argv[0]
+              << " [--address unix:/tmp/tetris.sock] [--clients 1000]"
+                 " [--threads 1] [--seconds 10] [--input-ms 100]"
+                 " [--width 10] [--height 20] [--seed 1]"
+                 " [--out results.json]\n";
+    return 1;
+  }
+  Logger::Instance().SetLevel(LogLevel::kOff);
+
+  options.threads = std::min(options.threads, options.clients);
+  std::vector<Result> results(options.threads);
+  std::vector<std::thread> threads;
+  Clock::time_point start = Clock::now();
+  Clock::time_point deadline =
+      start + std::chrono::duration_cast<Clock::duration>(
+                  std::chrono::duration<double>(options.seconds));
+  for (int t = 0; t < options.threads; t++) {
+    int first = options.clients * t / options.threads;
+    int last = options.clients * (t + 1) / options.threads;
+    threads.emplace_back(Run, std::cref(options), first, last - first,
+                         deadline, std::ref(results[t]));
+  }
+  for (std::thread &thread : threads)
+    thread.join();
+  double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  Result total;
+  for (const Result &r : results) {
+    total.connected += r.connected;
+    total.inputs += r.inputs;
+    total.deltas += r.deltas;
+    total.bytes += r.bytes;
+    total.games += r.games;
+    total.errors += r.errors;
+    total.latency.Merge(r.latency);
+  }
+  std::cerr << total.connected << " clients, " << total.deltas
+            << " deltas, input to delta p50 "
+            << total.latency.GetPercentile(50) / 1e6 << " ms, p99 "
+            << total.latency.GetPercentile(99) / 1e6 << " ms, "
+            << total.errors << " errors\n";
+  if (options.outPath.empty()) {
+    WriteJson(std::cout, options, total, seconds);
+  } else {
+    std::ofstream out(options.outPath);
+    WriteJson(out, options, total, seconds);
+  }
+  return total.errors == 0 ? 0 : 1;
+}
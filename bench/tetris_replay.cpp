@@ -0,0 +1,149 @@
+// Verifies replay files by playing them headless as fast as possible.
+//
+// Every replay is re-run from its seed and inputs, and its final tick, score,
+// rows cleared and field must match the recording. Replays are spread over a
+// thread pool, so thousands of regression replays take seconds. The exit code
+// is 1 if any replay fails:
+//
+//   tetris_replay [--threads 0] replay.trpl...
+//
+// New replays of autoplayer games can be recorded for a regression corpus:
+//
+//   tetris_replay --record out.trpl [--seed 1] [--pieces 200]
+
+#include "autoplayer.h"
+#include "logger.h"
+#include "replay.h"
+#include "replay_writer.h"
+#include "simulation.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kGridWidth{10};
+constexpr int kGridHeight{20};
+
+// plays an autoplayer game while recording it
+bool Record(const std::string &path, std::uint32_t seed, int pieces) {
+  Simulation simulation(kGridWidth, kGridHeight, seed);
+  ReplayWriter writer;
+  if (!writer.Open(path, simulation))
+    return false;
+  AutoPlayer::Config config;
+  config.timeBudgetUs = 0;
+  config.threads = 1;
+  AutoPlayer player(config);
+  std::vector<Input> inputs;
+  std::size_t next = 0;
+  while (!simulation.IsGameOver() and
+         simulation.GetPieceCount() <= static_cast<std::uint64_t>(pieces)) {
+    player.HandleInput(simulation, inputs);
+    Input input = next < inputs.size() ? inputs[next++] : Input{};
+    writer.Record(simulation.GetTick(), input);
+    simulation.Step(input);
+  }
+  writer.Close(simulation);
+  std::cerr << "Recorded " << simulation.GetTick() << " ticks, score "
+            << simulation.GetScore() << " to " << path << "\n";
+  return true;
+}
+
+// parses a whole decimal number that fits the value's type, returns false on
+// anything else
+template <typename T> bool ParseNumber(const char *text, T &value) {
+  char *end = nullptr;
+  errno = 0;
+  long long parsed = std::strtoll(text, &end, 10);
+  if (end == text or *end != '\0' or errno != 0 or
+      parsed < std::numeric_limits<T>::min() or
+      parsed > std::numeric_limits<T>::max())
+    return false;
+  value = static_cast<T>(parsed);
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int threads{0};
+  std::string recordPath;
+  std::uint32_t seed{1};
+  int pieces{200};
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool valid = true;
+    if (arg == "--threads" and i + 1 < argc) {
+      valid = ParseNumber(argv[++i], threads);
+    } else if (arg == "--record" and i + 1 < argc) {
+      recordPath = argv[++i];
+    } else if (arg == "--seed" and i + 1 < argc) {
+      valid = ParseNumber(argv[++i], seed);
+    } else if (arg == "--pieces" and i + 1 < argc) {
+      valid = ParseNumber(argv[++i], pieces);
+    } else if (arg.compare(0, 2, "--") != 0) {
+      paths.push_back(arg);
+    } else {
+      valid = false;
+    }
+    if (!valid) {
+      paths.clear();
+      recordPath.clear();
+      break;
+    }
+  }
+  Logger::Instance().SetLevel(LogLevel::kOff);
+  if (!recordPath.empty())
+    return Record(recordPath, seed, pieces) ? 0 : 1;
+  if (paths.empty()) {
+    std::cerr << "usage: " << argv[0] << " [--threads 0] replay.trpl...\n"
+              << "       " << argv[0]
+              << " --record out.trpl [--seed 1] [--pieces 200]\n";
+    return 1;
+  }
+
+  std::vector<int> status(paths.size()); // 0 matches, 1 differs, 2 unreadable
+  std::atomic<std::uint64_t> ticks{0};
+  Clock::time_point start = Clock::now();
+  {
+    ThreadPool pool(threads);
+    pool.ParallelFor(static_cast<int>(paths.size()), [&](int i) {
+      Replay replay;
+      if (!Replay::Load(paths[i], replay)) {
+        status[i] = 2;
+        return;
+      }
+      Simulation simulation(replay.width, replay.height, replay.seed);
+      status[i] = ReplayPlayer::Run(replay, simulation) ? 0 : 1;
+      ticks += simulation.GetTick();
+    });
+  }
+  double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  int failed = 0;
+  for (std::size_t i = 0; i < paths.size(); i++) {
+    if (status[i] == 0)
+      continue;
+    failed++;
+    std::cout << paths[i] << ": "
+              << (status[i] == 1 ? "differs from the recording"
+                                 : "cannot be read")
+              << "\n";
+  }
+  std::cout << paths.size() - failed << " of " << paths.size()
+            << " replays match, " << ticks.load() << " ticks in " << seconds
+            << " s (" << ticks.load() / seconds << " ticks/s)\n";
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+// Headless game server: hosts one game per client connection on one epoll
+// event loop per core, see Server and Protocol.
+//
+// Runs until interrupted or for the given number of seconds, printing the
+// number of sessions every second, then prints one JSON document with the
+// sessions per loop, the CPU time the loops spent working and the latency of
+// the ticks:
+//
+//   tetris_server [--address unix:/tmp/tetris.sock] [--threads 0]
+//                 [--send-ms 16] [--seconds 0] [--out stats.json]
+
+#include "logger.h"
+#include "server.h"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+struct Options {
+  std::string address{"unix:/tmp/tetris.sock"};
+  int threads{0};
+  int sendMs{16};
+  double seconds{0};
+  std::string outPath;
+};
+
+std::atomic<bool> interrupted{false};
+
+void OnSignal(int) { interrupted = true; }
+
+void WriteJson(std::ostream &out, const Options &options,
+               const Server::Stats &stats) {
+  const LatencyHistogram &latency = stats.tickLatency;
+  double perLoop = static_cast<double>(stats.peakSessions) / stats.loops;
+  // share of the loops' time spent working rather than waiting for events
+  double utilization =
+      stats.seconds > 0 ? stats.busySeconds / (stats.seconds * stats.loops)
+                        : 0;
+  out << "{\n  \"address\": \"" << options.address
+      << "\", \"loops\": " << stats.loops
+      << ", \"send_ms\": " << options.sendMs
+      << ", \"seconds\": " << stats.seconds
+      << ",\n  \"peak_sessions\": " << stats.peakSessions
+      << ", \"sessions_per_loop\": " << perLoop
+      << ", \"loop_utilization\": " << utilization
+      << ", \"sessions_per_core_at_full_load\": "
+      << (utilization > 0 ? perLoop / utilization : 0)
+      << ",\n  \"games\": " << stats.games << ", \"ticks\": " << stats.ticks
+      << ", \"inputs\": " << stats.inputs << ", \"deltas\": " << stats.deltas
+      << ", \"bytes_sent\": " << stats.bytesSent
+      << ",\n  \"tick_latency_us\": {\"mean\": " << latency.GetMean() / 1e3
+      << ", \"p50\": " << latency.GetPercentile(50) / 1e3
+      << ", \"p99\": " << latency.GetPercentile(99) / 1e3
+      << ", \"p999\": " << latency.GetPercentile(99.9) / 1e3
+      << ", \"max\": " << latency.GetMax() / 1e3 << "}\n}\n";
+}
+
+bool ParseOptions(int argc, char *argv[], Options &options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc)
+      return false;
+    const char *value = argv[++i];
+    if (arg == "--address") {
+      options.address = value;
+    } else if (arg == "--threads") {
+      options.threads = std::atoi(value);
+    } else if (arg == "--send-ms") {
+      options.sendMs = std::atoi(value);
+    } else if (arg == "--seconds") {
+      options.seconds = std::atof(value);
+    } else if (arg == "--out") {
+      options.outPath = value;
+    } else {
+      return false;
+    }
+  }
+  return options.sendMs > 0 and options.seconds >= 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, options)) {
+    std::cerr << "usage: " << argv[0]
+              << " [--address unix:/tmp/tetris.sock] [--threads 0]"
+                 " [--send-ms 16] [--seconds 0] [--out stats.json]\n";
+    return 1;
+  }
+  // game overs are logged at the info level, one per game
+  LogLevel level = LogLevel::kWarning;
+  const char *levelName = std::getenv("TETRIS_LOG_LEVEL");
+  if (levelName != nullptr)
+    Logger::ParseLevel(levelName, level);
+  Logger::Instance().SetLevel(level);
+  Logger::Instance().Start();
+
+  Server::Config config;
+  config.threads = options.threads;
+  config.sendIntervalMs = options.sendMs;
+  Server server(config);
+  std::string error;
+  if (!server.Listen(options.address, error)) {
+    std::cerr << error << "\n";
+    Logger::Instance().Stop();
+    return 1;
+  }
+  std::signal(SIGINT, OnSignal);
+  std::signal(SIGTERM, OnSignal);
+  server.Start();
+  std::cerr << "listening on " << options.address << " with "
+            << server.GetLoops() << " event loops\n";
+
+  auto start = std::chrono::steady_clock::now();
+  auto report = start;
+  while (!interrupted) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    auto now = std::chrono::steady_clock::now();
+    if (options.seconds > 0 and
+        now - start >= std::chrono::duration<double>(options.seconds))
+      break;
+    if (now - report >= std::chrono::seconds(1)) {
+      std::cerr << server.GetSessions() << " sessions\n";
+      report = now;
+    }
+  }
+  server.Stop();
+
+  Server::Stats stats = server.GetStats();
+  std::cerr << stats.peakSessions << " sessions on " << stats.loops
+            << " loops, tick latency p50 "
+            << stats.tickLatency.GetPercentile(50) / 1e3 << " us, p99 "
+            << stats.tickLatency.GetPercentile(99) / 1e3 << " us\n";
+  if (options.outPath.empty()) {
+    WriteJson(std::cout, options, stats);
+  } else {
+    std::ofstream out(options.outPath);
+    WriteJson(out, options, stats);
+  }
+  Logger::Instance().Stop();
+  return 0;
+}
@@ -0,0 +1,17 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <cstdint>
+
+// counts heap allocations made through the global operator new. The counting
+// operators are defined in alloc_counter.cpp and replace the default ones in
+// every executable that links it
+namespace AllocCounter {
+
+// number of allocations and allocated bytes since the program started
+std::uint64_t GetAllocations();
+std::uint64_t GetBytes();
+
+} // namespace AllocCounter
+
+#endif
@@ -0,0 +1,337 @@
+#include "archive.h"
+#include "replay.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+void PutU32(std::string &out, std::uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    out += static_cast<char>(v >> (8 * i));
+}
+
+void PutU64(std::string &out, std::uint64_t v) {
+  for (int i = 0; i < 8; i++)
+    out += static_cast<char>(v >> (8 * i));
+}
+
+std::uint32_t GetU32(const std::uint8_t *p) {
+  std::uint32_t v = 0;
+  for (int i = 0; i < 4; i++)
+    v |= static_cast<std::uint32_t>(p[i]) << (8 * i);
+  return v;
+}
+
+std::uint64_t GetU64(const std::uint8_t *p) {
+  std::uint64_t v = 0;
+  for (int i = 0; i < 8; i++)
+    v |= static_cast<std::uint64_t>(p[i]) << (8 * i);
+  return v;
+}
+
+void EncodeKeyframe(std::string &out, const Simulation::Snapshot &s) {
+  PutU64(out, s.tick);
+  PutU64(out, s.pieceCount);
+  PutU64(out, s.rngState);
+  PutU64(out, s.rngIncrement);
+  for (int v : {s.pieceTicks, s.descendSpeed, s.descendProgress, s.score,
+                s.rowsCleared, s.level, s.pieceX, s.pieceY})
+    PutU32(out, static_cast<std::uint32_t>(v));
+  out += static_cast<char>(s.pieceType);
+  out += static_cast<char>(s.pieceRotation);
+  out += static_cast<char>(s.gameOver);
+  for (PieceType t : s.preview)
+    out += static_cast<char>(t);
+  for (Field::Row row : s.rows)
+    PutU64(out, row);
+}
+
+void DecodeKeyframe(const std::uint8_t *p, Simulation::Snapshot &s) {
+  s.tick = GetU64(p);
+  s.pieceCount = GetU64(p + 8);
+  s.rngState = GetU64(p + 16);
+  s.rngIncrement = GetU64(p + 24);
+  int *fields[] = {&s.pieceTicks, &s.descendSpeed, &s.descendProgress,
+                   &s.score,      &s.rowsCleared,  &s.level,
+                   &s.pieceX,     &s.pieceY};
+  for (int i = 0; i < 8; i++)
+    *fields[i] = static_cast<std::int32_t>(GetU32(p + 32 + 4 * i));
+  p += 64;
+  s.pieceType = static_cast<PieceType>(p[0]);
+  s.pieceRotation = p[1];
+  s.gameOver = p[2] != 0;
+  for (int i = 0; i < PieceGenerator::kPreviewSize; i++)
+    s.preview[i] = static_cast<PieceType>(p[3 + i]);
+  p += 8;
+  s.rows.resize(s.height);
+  for (int y = 0; y < s.height; y++)
+    s.rows[y] = GetU64(p + 8 * y);
+}
+
+} // namespace
+
+bool ArchiveWriter::Open(const std::string &path) {
+  _out.open(path, std::ios::binary | std::ios::trunc);
+  if (!_out)
+    return false;
+  std::string header(Archive::kMagic, sizeof(Archive::kMagic));
+  PutU32(header, Archive::kVersion);
+  _out.write(header.data(), header.size());
+  _offset = header.size();
+  _games.clear();
+  _keyframes.clear();
+  return true;
+}
+
+void ArchiveWriter::BeginGame(const Simulation &simulation) {
+  GameEntry game{};
+  game.offset = _offset;
+  game.width = simulation.GetField().GetWidth();
+  game.height = simulation.GetField().GetHeight();
+  game.seed = simulation.GetSeed();
+  game.firstKeyframe = static_cast<std::uint32_t>(_keyframes.size());
+  _games.push_back(game);
+  _nextKeyframePiece = simulation.GetPieceCount();
+  StartSegment(simulation);
+}
+
+void ArchiveWriter::Record(const Simulation &simulation, const Input &input) {
+  if (simulation.GetPieceCount() >= _nextKeyframePiece) {
+    FlushSegment();
+    StartSegment(simulation);
+  }
+  if (input.actions != 0) {
+    Replay::EncodeEvent(_inputs, simulation.GetTick() - _lastTick,
+                        input.actions);
+    _lastTick = simulation.GetTick();
+  }
+}
+
+void ArchiveWriter::EndGame(const Simulation &simulation) {
+  FlushSegment();
+  GameEntry &game = _games.back();
+  game.end = _offset;
+  game.keyframeCount =
+      static_cast<std::uint32_t>(_keyframes.size()) - game.firstKeyframe;
+  game.pieces = simulation.GetPieceCount();
+  game.finalTick = simulation.GetTick();
+  game.score = simulation.GetScore();
+  game.rowsCleared = simulation.GetRowsCleared();
+  game.fieldHash = Replay::HashField(simulation.GetField());
+}
+
+void ArchiveWriter::StartSegment(const Simulation &simulation) {
+  simulation.GetSnapshot(_snapshot);
+  _keyframes.push_back(Keyframe{_offset, _snapshot.tick});
+  _segment.clear();
+  EncodeKeyframe(_segment, _snapshot);
+  _inputs.clear();
+  _lastTick = _snapshot.tick;
+  _nextKeyframePiece = _snapshot.pieceCount + _keyframeInterval;
+}
+
+// writes the open segment: its keyframe, the length of its inputs and them
+void ArchiveWriter::FlushSegment() {
+  PutU32(_segment, static_cast<std::uint32_t>(_inputs.size()));
+  _segment += _inputs;
+  _out.write(_segment.data(), _segment.size());
+  _offset += _segment.size();
+  _segment.clear();
+  _inputs.clear();
+}
+
+bool ArchiveWriter::Close() {
+  std::string index;
+  for (const GameEntry &g : _games) {
+    PutU64(index, g.offset);
+    PutU64(index, g.end);
+    for (std::uint32_t v :
+         {g.width, g.height, g.seed,
+          static_cast<std::uint32_t>(_keyframeInterval), g.firstKeyframe,
+          g.keyframeCount})
+      PutU32(index, v);
+    PutU64(index, g.pieces);
+    PutU64(index, g.finalTick);
+    PutU32(index, static_cast<std::uint32_t>(g.score));
+    PutU32(index, static_cast<std::uint32_t>(g.rowsCleared));
+    PutU64(index, g.fieldHash);
+    PutU64(index, 0); // reserved
+  }
+  for (const Keyframe &k : _keyframes) {
+    PutU64(index, k.offset);
+    PutU64(index, k.tick);
+  }
+  PutU64(index, _offset);
+  PutU64(index, _games.size());
+  index.append(Archive::kMagic, sizeof(Archive::kMagic));
+  PutU32(index, Archive::kVersion);
+  _out.write(index.data(), index.size());
+  _out.close();
+  return !_out.fail();
+}
+
+ArchiveReader::~ArchiveReader() { Close(); }
+
+bool ArchiveReader::Open(const std::string &path) {
+  Close();
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  void *data = MAP_FAILED;
+  if (fstat(fd, &st) == 0 and st.st_size > 0)
+    data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED)
+    return false;
+  _data = static_cast<const std::uint8_t *>(data);
+  _size = st.st_size;
+
+  // checks the header, the footer and that the index fits in the file
+  bool valid = false;
+  if (_size >= Archive::kHeaderSize + Archive::kFooterSize and
+      std::memcmp(_data, Archive::kMagic, sizeof(Archive::kMagic)) == 0 and
+      GetU32(_data + 4) == Archive::kVersion) {
+    const std::uint8_t *footer = _data + _size - Archive::kFooterSize;
+    _indexOffset = GetU64(footer);
+    _gameCount = GetU64(footer + 8);
+    std::size_t indexEnd = _size - Archive::kFooterSize;
+    valid = std::memcmp(footer + 16, Archive::kMagic, 4) == 0 and
+            _indexOffset <= indexEnd and
+            _gameCount <=
+                (indexEnd - _indexOffset) / Archive::kGameEntrySize;
+  }
+  // the games' sizes and keyframe intervals are used to restore them
+  for (std::uint64_t g = 0; valid and g < _gameCount; g++) {
+    GameInfo info = GetGame(static_cast<int>(g));
+    valid = info.width >= Field::kMinWidth and
+            info.width <= Field::kMaxWidth and info.height > 0 and
+            info.height <= Field::kMaxHeight and info.keyframeInterval > 0;
+  }
+  if (!valid)
+    Close();
+  return valid;
+}
+
+void ArchiveReader::Close() {
+  if (_data != nullptr)
+    munmap(const_cast<std::uint8_t *>(_data), _size);
+  _data = nullptr;
+  _size = 0;
+  _gameCount = 0;
+}
+
+ArchiveReader::GameInfo ArchiveReader::GetGame(int game) const {
+  const std::uint8_t *e =
+      _data + _indexOffset + game * Archive::kGameEntrySize;
+  GameInfo info;
+  info.width = static_cast<int>(GetU32(e + 16));
+  info.height = static_cast<int>(GetU32(e + 20));
+  info.seed = GetU32(e + 24);
+  info.keyframeInterval = static_cast<int>(GetU32(e + 28));
+  info.keyframeCount = static_cast<int>(GetU32(e + 36));
+  info.pieces = GetU64(e + 40);
+  info.finalTick = GetU64(e + 48);
+  info.score = static_cast<std::int32_t>(GetU32(e + 56));
+  info.rowsCleared = static_cast<std::int32_t>(GetU32(e + 60));
+  info.fieldHash = GetU64(e + 64);
+  return info;
+}
+
+// the keyframe is found directly from the piece number, since a game has one
+// every keyframeInterval pieces from its first piece on. Only the pieces
+// between it and the requested one are simulated
+std::unique_ptr<Simulation> ArchiveReader::Seek(int game, std::uint64_t piece,
+                                                Cursor &cursor) const {
+  if (game < 0 or static_cast<std::uint64_t>(game) >= _gameCount)
+    return nullptr;
+  GameInfo info = GetGame(game);
+  if (piece < 1 or piece > info.pieces or info.keyframeCount == 0)
+    return nullptr;
+  const std::uint8_t *e =
+      _data + _indexOffset + game * Archive::kGameEntrySize;
+  std::uint64_t gameEnd = GetU64(e + 8);
+  std::uint64_t firstKeyframe = GetU32(e + 32);
+  std::uint64_t k = std::min<std::uint64_t>((piece - 1) / info.keyframeInterval,
+                                            info.keyframeCount - 1);
+  std::size_t entry = _indexOffset + _gameCount * Archive::kGameEntrySize +
+                      (firstKeyframe + k) * Archive::kKeyframeEntrySize;
+  std::size_t keyframeSize = Archive::kKeyframeHeaderSize +
+                            static_cast<std::size_t>(info.height) * 8;
+  if (entry + Archive::kKeyframeEntrySize > _size - Archive::kFooterSize)
+    return nullptr;
+  std::uint64_t offset = GetU64(_data + entry);
+  if (gameEnd > _indexOffset or offset > gameEnd or
+      gameEnd - offset < keyframeSize + 4)
+    return nullptr;
+
+  Simulation::Snapshot snapshot;
+  snapshot.width = info.width;
+  snapshot.height = info.height;
+  snapshot.seed = info.seed;
+  DecodeKeyframe(_data + offset, snapshot);
+  if (!Simulation::CanRestore(snapshot))
+    return nullptr;
+  auto simulation = std::make_unique<Simulation>(snapshot);
+
+  cursor = Cursor{};
+  cursor._game = info;
+  cursor._keyframeSize = keyframeSize;
+  cursor._p = _data + offset + keyframeSize + 4;
+  cursor._segmentEnd = cursor._p + GetU32(_data + offset + keyframeSize);
+  cursor._gameEnd = _data + gameEnd;
+  cursor._lastTick = snapshot.tick;
+  if (cursor._segmentEnd > cursor._gameEnd)
+    return nullptr;
+  while (simulation->GetPieceCount() < piece and !cursor.IsDone(*simulation))
+    simulation->Step(cursor.GetInput(simulation->GetTick()));
+  return simulation;
+}
+
+// decodes the next input, moving past the next keyframe at a segment's end
+bool ArchiveReader::Cursor::NextEvent() {
+  while (_p == _segmentEnd) {
+    if (_segmentEnd + _keyframeSize + 4 > _gameEnd)
+      return false;
+    const std::uint8_t *keyframe = _segmentEnd;
+    _lastTick = GetU64(keyframe);
+    _p = keyframe + _keyframeSize + 4;
+    _segmentEnd = _p + GetU32(keyframe + _keyframeSize);
+    if (_segmentEnd > _gameEnd)
+      return false;
+  }
+  std::uint64_t value;
+  if (!Replay::GetVarint(_p, _segmentEnd, value))
+    return false;
+  _lastTick += value >> 4;
+  _eventTick = _lastTick;
+  _eventActions = value & 0x0f;
+  return true;
+}
+
+Input ArchiveReader::Cursor::GetInput(std::uint64_t tick) {
+  if (!_hasEvent)
+    _hasEvent = NextEvent();
+  Input input;
+  if (_hasEvent and _eventTick == tick) {
+    input.actions = _eventActions;
+    _hasEvent = false;
+  }
+  return input;
+}
+
+bool ArchiveReader::Cursor::IsDone(const Simulation &simulation) const {
+  return simulation.IsGameOver() or
+         simulation.GetTick() >= _game.finalTick;
+}
+
+bool ArchiveReader::Cursor::Matches(const Simulation &simulation) const {
+  return simulation.GetTick() == _game.finalTick and
+         simulation.GetScore() == _game.score and
+         simulation.GetRowsCleared() == _game.rowsCleared and
+         Replay::HashField(simulation.GetField()) == _game.fieldHash;
+}
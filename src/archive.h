@@ -0,0 +1,159 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include "simulation.h"
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// many recorded games in one file, with full-state keyframes so a reader can
+// jump to any piece of any game without re-simulating from the start.
+//
+// A game is a run of segments, one per keyframe. Each segment is the keyframe
+// (the Simulation::Snapshot at the start of every keyframeInterval-th piece,
+// fixed size for the game's height), the byte length of its inputs and the
+// inputs as varints of the ticks since the previous input (or the keyframe)
+// shifted left by four bits over the action bits, like a Replay. After the
+// games follows the index: one fixed-size entry per game, then the offset and
+// tick of every keyframe, and a footer pointing at the index. All integers
+// are little-endian.
+namespace Archive {
+constexpr char kMagic[4] = {'T', 'A', 'R', 'C'};
+constexpr std::uint32_t kVersion{1};
+constexpr std::size_t kHeaderSize{8};          // magic and version
+constexpr std::size_t kKeyframeHeaderSize{72}; // keyframe without its rows
+constexpr std::size_t kGameEntrySize{80};
+constexpr std::size_t kKeyframeEntrySize{16};
+constexpr std::size_t kFooterSize{24};
+} // namespace Archive
+
+// writes games to an archive, one game at a time
+class ArchiveWriter {
+public:
+  explicit ArchiveWriter(int keyframeInterval = 32)
+      : _keyframeInterval(keyframeInterval < 1 ? 1 : keyframeInterval){};
+
+  // returns false if the file cannot be opened
+  bool Open(const std::string &path);
+
+  // starts a new game at the state of the simulation
+  void BeginGame(const Simulation &simulation);
+
+  // records the input about to be applied by the next Step of the simulation,
+  // and a keyframe first whenever the game reached a new keyframe piece
+  void Record(const Simulation &simulation, const Input &input);
+
+  // ends the current game at the final state of the simulation
+  void EndGame(const Simulation &simulation);
+
+  // writes the index and closes the file, returns false on a write error
+  bool Close();
+
+private:
+  struct Keyframe {
+    std::uint64_t offset;
+    std::uint64_t tick;
+  };
+  struct GameEntry {
+    std::uint64_t offset;
+    std::uint64_t end;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t seed;
+    std::uint32_t firstKeyframe;
+    std::uint32_t keyframeCount;
+    std::uint64_t pieces;
+    std::uint64_t finalTick;
+    std::int32_t score;
+    std::int32_t rowsCleared;
+    std::uint64_t fieldHash;
+  };
+
+  void StartSegment(const Simulation &simulation);
+  void FlushSegment();
+
+  int _keyframeInterval;
+  std::ofstream _out;
+  std::uint64_t _offset{0}; // bytes written so far
+  std::vector<GameEntry> _games;
+  std::vector<Keyframe> _keyframes;
+  Simulation::Snapshot _snapshot;
+  std::string _segment; // keyframe and inputs of the open segment
+  std::string _inputs;
+  std::uint64_t _lastTick{0};
+  std::uint64_t _nextKeyframePiece{0};
+};
+
+// reads an archive through a read-only memory mapping, so opening it costs
+// nothing and seeking only touches the pages of one keyframe and its inputs
+class ArchiveReader {
+public:
+  struct GameInfo {
+    int width;
+    int height;
+    std::uint32_t seed;
+    int keyframeCount;
+    int keyframeInterval;
+    std::uint64_t pieces; // pieces spawned, including the last one
+    std::uint64_t finalTick;
+    int score;
+    int rowsCleared;
+    std::uint64_t fieldHash;
+  };
+
+  // feeds the recorded inputs of a game onwards from a seek position
+  class Cursor {
+  public:
+    // returns the input for the step at the input tick, ticks must be asked
+    // for in increasing order
+    Input GetInput(std::uint64_t tick);
+    // true once the simulation reached the end of the game
+    bool IsDone(const Simulation &simulation) const;
+    // true if the simulation ended in the recorded state
+    bool Matches(const Simulation &simulation) const;
+
+  private:
+    friend class ArchiveReader;
+    bool NextEvent();
+
+    GameInfo _game{};
+    const std::uint8_t *_p{nullptr};          // next input
+    const std::uint8_t *_segmentEnd{nullptr}; // end of the segment's inputs
+    const std::uint8_t *_gameEnd{nullptr};
+    std::size_t _keyframeSize{0};
+    std::uint64_t _lastTick{0};
+    bool _hasEvent{false};
+    std::uint64_t _eventTick{0};
+    std::uint8_t _eventActions{0};
+  };
+
+  ArchiveReader() = default;
+  ~ArchiveReader();
+  ArchiveReader(const ArchiveReader &) = delete;
+  ArchiveReader &operator=(const ArchiveReader &) = delete;
+
+  // maps the archive, returns false if it cannot be read, is malformed or
+  // holds a game whose grid size or keyframe interval is unsupported
+  bool Open(const std::string &path);
+  void Close();
+
+  int GetGameCount() const { return static_cast<int>(_gameCount); };
+  GameInfo GetGame(int game) const;
+
+  // returns the game at the start of its input piece (1 is the first piece),
+  // restored from the nearest keyframe before it and played forward from
+  // there, and sets the cursor to continue the game. Returns nullptr if the
+  // game or the piece does not exist
+  std::unique_ptr<Simulation> Seek(int game, std::uint64_t piece,
+                                   Cursor &cursor) const;
+
+private:
+  const std::uint8_t *_data{nullptr};
+  std::size_t _size{0};
+  std::uint64_t _indexOffset{0};
+  std::uint64_t _gameCount{0};
+};
+
+#endif
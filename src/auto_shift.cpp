@@ -0,0 +1,48 @@
+#include "auto_shift.h"
+#include <algorithm>
+
+namespace {
+bool IsMove(Action action) {
+  return action == Action::kMoveLeft or action == Action::kMoveRight;
+}
+} // namespace
+
+AutoShift::AutoShift(int delayTicks, int repeatTicks)
+    : _delayTicks(std::max(0, delayTicks)),
+      _repeatTicks(std::max(1, repeatTicks)) {}
+
+void AutoShift::Press(Action action, std::uint64_t tick) {
+  _pressed.Add(action);
+  if (!IsMove(action))
+    return;
+  _held.Add(action);
+  _shift = action;
+  _nextRepeat = tick + _delayTicks;
+}
+
+void AutoShift::Release(Action action, std::uint64_t tick) {
+  if (!IsMove(action))
+    return;
+  _held.actions &= ~static_cast<std::uint8_t>(action);
+  if (action != _shift)
+    return;
+  // the other move key takes over if it is still held, after a new delay
+  Action other = action == Action::kMoveLeft ? Action::kMoveRight
+                                             : Action::kMoveLeft;
+  if (_held.Has(other)) {
+    _shift = other;
+    _nextRepeat = tick + _delayTicks;
+  } else {
+    _shift = Action::kNone;
+  }
+}
+
+Input AutoShift::Next(std::uint64_t tick) {
+  Input input = _pressed;
+  _pressed = Input{};
+  if (_shift != Action::kNone and tick >= _nextRepeat) {
+    input.Add(_shift);
+    _nextRepeat = std::max(_nextRepeat, tick) + _repeatTicks;
+  }
+  return input;
+}
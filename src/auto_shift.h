@@ -0,0 +1,40 @@
+#ifndef AUTO_SHIFT_H
+#define AUTO_SHIFT_H
+
+#include "simulation.h"
+#include <cstdint>
+
+// turns key presses and releases into the inputs of each simulation tick.
+// Every press acts once on the tick it happened. A held move key shifts the
+// piece again once it has been held for the delay (delayed auto-shift, DAS)
+// and then every repeat interval (auto-repeat rate, ARR), all counted in
+// ticks from the time of the press, so the timing does not depend on how
+// often the keys are read. When both move keys are held the one pressed last
+// wins
+class AutoShift {
+public:
+  static constexpr int kDefaultDelayMs{150};
+  static constexpr int kDefaultRepeatMs{30};
+
+  AutoShift() : AutoShift(kDefaultDelayMs, kDefaultRepeatMs){};
+  // an interval of 0 ticks repeats on every tick
+  AutoShift(int delayTicks, int repeatTicks);
+
+  // a key was pressed or released at the input tick, which may lie before
+  // the tick passed to the next call to Next but not before the previous one
+  void Press(Action action, std::uint64_t tick);
+  void Release(Action action, std::uint64_t tick);
+
+  // returns the actions of the input tick, called once per tick in order
+  Input Next(std::uint64_t tick);
+
+private:
+  int _delayTicks;
+  int _repeatTicks;
+  Input _pressed;                  // presses not yet handed out
+  Input _held;                     // move keys held down
+  Action _shift{Action::kNone};    // held move key that repeats
+  std::uint64_t _nextRepeat{0};    // tick of the next repeat of _shift
+};
+
+#endif
@@ -0,0 +1,254 @@
+#include "autoplayer.h"
+#include "logger.h"
+#include <algorithm>
+#include <cstdlib>
+#include <type_traits>
+
+namespace {
+
+// copies a field into a board of the same size, which may be of another type
+template <typename Board, typename Source>
+void Assign(Board &board, const Source &field) {
+  if constexpr (std::is_same_v<Board, Source>)
+    board = field;
+  else
+    board.SetRows(field.GetRows());
+}
+
+// returns a board of the type of a node with the cells of a field
+template <typename Board, typename Source>
+Board MakeBoard(const Source &field) {
+  Board board(field.GetWidth(), field.GetHeight());
+  Assign(board, field);
+  return board;
+}
+
+// sets the i-th node of a beam, reusing the board already stored there
+template <typename Node, typename Source>
+void SetNode(std::vector<Node> &beam, std::size_t i, const Source &field,
+             int lines, double score, const Placement &first) {
+  if (i < beam.size()) {
+    Assign(beam[i].field, field);
+    beam[i].lines = lines;
+    beam[i].score = score;
+    beam[i].first = first;
+  } else {
+    beam.push_back(
+        Node{MakeBoard<decltype(Node::field)>(field), lines, score, first});
+  }
+}
+
+} // namespace
+
+AutoPlayer::AutoPlayer(const Config &config)
+    : _config(config) {
+  if (_config.threads != 1)
+    _pool = std::make_unique<ThreadPool>(_config.threads);
+  if (_config.cacheEntries > 0)
+    _cache = std::make_unique<TranspositionTable>(_config.cacheEntries);
+  _config.beamWidth = std::max(1, _config.beamWidth);
+  _config.lookahead = std::max(0, _config.lookahead);
+}
+
+void AutoPlayer::HandleInput(const Simulation &simulation,
+                             std::vector<Input> &inputs) {
+  if (simulation.IsGameOver() or
+      simulation.GetPieceCount() == _plannedPiece)
+    return;
+  _plannedPiece = simulation.GetPieceCount();
+
+  const Piece &piece = simulation.GetPiece();
+  PieceType preview[PieceGenerator::kPreviewSize];
+  for (int i = 0; i < PieceGenerator::kPreviewSize; i++)
+    preview[i] = simulation.GetPreview(i);
+  Placement start{piece.GetRotation(), piece.GetCenterCellX(),
+                  piece.GetCenterCellY()};
+  Placement best;
+  if (!Search(simulation.GetField(), piece.GetType(), start, preview,
+              PieceGenerator::kPreviewSize, best))
+    return;
+
+  // the simulation only rotates forward
+  int rotations = piece.GetShapes().rotations;
+  int turns = (best.rotation - start.rotation + rotations) % rotations;
+  for (int i = 0; i < turns; i++) {
+    inputs.emplace_back();
+    inputs.back().Add(Action::kRotate);
+  }
+  int dx = best.x - start.x;
+  for (int i = 0; i < std::abs(dx); i++) {
+    inputs.emplace_back();
+    inputs.back().Add(dx < 0 ? Action::kMoveLeft : Action::kMoveRight);
+  }
+  inputs.emplace_back();
+  inputs.back().Add(Action::kDrop);
+}
+
+// the standard grid is searched on fixed-size boards
+bool AutoPlayer::Search(const Field &field, PieceType type,
+                        const Placement &start, const PieceType *preview,
+                        int previewCount, Placement &best) {
+  if (HasFixedBoards(field.GetWidth(), field.GetHeight()))
+    return Search(_standard, field, type, start, preview, previewCount, best);
+  return Search(_dynamic, field, type, start, preview, previewCount, best);
+}
+
+// searches one level of the plan per piece. Every board of the beam is
+// expanded on the thread pool into all its placements, which are only scored,
+// then the best beamWidth of them become the boards of the next level. Levels
+// stop when the time budget is used up, the first one always completes
+template <typename Board>
+bool AutoPlayer::Search(Workspace<Board> &workspace, const Field &field,
+                        PieceType type, const Placement &start,
+                        const PieceType *preview, int previewCount,
+                        Placement &best) {
+  std::vector<Node<Board>> &beam = workspace.beam;
+  std::vector<Node<Board>> &nextBeam = workspace.nextBeam;
+  Clock::time_point begin = Clock::now();
+  Clock::time_point deadline =
+      begin + std::chrono::microseconds(_config.timeBudgetUs);
+  if (_cache)
+    _cache->NewGeneration();
+
+  SetNode(beam, 0, field, 0, 0.0, start);
+  std::size_t beamSize = 1;
+  bool found = false;
+  int depth = std::min(_config.lookahead, previewCount);
+  for (int d = 0; d <= depth; d++) {
+    if (d > 0 and _config.timeBudgetUs > 0 and Clock::now() >= deadline)
+      break;
+    PieceType t = d == 0 ? type : preview[d - 1];
+    Placement s = d == 0 ? start : Placement{0, field.GetWidth() / 2 - 1, 0};
+    if (_candidates.size() < beamSize) {
+      _candidates.resize(beamSize);
+      _hits.resize(beamSize);
+      _batches.resize(beamSize);
+    }
+    while (workspace.scratch.size() < beamSize)
+      workspace.scratch.push_back(MakeBoard<Board>(field));
+    auto expand = [&](int i) {
+      _hits[i] = Expand(workspace, i, t, s, _candidates[i]);
+    };
+    if (_pool) {
+      _pool->ParallelFor(static_cast<int>(beamSize), expand);
+    } else {
+      for (std::size_t i = 0; i < beamSize; i++)
+        expand(static_cast<int>(i));
+    }
+
+    _merged.clear();
+    for (std::size_t i = 0; i < beamSize; i++) {
+      _merged.insert(_merged.end(), _candidates[i].begin(),
+                     _candidates[i].end());
+      _stats.cacheHits += _hits[i];
+    }
+    _stats.placements += _merged.size();
+    if (_merged.empty())
+      break;
+    std::size_t keep =
+        std::min(_merged.size(), static_cast<std::size_t>(_config.beamWidth));
+    std::partial_sort(_merged.begin(), _merged.begin() + keep, _merged.end(),
+                      [](const Candidate &a, const Candidate &b) {
+                        return a.score > b.score;
+                      });
+
+    // rebuilds the kept boards, each keeps the first placement of its plan
+    for (std::size_t i = 0; i < keep; i++) {
+      const Candidate &c = _merged[i];
+      const Node<Board> &parent = beam[c.parent];
+      SetNode(nextBeam, i, parent.field, c.lines, c.score,
+              d == 0 ? c.placement : parent.first);
+      const ShapeMask &mask =
+          GetPieceShapes(t).masks[c.placement.rotation];
+      nextBeam[i].field.Place(mask, c.placement.x, c.placement.y);
+    }
+    std::swap(beam, nextBeam);
+    beamSize = keep;
+    found = true;
+  }
+  if (found)
+    best = beam[0].first; // the beam is sorted best first
+
+  _stats.searches++;
+  _stats.searchSeconds +=
+      std::chrono::duration<double>(Clock::now() - begin).count();
+  return found;
+}
+
+// scores every placement of the piece reachable from the start: each forward
+// rotation at the start cell, then every column the rotated piece can slide to
+// before it is dropped. Placements leaving a cell above the top end the game
+// and are skipped. A placement found in the cache is neither made nor scored
+// again: the same board position recurs whenever a beam holds equal boards,
+// and every search repeats the levels the previous one looked ahead through.
+// The other boards are collected and their features computed in one batch,
+// so the vector kernels see several boards at once.
+// Returns the number of placements taken from the cache
+template <typename Board>
+int AutoPlayer::Expand(Workspace<Board> &workspace, int parent,
+                       PieceType type, const Placement &start,
+                       std::vector<Candidate> &out) {
+  out.clear();
+  int hits = 0;
+  const Node<Board> &node = workspace.beam[parent];
+  const Board &field = node.field;
+  Board &board = workspace.scratch[parent];
+  Batch &batch = _batches[parent];
+  batch.boards.clear();
+  batch.candidates.clear();
+  batch.entries.clear();
+  batch.keys.clear();
+  const PieceShapes &shapes = GetPieceShapes(type);
+  for (int r = 0; r < shapes.rotations; r++) {
+    int rotation = (start.rotation + r) % shapes.rotations;
+    const ShapeMask &mask = shapes.masks[rotation];
+    if (!field.Fits(mask, start.x, start.y))
+      break;
+    auto evaluate = [&](int x) {
+      std::uint64_t key = 0;
+      TranspositionTable::Entry entry;
+      if (_cache) {
+        key = TranspositionTable::Key(field, type, rotation, x, start.y);
+        if (_cache->Probe(key, entry)) {
+          hits++;
+          int lines = node.lines + entry.lines;
+          out.push_back(Candidate{
+              entry.score + _config.heuristic.linesCleared * lines, parent,
+              lines, {rotation, x, entry.y}});
+          return;
+        }
+      }
+      int y = start.y + field.GetDropDistance(mask, x, start.y);
+      if (y + mask.top < 0)
+        return;
+      board = field;
+      entry.y = y;
+      entry.lines = board.Place(mask, x, y);
+      batch.boards.insert(batch.boards.end(), board.GetRows(),
+                          board.GetRows() + board.GetHeight());
+      batch.candidates.push_back(out.size());
+      batch.entries.push_back(entry);
+      batch.keys.push_back(key);
+      out.push_back(Candidate{0, parent, node.lines + entry.lines,
+                              {rotation, x, y}});
+    };
+    for (int x = start.x; field.Fits(mask, x, start.y); x--)
+      evaluate(x);
+    for (int x = start.x + 1; field.Fits(mask, x, start.y); x++)
+      evaluate(x);
+  }
+
+  ComputeFeatures(batch.boards.data(), batch.candidates.size(),
+                  field.GetWidth(), field.GetHeight(), batch.features,
+                  _config.kernel);
+  for (std::size_t i = 0; i < batch.candidates.size(); i++) {
+    TranspositionTable::Entry &entry = batch.entries[i];
+    entry.score = _config.heuristic.ScoreBoard(batch.features.Get(i));
+    if (_cache)
+      _cache->Store(batch.keys[i], entry);
+    Candidate &candidate = out[batch.candidates[i]];
+    candidate.score =
+        entry.score + _config.heuristic.linesCleared * candidate.lines;
+  }
+  return hits;
+}
@@ -0,0 +1,158 @@
+#ifndef AUTOPLAYER_H
+#define AUTOPLAYER_H
+
+#include "board_features.h"
+#include "field.h"
+#include "shape.h"
+#include "simulation.h"
+#include "thread_pool.h"
+#include "transposition_table.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// weights of the board features, a board scores the weighted sum of its
+// features plus the weighted number of rows cleared to reach it
+struct Heuristic {
+  double aggregateHeight{-0.510066};
+  double linesCleared{0.760666};
+  double holes{-0.35663};
+  double bumpiness{-0.184483};
+  double maxHeight{0};
+  double rowTransitions{0};
+  double columnTransitions{0};
+  double wells{0};
+
+  double Score(const BoardFeatures &f, int lines) const {
+    return ScoreBoard(f) + linesCleared * lines;
+  };
+  // the part of the score that only depends on the board
+  double ScoreBoard(const BoardFeatures &f) const {
+    return aggregateHeight * f.aggregateHeight + holes * f.holes +
+           bumpiness * f.bumpiness + maxHeight * f.maxHeight +
+           rowTransitions * f.rowTransitions +
+           columnTransitions * f.columnTransitions + wells * f.wells;
+  };
+};
+
+// where a piece ends up: its rotation and the center cell it lands on
+struct Placement {
+  int rotation{0};
+  int x{0};
+  int y{0};
+};
+
+// computer player that searches the placements of the current piece and the
+// preview queue with a beam search, and turns the best plan into the inputs
+// a player would give
+class AutoPlayer {
+public:
+  struct Config {
+    Heuristic heuristic;
+    int beamWidth{8};       // boards kept after each piece of the plan
+    int lookahead{2};       // preview pieces searched after the current one
+    int timeBudgetUs{2000}; // search time per piece in microseconds, 0 or
+                            // less searches every level for repeatable plans
+    int threads{0};         // search threads, 0 uses one per hardware core
+                            // and 1 searches on the calling thread
+    int cacheEntries{1 << 15}; // placements remembered between searches in
+                               // a TranspositionTable, 0 disables it
+    FeatureKernel kernel{GetFeatureKernel()}; // computes the board features
+  };
+
+  struct Stats {
+    std::uint64_t searches{0};   // pieces planned
+    std::uint64_t placements{0}; // boards evaluated
+    std::uint64_t cacheHits{0};  // of them found in the transposition table
+    double searchSeconds{0};     // time spent searching
+    double GetPlacementsPerSecond() const {
+      return searchSeconds > 0 ? placements / searchSeconds : 0;
+    };
+    double GetCacheHitRate() const {
+      return placements > 0 ? static_cast<double>(cacheHits) / placements : 0;
+    };
+  };
+
+  explicit AutoPlayer(const Config &config);
+
+  // plans each new piece once and queues the inputs moving it there: the
+  // rotations first, then the moves and a final drop, one input per tick
+  void HandleInput(const Simulation &simulation, std::vector<Input> &inputs);
+
+  // finds the best placement of a piece of the input type currently at the
+  // input placement, looking ahead through the preview types. Returns false
+  // if every placement ends the game
+  bool Search(const Field &field, PieceType type, const Placement &start,
+              const PieceType *preview, int previewCount, Placement &best);
+
+  const Stats &GetStats() const { return _stats; };
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  // returns true if fields of the input size are searched on fixed-size
+  // boards, see BasicField, rather than on runtime-sized ones
+  static bool HasFixedBoards(int width, int height) {
+    return StandardField::HasSize(width, height);
+  };
+
+  // a board in the beam, with the placement of the current piece leading to it
+  template <typename Board> struct Node {
+    Board field;
+    int lines;
+    double score;
+    Placement first;
+  };
+
+  // the boards of a search, kept between searches so a search does not
+  // allocate once warmed up. Searches on the standard grid use fixed-size
+  // boards, any other size uses the runtime-sized Field
+  template <typename Board> struct Workspace {
+    std::vector<Node<Board>> beam;
+    std::vector<Node<Board>> nextBeam;
+    std::vector<Board> scratch; // one board per parent
+  };
+
+  // a placement of a node's piece scored without keeping the board
+  struct Candidate {
+    double score;
+    int parent;
+    int lines;
+    Placement placement;
+  };
+
+  // the placements of a node missing from the cache, whose features are
+  // computed together once all of them are made
+  struct Batch {
+    std::vector<Field::Row> boards;      // their rows, one board after another
+    std::vector<std::size_t> candidates; // their index in the candidates
+    std::vector<TranspositionTable::Entry> entries;
+    std::vector<std::uint64_t> keys;
+    BoardFeatureBatch features;
+  };
+
+  template <typename Board>
+  bool Search(Workspace<Board> &workspace, const Field &field, PieceType type,
+              const Placement &start, const PieceType *preview,
+              int previewCount, Placement &best);
+  template <typename Board>
+  int Expand(Workspace<Board> &workspace, int parent, PieceType type,
+             const Placement &start, std::vector<Candidate> &out);
+
+  Config _config;
+  std::unique_ptr<ThreadPool> _pool; // null when searching on one thread
+  std::unique_ptr<TranspositionTable> _cache; // null when disabled
+  Stats _stats;
+  std::uint64_t _plannedPiece{0}; // piece count when the last plan was made
+
+  // reused between searches so a search does not allocate once warmed up
+  Workspace<StandardField> _standard;
+  Workspace<Field> _dynamic;
+  std::vector<std::vector<Candidate>> _candidates; // one list per parent node
+  std::vector<int> _hits;                          // cache hits per parent
+  std::vector<Batch> _batches;                     // one per parent
+  std::vector<Candidate> _merged;
+};
+
+#endif
@@ -0,0 +1,339 @@
+#include "board_features.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TETRIS_FEATURES_X86 1
+#endif
+
+BoardFeatures ComputeFeatures(const std::uint64_t *rows, int width,
+                              int height) {
+  using Row = std::uint64_t;
+  const Row full = width >= 64 ? ~Row{0} : (Row{1} << width) - 1;
+  const Row leftWall = 1;
+  const Row rightWall = Row{1} << (width - 1);
+  BoardFeatures f;
+  Row seen{0}; // cells at or below the top of their column
+  Row prev{0}; // previous row, the space above the field is empty
+  for (int y = 0; y < height; y++) {
+    Row row = rows[y];
+    f.holes += __builtin_popcountll(seen & ~row);
+    seen |= row;
+    if (seen == 0)
+      continue;
+    if (f.maxHeight == 0)
+      f.maxHeight = height - y;
+    // each column adds one to the aggregate height for every row from its top
+    // down, and adjacent columns differ in height by the number of rows where
+    // exactly one of them has started
+    f.aggregateHeight += __builtin_popcountll(seen);
+    f.bumpiness += __builtin_popcountll((seen ^ (seen >> 1)) & (full >> 1));
+    // the walls count as filled cells
+    f.rowTransitions += __builtin_popcountll((row ^ (row >> 1)) & (full >> 1)) +
+                        !(row & leftWall) + !(row & rightWall);
+    f.columnTransitions += __builtin_popcountll(row ^ prev);
+    Row left = (seen << 1) | leftWall;
+    Row right = (seen >> 1) | rightWall;
+    f.wells += __builtin_popcountll(~seen & left & right & full);
+    prev = row;
+  }
+  // the floor counts as filled
+  f.columnTransitions += __builtin_popcountll(prev ^ full);
+  return f;
+}
+
+void BoardFeatureBatch::Resize(std::size_t size) {
+  for (std::vector<int> *v :
+       {&aggregateHeight, &maxHeight, &holes, &bumpiness, &rowTransitions,
+        &columnTransitions, &wells})
+    v->resize(size);
+}
+
+BoardFeatures BoardFeatureBatch::Get(std::size_t i) const {
+  return BoardFeatures{aggregateHeight[i], maxHeight[i],
+                       holes[i],           bumpiness[i],
+                       rowTransitions[i],  columnTransitions[i],
+                       wells[i]};
+}
+
+void BoardFeatureBatch::Set(std::size_t i, const BoardFeatures &f) {
+  aggregateHeight[i] = f.aggregateHeight;
+  maxHeight[i] = f.maxHeight;
+  holes[i] = f.holes;
+  bumpiness[i] = f.bumpiness;
+  rowTransitions[i] = f.rowTransitions;
+  columnTransitions[i] = f.columnTransitions;
+  wells[i] = f.wells;
+}
+
+namespace {
+
+// the features of one group of boards, one per lane
+struct Lanes {
+  std::uint64_t aggregateHeight[4];
+  std::uint64_t maxHeight[4];
+  std::uint64_t holes[4];
+  std::uint64_t bumpiness[4];
+  std::uint64_t rowTransitions[4];
+  std::uint64_t columnTransitions[4];
+  std::uint64_t wells[4];
+};
+
+void StoreLanes(const Lanes &lanes, int count, std::size_t first,
+                BoardFeatureBatch &out) {
+  for (int l = 0; l < count; l++) {
+    out.Set(first + l,
+            BoardFeatures{static_cast<int>(lanes.aggregateHeight[l]),
+                          static_cast<int>(lanes.maxHeight[l]),
+                          static_cast<int>(lanes.holes[l]),
+                          static_cast<int>(lanes.bumpiness[l]),
+                          static_cast<int>(lanes.rowTransitions[l]),
+                          static_cast<int>(lanes.columnTransitions[l]),
+                          static_cast<int>(lanes.wells[l])});
+  }
+}
+
+#ifdef TETRIS_FEATURES_X86
+
+// The vector kernels follow the scalar loop with two changes. A row above
+// every column counts towards the maximum height by its lane mask instead of
+// ending the search for the top, and the walls are masked off in such rows,
+// which leaves every other feature of them at zero as in the skipped rows of
+// the scalar loop. Population counts are done per byte and summed per lane.
+
+// number of set bits in each byte
+__m128i PopCountBytes(__m128i x) {
+  const __m128i m1 = _mm_set1_epi8(0x55);
+  const __m128i m2 = _mm_set1_epi8(0x33);
+  const __m128i m4 = _mm_set1_epi8(0x0f);
+  x = _mm_sub_epi8(x, _mm_and_si128(_mm_srli_epi16(x, 1), m1));
+  x = _mm_add_epi8(_mm_and_si128(x, m2),
+                   _mm_and_si128(_mm_srli_epi16(x, 2), m2));
+  return _mm_and_si128(_mm_add_epi8(x, _mm_srli_epi16(x, 4)), m4);
+}
+
+// adds the set bits of each lane of the byte counts to the sums
+__m128i AddLanes(__m128i sums, __m128i bytes) {
+  return _mm_add_epi64(sums, _mm_sad_epu8(bytes, _mm_setzero_si128()));
+}
+
+void Store(std::uint64_t *lanes, __m128i v) {
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), v);
+}
+
+void ComputeSse2(const std::uint64_t *boards, std::size_t first, int width,
+                 int height, Lanes &lanes) {
+  const std::uint64_t *rows0 = boards + first * height;
+  const std::uint64_t *rows1 = rows0 + height;
+  const std::uint64_t fullRow =
+      width >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << width) - 1;
+  const __m128i full = _mm_set1_epi64x(fullRow);
+  const __m128i inner = _mm_set1_epi64x(fullRow >> 1);
+  const __m128i leftWall = _mm_set1_epi64x(1);
+  const __m128i rightWall = _mm_set1_epi64x(std::uint64_t{1} << (width - 1));
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi64x(1);
+  __m128i seen = zero;
+  __m128i prev = zero;
+  __m128i aggregateHeight = zero, maxHeight = zero, holes = zero,
+          bumpiness = zero, rowTransitions = zero, columnTransitions = zero,
+          wells = zero;
+  for (int y = 0; y < height; y++) {
+    __m128i row = _mm_set_epi64x(rows1[y], rows0[y]);
+    holes = AddLanes(holes, PopCountBytes(_mm_andnot_si128(row, seen)));
+    seen = _mm_or_si128(seen, row);
+    // SSE2 has no 64-bit compare, a lane is zero when both halves are
+    __m128i empty = _mm_cmpeq_epi32(seen, zero);
+    empty = _mm_and_si128(empty, _mm_shuffle_epi32(empty, 0xb1));
+    __m128i started = _mm_andnot_si128(empty, one);
+    maxHeight = _mm_add_epi64(maxHeight, started);
+    __m128i left = _mm_andnot_si128(empty, leftWall);
+    __m128i right = _mm_andnot_si128(empty, rightWall);
+
+    aggregateHeight = AddLanes(aggregateHeight, PopCountBytes(seen));
+    bumpiness = AddLanes(
+        bumpiness,
+        PopCountBytes(_mm_and_si128(
+            _mm_xor_si128(seen, _mm_srli_epi64(seen, 1)), inner)));
+    __m128i changes = PopCountBytes(
+        _mm_and_si128(_mm_xor_si128(row, _mm_srli_epi64(row, 1)), inner));
+    __m128i walls = _mm_add_epi8(PopCountBytes(_mm_andnot_si128(row, left)),
+                                 PopCountBytes(_mm_andnot_si128(row, right)));
+    rowTransitions = AddLanes(rowTransitions, _mm_add_epi8(changes, walls));
+    columnTransitions = AddLanes(columnTransitions,
+                                 PopCountBytes(_mm_xor_si128(row, prev)));
+    __m128i flanks =
+        _mm_and_si128(_mm_or_si128(_mm_slli_epi64(seen, 1), left),
+                      _mm_or_si128(_mm_srli_epi64(seen, 1), right));
+    wells = AddLanes(wells, PopCountBytes(_mm_andnot_si128(
+                                seen, _mm_and_si128(flanks, full))));
+    prev = row;
+  }
+  columnTransitions =
+      AddLanes(columnTransitions, PopCountBytes(_mm_xor_si128(prev, full)));
+
+  Store(lanes.aggregateHeight, aggregateHeight);
+  Store(lanes.maxHeight, maxHeight);
+  Store(lanes.holes, holes);
+  Store(lanes.bumpiness, bumpiness);
+  Store(lanes.rowTransitions, rowTransitions);
+  Store(lanes.columnTransitions, columnTransitions);
+  Store(lanes.wells, wells);
+}
+
+#define TETRIS_AVX2 __attribute__((target("avx2")))
+
+// number of set bits in each byte, looked up per nibble
+TETRIS_AVX2 __m256i PopCountBytes(__m256i x) {
+  const __m256i table =
+      _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1,
+                       2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low = _mm256_set1_epi8(0x0f);
+  __m256i lo = _mm256_and_si256(x, low);
+  __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), low);
+  return _mm256_add_epi8(_mm256_shuffle_epi8(table, lo),
+                         _mm256_shuffle_epi8(table, hi));
+}
+
+TETRIS_AVX2 __m256i AddLanes(__m256i sums, __m256i bytes) {
+  return _mm256_add_epi64(sums,
+                          _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+}
+
+TETRIS_AVX2 void Store(std::uint64_t *lanes, __m256i v) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), v);
+}
+
+TETRIS_AVX2 void ComputeAvx2(const std::uint64_t *boards, std::size_t first,
+                             int width, int height, Lanes &lanes) {
+  const std::uint64_t *rows0 = boards + first * height;
+  const std::uint64_t *rows1 = rows0 + height;
+  const std::uint64_t *rows2 = rows1 + height;
+  const std::uint64_t *rows3 = rows2 + height;
+  const std::uint64_t fullRow =
+      width >= 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << width) - 1;
+  const __m256i full = _mm256_set1_epi64x(fullRow);
+  const __m256i inner = _mm256_set1_epi64x(fullRow >> 1);
+  const __m256i leftWall = _mm256_set1_epi64x(1);
+  const __m256i rightWall =
+      _mm256_set1_epi64x(std::uint64_t{1} << (width - 1));
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi64x(1);
+  __m256i seen = zero;
+  __m256i prev = zero;
+  __m256i aggregateHeight = zero, maxHeight = zero, holes = zero,
+          bumpiness = zero, rowTransitions = zero, columnTransitions = zero,
+          wells = zero;
+  for (int y = 0; y < height; y++) {
+    __m256i row = _mm256_set_epi64x(rows3[y], rows2[y], rows1[y], rows0[y]);
+    holes = AddLanes(holes, PopCountBytes(_mm256_andnot_si256(row, seen)));
+    seen = _mm256_or_si256(seen, row);
+    __m256i empty = _mm256_cmpeq_epi64(seen, zero);
+    maxHeight = _mm256_add_epi64(maxHeight, _mm256_andnot_si256(empty, one));
+    __m256i left = _mm256_andnot_si256(empty, leftWall);
+    __m256i right = _mm256_andnot_si256(empty, rightWall);
+
+    aggregateHeight = AddLanes(aggregateHeight, PopCountBytes(seen));
+    bumpiness = AddLanes(
+        bumpiness,
+        PopCountBytes(_mm256_and_si256(
+            _mm256_xor_si256(seen, _mm256_srli_epi64(seen, 1)), inner)));
+    __m256i changes = PopCountBytes(_mm256_and_si256(
+        _mm256_xor_si256(row, _mm256_srli_epi64(row, 1)), inner));
+    __m256i walls =
+        _mm256_add_epi8(PopCountBytes(_mm256_andnot_si256(row, left)),
+                        PopCountBytes(_mm256_andnot_si256(row, right)));
+    rowTransitions =
+        AddLanes(rowTransitions, _mm256_add_epi8(changes, walls));
+    columnTransitions = AddLanes(columnTransitions,
+                                 PopCountBytes(_mm256_xor_si256(row, prev)));
+    __m256i flanks =
+        _mm256_and_si256(_mm256_or_si256(_mm256_slli_epi64(seen, 1), left),
+                         _mm256_or_si256(_mm256_srli_epi64(seen, 1), right));
+    wells = AddLanes(wells, PopCountBytes(_mm256_andnot_si256(
+                                seen, _mm256_and_si256(flanks, full))));
+    prev = row;
+  }
+  columnTransitions = AddLanes(columnTransitions,
+                               PopCountBytes(_mm256_xor_si256(prev, full)));
+
+  Store(lanes.aggregateHeight, aggregateHeight);
+  Store(lanes.maxHeight, maxHeight);
+  Store(lanes.holes, holes);
+  Store(lanes.bumpiness, bumpiness);
+  Store(lanes.rowTransitions, rowTransitions);
+  Store(lanes.columnTransitions, columnTransitions);
+  Store(lanes.wells, wells);
+}
+
+#endif
+
+FeatureKernel DetectFeatureKernel() {
+#ifdef TETRIS_FEATURES_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return FeatureKernel::kAvx2;
+  if (__builtin_cpu_supports("sse2"))
+    return FeatureKernel::kSse2;
+#endif
+  return FeatureKernel::kScalar;
+}
+
+} // namespace
+
+FeatureKernel GetFeatureKernel() {
+  static const FeatureKernel kernel = DetectFeatureKernel();
+  return kernel;
+}
+
+bool IsSupported(FeatureKernel kernel) {
+  return static_cast<int>(kernel) <= static_cast<int>(GetFeatureKernel());
+}
+
+const char *GetFeatureKernelName(FeatureKernel kernel) {
+  switch (kernel) {
+  case FeatureKernel::kSse2:
+    return "sse2";
+  case FeatureKernel::kAvx2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+bool ParseFeatureKernel(const std::string &name, FeatureKernel &kernel) {
+  for (FeatureKernel k :
+       {FeatureKernel::kScalar, FeatureKernel::kSse2, FeatureKernel::kAvx2}) {
+    if (name == GetFeatureKernelName(k)) {
+      kernel = k;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ComputeFeatures(const std::uint64_t *boards, std::size_t count,
+                     int width, int height, BoardFeatureBatch &out,
+                     FeatureKernel kernel) {
+  out.Resize(count);
+  if (!IsSupported(kernel))
+    kernel = FeatureKernel::kScalar;
+  std::size_t i = 0;
+#ifdef TETRIS_FEATURES_X86
+  Lanes lanes;
+  if (kernel == FeatureKernel::kAvx2) {
+    for (; i + 4 <= count; i += 4) {
+      ComputeAvx2(boards, i, width, height, lanes);
+      StoreLanes(lanes, 4, i, out);
+    }
+  }
+  if (kernel != FeatureKernel::kScalar) {
+    for (; i + 2 <= count; i += 2) {
+      ComputeSse2(boards, i, width, height, lanes);
+      StoreLanes(lanes, 2, i, out);
+    }
+  }
+#endif
+  // the boards left over from the vector kernels
+  for (; i < count; i++)
+    out.Set(i, ComputeFeatures(boards + i * height, width, height));
+}
@@ -0,0 +1,68 @@
+#ifndef BOARD_FEATURES_H
+#define BOARD_FEATURES_H
+
+#include "field.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// features of a board used to score it, computed from the settled field
+struct BoardFeatures {
+  int aggregateHeight{0};   // sum of the heights of all columns
+  int maxHeight{0};         // height of the tallest column
+  int holes{0};             // empty cells with an occupied cell above them
+  int bumpiness{0};         // sum of height differences of adjacent columns
+  int rowTransitions{0};    // filled/empty changes along the rows
+  int columnTransitions{0}; // filled/empty changes down the columns
+  int wells{0};             // empty cells above the stack flanked on both sides
+};
+
+// computes the features of the rows of a field, top row first. Every feature
+// is derived row by row with bit operations on the running union of the rows
+// seen so far, which marks every cell at or below the top of its column
+BoardFeatures ComputeFeatures(const std::uint64_t *rows, int width,
+                              int height);
+template <int Width, int Height>
+BoardFeatures ComputeFeatures(const BasicField<Width, Height> &field) {
+  return ComputeFeatures(field.GetRows(), field.GetWidth(),
+                         field.GetHeight());
+}
+
+// features of many boards, one array per feature
+struct BoardFeatureBatch {
+  std::vector<int> aggregateHeight;
+  std::vector<int> maxHeight;
+  std::vector<int> holes;
+  std::vector<int> bumpiness;
+  std::vector<int> rowTransitions;
+  std::vector<int> columnTransitions;
+  std::vector<int> wells;
+
+  std::size_t GetSize() const { return holes.size(); };
+  void Resize(std::size_t size);
+  BoardFeatures Get(std::size_t i) const;
+  void Set(std::size_t i, const BoardFeatures &f);
+};
+
+// implementations of the batch computation. The vector kernels run the
+// scalar algorithm on 2 (SSE2) or 4 (AVX2) boards at once, one board per
+// 64-bit lane, and give the same results
+enum class FeatureKernel { kScalar, kSse2, kAvx2 };
+
+// the fastest kernel the CPU supports, detected on the first call
+FeatureKernel GetFeatureKernel();
+bool IsSupported(FeatureKernel kernel);
+const char *GetFeatureKernelName(FeatureKernel kernel);
+// returns false if the name is unknown
+bool ParseFeatureKernel(const std::string &name, FeatureKernel &kernel);
+
+// computes the features of `count` boards of the same size into the batch,
+// which is resized to `count`. The boards are stored one after another, each
+// as its rows top row first. An unsupported kernel falls back to the scalar
+// one
+void ComputeFeatures(const std::uint64_t *boards, std::size_t count,
+                     int width, int height, BoardFeatureBatch &out,
+                     FeatureKernel kernel = GetFeatureKernel());
+
+#endif
@@ -0,0 +1,136 @@
+#include "checkpoint.h"
+#include "logger.h"
+#include "simulation.h"
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::size_t kHeaderSize{12}; // magic, version and state size
+constexpr std::size_t kFileSize{kHeaderSize + sizeof(GameState) + 8};
+
+std::uint64_t Hash(const std::uint8_t *p, std::size_t size) {
+  std::uint64_t hash = 14695981039346656037ull;
+  for (std::size_t i = 0; i < size; i++) {
+    hash ^= p[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// writes the whole buffer, retrying short writes
+bool WriteAll(int fd, const std::uint8_t *p, std::size_t size) {
+  while (size > 0) {
+    ssize_t n = ::write(fd, p, size);
+    if (n < 0)
+      return false;
+    p += n;
+    size -= static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+// syncs the directory holding the input path, so a rename in it survives a
+// power loss
+void SyncDirectory(const std::string &path) {
+  std::size_t slash = path.find_last_of('/');
+  std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+  int fd = ::open(dir.empty() ? "/" : dir.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+  ::fsync(fd);
+  ::close(fd);
+}
+
+} // namespace
+
+bool Checkpoint::Write(const std::string &path, const GameState &state) {
+  std::uint8_t buffer[kFileSize];
+  std::uint32_t header[2] = {kVersion, sizeof(GameState)};
+  std::memcpy(buffer, kMagic, 4);
+  std::memcpy(buffer + 4, header, 8);
+  std::memcpy(buffer + kHeaderSize, &state, sizeof(GameState));
+  std::uint64_t hash = Hash(buffer + kHeaderSize, sizeof(GameState));
+  std::memcpy(buffer + kHeaderSize + sizeof(GameState), &hash, 8);
+
+  std::string temporary = path + ".tmp";
+  int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return false;
+  bool written = WriteAll(fd, buffer, kFileSize) and ::fsync(fd) == 0;
+  written = ::close(fd) == 0 and written;
+  if (!written or ::rename(temporary.c_str(), path.c_str()) != 0) {
+    ::unlink(temporary.c_str());
+    return false;
+  }
+  SyncDirectory(path);
+  return true;
+}
+
+bool Checkpoint::Read(const std::string &path, GameState &state) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  std::uint8_t buffer[kFileSize + 1];
+  std::size_t size = 0;
+  for (ssize_t n; size < sizeof(buffer); size += static_cast<std::size_t>(n)) {
+    n = ::read(fd, buffer + size, sizeof(buffer) - size);
+    if (n <= 0)
+      break;
+  }
+  ::close(fd);
+  std::uint32_t header[2];
+  std::memcpy(header, buffer + 4, 8);
+  if (size != kFileSize or std::memcmp(buffer, kMagic, 4) != 0 or
+      header[0] != kVersion or header[1] != sizeof(GameState))
+    return false;
+  std::uint64_t hash;
+  std::memcpy(&hash, buffer + kHeaderSize + sizeof(GameState), 8);
+  if (hash != Hash(buffer + kHeaderSize, sizeof(GameState)))
+    return false;
+  GameState loaded;
+  std::memcpy(&loaded, buffer + kHeaderSize, sizeof(GameState));
+  // the hash only catches damage, the state must also be one Restore accepts
+  if (!Simulation::CanRestore(loaded))
+    return false;
+  std::memcpy(&state, &loaded, sizeof(GameState));
+  return true;
+}
+
+Checkpointer::~Checkpointer() { Close(); }
+
+void Checkpointer::Open(const std::string &path) {
+  _path = path;
+  _running = true;
+  _thread = std::thread(&Checkpointer::Run, this);
+}
+
+bool Checkpointer::Close() {
+  if (!_thread.joinable())
+    return !_failed;
+  _running = false;
+  _thread.join();
+  WriteLatest();
+  return !_failed;
+}
+
+// writes the latest submitted state if it was not written yet
+void Checkpointer::WriteLatest() {
+  if (!_states.Update())
+    return;
+  if (Checkpoint::Write(_path, _states.GetFront())) {
+    _written++;
+  } else if (!_failed) {
+    LOG_ERROR("Could not write checkpoint");
+    _failed = true;
+  }
+}
+
+void Checkpointer::Run() {
+  while (_running.load()) {
+    WriteLatest();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
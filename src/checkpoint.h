@@ -0,0 +1,64 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "game_state.h"
+#include "triple_buffer.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// a GameState on disk, to resume a session after a restart or a crash. The
+// file is the magic, the version and the size of the state, the state's bytes
+// as they are in memory and an FNV-1a hash of them, so a checkpoint is only
+// meant to be resumed on the kind of machine that wrote it. It is written to
+// a temporary file that is synced and then renamed over the old one, so the
+// path always holds either the previous or the new checkpoint, never a torn
+// one
+namespace Checkpoint {
+constexpr char kMagic[4] = {'T', 'C', 'K', 'P'};
+constexpr std::uint32_t kVersion{1};
+
+// returns false if the file cannot be written, the old checkpoint is kept
+bool Write(const std::string &path, const GameState &state);
+// returns false if the file is missing, truncated, corrupt or holds a state
+// that cannot be restored
+bool Read(const std::string &path, GameState &state);
+} // namespace Checkpoint
+
+// writes checkpoints on a background thread. The simulation hands over its
+// latest state through a triple buffer and never waits on the disk; states
+// saved faster than they can be written are replaced by newer ones
+class Checkpointer {
+public:
+  Checkpointer() = default;
+  ~Checkpointer();
+  Checkpointer(const Checkpointer &) = delete;
+  Checkpointer &operator=(const Checkpointer &) = delete;
+
+  // starts the writer thread
+  void Open(const std::string &path);
+
+  // producer side: the state to fill, then hand it over with Submit
+  GameState &GetState() { return _states.GetBack(); };
+  void Submit() { _states.Publish(); };
+
+  // writes the last submitted state and stops the writer thread, returns
+  // false if any checkpoint could not be written
+  bool Close();
+
+  std::uint64_t GetWritten() const { return _written.load(); };
+
+private:
+  void Run();
+  void WriteLatest();
+
+  std::string _path;
+  TripleBuffer<GameState> _states{GameState{}};
+  std::atomic<bool> _running{false};
+  std::atomic<std::uint64_t> _written{0};
+  bool _failed{false}; // only touched by the writer thread until it stopped
+  std::thread _thread;
+};
+
+#endif
@@ -0,0 +1,178 @@
+#include "config.h"
+#include "game_state.h"
+#include <cstdlib>
+
+namespace {
+constexpr int kWallWidth{1600};
+constexpr int kWallHeight{1000};
+
+// parses the whole argument as a number, returns false if it is not one
+bool ParseNumber(const char *arg, double &value) {
+  char *end;
+  value = std::strtod(arg, &end);
+  return end != arg and *end == '\0';
+}
+} // namespace
+
+bool Config::Parse(int argc, char *argv[], Config &config,
+                   std::string &error) {
+  bool sizeSet = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--autoplay") {
+      config.autoplay = true;
+      continue;
+    } else if (arg == "--software") {
+      config.software = true;
+      continue;
+    } else if (arg == "--resume") {
+      config.resume = true;
+      continue;
+    } else if (arg == "--help") {
+      error.clear();
+      return false;
+    }
+    if (i + 1 >= argc) {
+      error = "unknown option or missing value: " + arg;
+      return false;
+    }
+    const char *value = argv[++i];
+    if (arg == "--record") {
+      config.recordPath = value;
+      continue;
+    } else if (arg == "--replay") {
+      config.replayPath = value;
+      continue;
+    } else if (arg == "--capture") {
+      config.capturePath = value;
+      continue;
+    } else if (arg == "--export") {
+      config.exportPath = value;
+      continue;
+    } else if (arg == "--checkpoint") {
+      config.checkpointPath = value;
+      continue;
+    } else if (arg == "--pacing") {
+      if (!FramePacer::ParseMode(value, config.pacing)) {
+        error = "unknown pacing mode: " + std::string(value);
+        return false;
+      }
+      continue;
+    }
+
+    // the remaining options take a number
+    double number;
+    if (!ParseNumber(value, number)) {
+      error = "not a number: " + arg + " " + value;
+      return false;
+    }
+    int *target = nullptr;
+    double min = 1;
+    double max = 1e6;
+    if (arg == "--fps") {
+      if (number < 1 or number > 1000) {
+        error = "--fps must be between 1 and 1000";
+        return false;
+      }
+      config.framesPerSecond = number;
+      continue;
+    } else if (arg == "--width") {
+      target = &config.screenWidth;
+      max = 16384;
+      sizeSet = true;
+    } else if (arg == "--height") {
+      target = &config.screenHeight;
+      max = 16384;
+      sizeSet = true;
+    } else if (arg == "--max-frames") {
+      target = &config.maxFrames;
+      min = 0;
+      max = 1e9;
+    } else if (arg == "--checkpoint-ms") {
+      target = &config.checkpointMs;
+      max = 3600000;
+    } else if (arg == "--wall") {
+      target = &config.wallBoards;
+      max = 1024;
+    } else if (arg == "--columns") {
+      target = &config.gridWidth;
+      min = Field::kMinWidth;
+      max = Field::kMaxWidth;
+    } else if (arg == "--rows") {
+      target = &config.gridHeight;
+      min = 4;
+      max = Field::kMaxHeight;
+    } else if (arg == "--das") {
+      target = &config.autoShiftDelayMs;
+      min = 0;
+      max = 10000;
+    } else if (arg == "--arr") {
+      target = &config.autoShiftRepeatMs;
+      min = 0;
+      max = 10000;
+    } else {
+      error = "unknown option: " + arg;
+      return false;
+    }
+    if (number < min or number > max) {
+      error = arg + " is out of range";
+      return false;
+    }
+    *target = static_cast<int>(number);
+  }
+  // the default window of the wall is a wide one
+  if (config.wallBoards > 0 and !sizeSet) {
+    config.screenWidth = kWallWidth;
+    config.screenHeight = kWallHeight;
+  }
+  // every cell is drawn with a one pixel border
+  if (config.wallBoards == 0 and
+      (config.screenWidth < 3 * config.gridWidth or
+       config.screenHeight < 3 * config.gridHeight)) {
+    error = "the window is too small for the grid";
+    return false;
+  }
+  if (config.resume and config.checkpointPath.empty()) {
+    error = "--resume needs a --checkpoint to resume from";
+    return false;
+  }
+  // a replay always starts at the first tick of its game
+  if (config.resume and
+      !(config.recordPath.empty() and config.replayPath.empty())) {
+    error = "--resume cannot be combined with --record or --replay";
+    return false;
+  }
+  if (!config.checkpointPath.empty() and
+      config.gridHeight > GameState::kMaxHeight) {
+    error = "checkpoints hold at most 32 rows";
+    return false;
+  }
+  return true;
+}
+
+const char *Config::GetUsage() {
+  return "options:\n"
+         "  --help               print this message\n"
+         "  --autoplay           let the computer play\n"
+         "  --record PATH        record the session to a replay file\n"
+         "  --replay PATH        play a replay file back\n"
+         "  --capture PATH       capture the frames to PATH.y4m or PATH.ppm\n"
+         "  --export PATH        render the replay or the autoplayer's game\n"
+         "                       offline to PATH.y4m or PATH.ppm\n"
+         "  --max-frames N       frames exported at most\n"
+         "  --checkpoint PATH    save the game to PATH periodically and on "
+         "exit\n"
+         "  --checkpoint-ms MS   interval of the checkpoints, default 1000\n"
+         "  --resume             continue the game saved in the checkpoint\n"
+         "  --pacing MODE        vsync, uncapped or paced (default)\n"
+         "  --fps N              frame rate when paced, default 60\n"
+         "  --width N            window width in pixels, default 480\n"
+         "  --height N           window height in pixels, default 960\n"
+         "  --columns N          grid width in cells (4-64), default 10\n"
+         "  --rows N             grid height in cells, default 20\n"
+         "  --das MS             delay before a held key repeats, default "
+         "150\n"
+         "  --arr MS             interval of the repeats, default 30\n"
+         "  --wall N             watch N bot games at once\n"
+         "  --software           render without the GPU\n";
+}
@@ -0,0 +1,39 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "auto_shift.h"
+#include "frame_pacer.h"
+#include <string>
+
+// settings of the game, with defaults that can be overridden on the command
+// line
+struct Config {
+  int screenWidth{480};
+  int screenHeight{960};
+  int gridWidth{10};
+  int gridHeight{20};
+  double framesPerSecond{60}; // frame rate when paced
+  PacingMode pacing{PacingMode::kPaced};
+  int autoShiftDelayMs{AutoShift::kDefaultDelayMs};
+  int autoShiftRepeatMs{AutoShift::kDefaultRepeatMs};
+  bool autoplay{false};   // lets the computer play
+  std::string recordPath; // records the session when not empty
+  std::string replayPath; // replays a session when not empty
+  std::string capturePath; // captures the presented frames when not empty
+  std::string exportPath;  // renders the game offline when not empty
+  int maxFrames{0};        // frames exported at most, 0 for the whole game
+  std::string checkpointPath; // checkpoints the game when not empty
+  int checkpointMs{1000};     // interval between two checkpoints
+  bool resume{false};         // continues the game of the checkpoint
+  int wallBoards{0};       // shows that many bot games at once when not 0
+  bool software{false};    // renders without the GPU
+
+  // reads the options of the command line into the config, returns false and
+  // a message if an option is unknown, lacks its value or is out of range. The
+  // message is empty when --help asks for the usage
+  static bool Parse(int argc, char *argv[], Config &config,
+                    std::string &error);
+  static const char *GetUsage();
+};
+
+#endif
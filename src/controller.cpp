@@ -1,29 +1,51 @@
 #include "controller.h"
 #include "SDL.h"
-#include "piece.h"
 #include <iostream>
 
-// controls the piece with arrow keys
-void Controller::HandleInput(bool &running, Piece &piece) const {
+namespace {
+Action ActionOf(SDL_Keycode key) {
+  switch (key) {
+  case SDLK_LEFT:
+    return Action::kMoveLeft;
+  case SDLK_RIGHT:
+    return Action::kMoveRight;
+  case SDLK_UP:
+    return Action::kRotate;
+  case SDLK_DOWN:
+    return Action::kDrop;
+  default:
+    return Action::kNone;
+  }
+}
+} // namespace
+
+// controls the piece with arrow keys, every press and release is reported
+// with its SDL timestamp converted to the steady clock, so the simulation can
+// apply it at the tick it happened. Key repeats of the OS are ignored, holding
+// a move key repeats according to the game's own auto-shift settings. F3
+// toggles the performance overlay
+void Controller::HandleInput(bool &running, bool &overlay,
+                             std::vector<KeyEvent> &events) const {
   SDL_Event e;
   while (SDL_PollEvent(&e)) {
     if (e.type == SDL_QUIT) {
       running = false;
-    } else if (e.type == SDL_KEYDOWN) {
-      switch (e.key.keysym.sym) {
-      case SDLK_LEFT:
-        piece.Move(Direction::kLeft);
-        break;
-      case SDLK_RIGHT:
-        piece.Move(Direction::kRight);
-        break;
-      case SDLK_UP:
-        piece.Rotate(Rotation::kForward);
-        break;
-      case SDLK_DOWN:
-        piece.Drop();
-        break;
+    } else if (e.type == SDL_KEYDOWN or e.type == SDL_KEYUP) {
+      bool pressed = e.type == SDL_KEYDOWN;
+      if (e.key.repeat != 0)
+        continue;
+      if (pressed and e.key.keysym.sym == SDLK_F3) {
+        overlay = !overlay;
+        continue;
       }
+      Action action = ActionOf(e.key.keysym.sym);
+      if (action == Action::kNone)
+        continue;
+      // the event's age in milliseconds, SDL timestamps use SDL_GetTicks
+      Uint32 age = SDL_GetTicks() - e.key.timestamp;
+      events.push_back(KeyEvent{std::chrono::steady_clock::now() -
+                                    std::chrono::milliseconds(age),
+                                action, pressed});
     }
   }
 }
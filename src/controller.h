@@ -1,11 +1,22 @@
 #ifndef CONTROLLER_H
 #define CONTROLLER_H
 
-#include "piece.h"
+#include "simulation.h"
+#include <chrono>
+#include <vector>
+
+// a game key pressed or released, with the time SDL received it
+struct KeyEvent {
+  std::chrono::steady_clock::time_point time;
+  Action action{Action::kNone};
+  bool pressed{true};
+};
 
 class Controller {
 public:
-  void HandleInput(bool &running, Piece &piece) const;
+  // reads every pending SDL event, can be called several times per frame
+  void HandleInput(bool &running, bool &overlay,
+                   std::vector<KeyEvent> &events) const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,44 +1,287 @@
 #include "field.h"
 #include <algorithm>
+#include <stdexcept>
 #include <vector>
 
-Field::Field(int gridWidth, int gridHeight)
+namespace {
+// returns base^exponent modulo 2^64
+std::uint64_t Power(std::uint64_t base, int exponent) {
+  std::uint64_t result = 1;
+  for (; exponent > 0; exponent >>= 1, base *= base) {
+    if (exponent & 1)
+      result *= base;
+  }
+  return result;
+}
+} // namespace
+
+template <int Width, int Height>
+BasicField<Width, Height>::BasicField(int gridWidth, int gridHeight)
     : _gridWidth(gridWidth), _gridHeight(gridHeight),
-      _grid(gridHeight, std::vector<int>(gridWidth, 0)){};
+      _fullRow(gridWidth >= kMaxWidth ? ~Row{0}
+                                      : (Row{1} << gridWidth) - 1),
+      _stackTop(gridHeight) {
+  if (gridWidth < kMinWidth or gridWidth > kMaxWidth or gridHeight <= 0)
+    throw std::invalid_argument("Field must be 4-64 columns wide and have at "
+                                "least one row");
+  if (!HasSize(gridWidth, gridHeight))
+    throw std::invalid_argument("Field size differs from its type");
+  if constexpr (kFixedSize) {
+    _rows.fill(0);
+    _columnTops.fill(gridHeight);
+  } else {
+    _rows.assign(2 * gridHeight, 0);
+    _columnTops.assign(gridWidth, gridHeight);
+  }
+};
+
+// see ShapeFits
+template <int Width, int Height>
+bool BasicField<Width, Height>::Fits(const ShapeMask &shape, int centerX,
+                                     int centerY) const {
+  return ShapeFits(shape, centerX, centerY, GetRows(), GetWidth(), GetHeight());
+}
+
+// overwrites one row, used to set up or restore a field
+template <int Width, int Height>
+void BasicField<Width, Height>::SetRow(int y, Row row) {
+  row &= _fullRow;
+  Row removed = GetRow(y) & ~row;
+  _hash += (RowKey(row) - RowKey(GetRow(y))) * Power(kHashBase, y);
+  Write(y, row);
+  if (row)
+    _stackTop = std::min(_stackTop, y);
+  for (Row bits = row; bits != 0; bits &= bits - 1) {
+    int x = __builtin_ctzll(bits);
+    _columnTops[x] = std::min(_columnTops[x], y);
+  }
+  // columns whose top cell was removed continue further down
+  Row lost{0};
+  for (Row bits = removed; bits != 0; bits &= bits - 1) {
+    int x = __builtin_ctzll(bits);
+    if (_columnTops[x] == y)
+      lost |= Row{1} << x;
+  }
+  FindColumnTops(lost, y + 1);
+}
 
-// adds the cells of the piece to the field by updating the corresponding
-// elements in the 2D vector with 1
-void Field::AddPiece(const Piece &piece) {
-  int row = 0;
-  for (auto &c : piece.GetBody()) {
-    _grid[c[1]][c[0]] = 1;
-    row = std::max(row, c[1]);
+// overwrites every row at once, top row first, and rebuilds the skyline in
+// one pass, used to restore a whole field
+template <int Width, int Height>
+void BasicField<Width, Height>::SetRows(const Row *rows) {
+  _origin = 0;
+  _stackTop = GetHeight();
+  _hash = 0;
+  for (int y = GetHeight() - 1; y >= 0; y--) {
+    Row row = rows[y] & _fullRow;
+    _rows[y] = row;
+    if constexpr (kRing)
+      _rows[y + GetHeight()] = row;
+    _hash = _hash * kHashBase + RowKey(row);
+    if (row)
+      _stackTop = y;
   }
-  ClearFrom(row);
+  FindColumnTops(_fullRow, _stackTop);
+}
+
+// writes a row, both copies of it in a ring
+template <int Width, int Height>
+void BasicField<Width, Height>::Write(int y, Row row) {
+  if constexpr (!kRing) {
+    _rows[y] = row;
+    return;
+  }
+  int i = _origin + y;
+  if (i >= GetHeight())
+    i -= GetHeight();
+  _rows[i] = row;
+  _rows[i + GetHeight()] = row;
+}
+
+// adds the cells of the piece to the field by setting the corresponding bits,
+// cells above the top of the field are dropped
+template <int Width, int Height>
+void BasicField<Width, Height>::AddPiece(const Piece &piece) {
+  Place(piece.GetMask(), piece.GetCenterCellX(), piece.GetCenterCellY());
 };
 
+// adds the cells of the shape centered at the input cell and clears the rows
+// it completes, returns the number of rows cleared
+template <int Width, int Height>
+int BasicField<Width, Height>::Place(const ShapeMask &shape, int centerX,
+                                     int centerY) {
+  int x = centerX + shape.left;
+  int y = centerY + shape.top;
+  int row = -1;
+  int full = 0;
+  int firstFull = -1;
+  std::uint64_t weight = Power(kHashBase, std::max(0, y));
+  for (int i = std::max(0, -y); i < shape.height; i++, weight *= kHashBase) {
+    Row old = GetRow(y + i);
+    Row r = old | shape.rows[i] << x;
+    _hash += (RowKey(r) - RowKey(old)) * weight;
+    Write(y + i, r);
+    if (r == _fullRow) {
+      full++;
+      firstFull = firstFull < 0 ? y + i : firstFull;
+    }
+    row = y + i;
+  }
+  if (row < 0)
+    return 0;
+  int top = std::max(0, y);
+  _stackTop = std::min(_stackTop, top);
+  UpdateColumnTops(shape, x, y);
+  if (full == 0)
+    return 0;
+  // either the rows above the cleared ones move down, or the rows below them
+  // move up and the ring turns so the freed rows become the top ones,
+  // whichever moves fewer rows. Either way the rows below the piece keep
+  // their index and the rows above it move down by the cleared rows, which
+  // multiplies their part of the hash by kHashBase^full. Only the part of the
+  // side whose rows move is summed, the other one is what remains of the hash
+  std::uint64_t piece = HashRows(top, row);
+  std::uint64_t above, below;
+  if (kRing and GetHeight() - top < row - _stackTop) {
+    below = HashRows(row + 1, GetHeight() - 1);
+    above = _hash - piece - below;
+    ClearByRotation(top, full);
+  } else {
+    above = HashRows(_stackTop, top - 1);
+    below = _hash - piece - above;
+    ClearFrom(row);
+  }
+  _hash = above * Power(kHashBase, full) + HashRows(top + full, row) + below;
+
+  // a full row has a cell in every column, so every column top is at or
+  // above the first cleared row. Tops above it move down with their rows,
+  // the columns whose top was cleared continue at their next cell below
+  Row lost{0};
+  for (int c = 0; c < GetWidth(); c++) {
+    if (_columnTops[c] < firstFull)
+      _columnTops[c] += full;
+    else
+      lost |= Row{1} << c;
+  }
+  FindColumnTops(lost, firstFull);
+  return full;
+}
+
+// returns the part of the hash of the rows from..to, both included
+template <int Width, int Height>
+std::uint64_t BasicField<Width, Height>::HashRows(int from, int to) const {
+  if (from > to)
+    return 0;
+  std::uint64_t hash = 0;
+  for (int y = to; y >= from; y--)
+    hash = hash * kHashBase + RowKey(GetRow(y));
+  return hash * Power(kHashBase, from);
+}
+
+// lowers the tops of the columns covered by a shape placed with its bounding
+// box at the input cell
+template <int Width, int Height>
+void BasicField<Width, Height>::UpdateColumnTops(const ShapeMask &shape,
+                                                 int x, int y) {
+  Row pending = shape.columns << x;
+  for (int i = std::max(0, -y); i < shape.height and pending != 0; i++) {
+    Row hit = (shape.rows[i] << x) & pending;
+    pending &= ~hit;
+    for (; hit != 0; hit &= hit - 1) {
+      int c = __builtin_ctzll(hit);
+      _columnTops[c] = std::min(_columnTops[c], y + i);
+    }
+  }
+}
+
+// finds the tops of the input columns by scanning down from the input row,
+// all columns at once
+template <int Width, int Height>
+void BasicField<Width, Height>::FindColumnTops(Row columns, int fromRow) {
+  for (int y = fromRow; y < GetHeight() and columns != 0; y++) {
+    for (Row hit = GetRow(y) & columns; hit != 0; hit &= hit - 1)
+      _columnTops[__builtin_ctzll(hit)] = y;
+    columns &= ~GetRow(y);
+  }
+  for (; columns != 0; columns &= columns - 1)
+    _columnTops[__builtin_ctzll(columns)] = GetHeight();
+}
+
+// returns the number of cells the shape centered at the input cell can
+// descend before landing. While the shape is above the top of every column it
+// covers, it falls until its lowest cell in some column rests on that
+// column's top, which takes one lookup per column. Otherwise (e.g. a piece
+// slid under an overhang) it is moved down one row at a time until it no
+// longer fits, each test being one AND per row of the shape
+template <int Width, int Height>
+int BasicField<Width, Height>::GetDropDistance(const ShapeMask &shape,
+                                               int centerX,
+                                               int centerY) const {
+  int x = centerX + shape.left;
+  if (x >= 0 and x + shape.width <= GetWidth()) {
+    int distance = GetHeight();
+    bool above = true;
+    for (int i = 0; i < shape.width; i++) {
+      int gap = _columnTops[x + i] - 1 - (centerY + shape.bottoms[i]);
+      above = above and gap >= 0;
+      distance = std::min(distance, gap);
+    }
+    if (above)
+      return distance;
+  }
+  int moves{0};
+  while (Fits(shape, centerX, centerY + moves + 1))
+    moves++;
+  return moves;
+}
+
 // clears rows above and includes the current row in the field
-void Field::ClearFrom(const int &row) {
+template <int Width, int Height>
+void BasicField<Width, Height>::ClearFrom(const int &row) {
   int cleared{0};
-  int s;
-  for (int i = row; i >= 0; i--) {
-    // computes the number of grids in each row
-    s = std::reduce(_grid[i].begin(), _grid[i].end());
-    if (s == 0) {
+  int i = row;
+  for (; i >= 0; i--) {
+    Row r = GetRow(i);
+    if (r == 0) {
       break;
-    } else if (s == _gridWidth) {
-      // the current row is full, clears it by setting all elements to 0
-      for (int &v : _grid[i])
-        v = 0;
+    } else if (r == _fullRow) {
+      // the current row is full, clears it
+      Write(i, 0);
       cleared++;
     } else if (cleared > 0) {
-      // if the current row has grids, move them down by number of rows cleared
+      // if the current row has cells, move them down by number of rows cleared
       // so far
-      for (int j = 0; j < _gridWidth; j++) {
-        _grid[i + cleared][j] = _grid[i][j];
-        _grid[i][j] = 0;
-      }
+      Write(i + cleared, r);
+      Write(i, 0);
     }
   }
+  _stackTop = std::min(GetHeight(), _stackTop + cleared);
   _rowsCleared += cleared;
-};
\ No newline at end of file
+};
+
+// clears the full rows from the input row on by moving the rows below them
+// up, then turns the ring back by the number of cleared rows: the emptied
+// bottom rows become the top ones and everything above the cleared rows ends
+// up where ClearFrom would have moved it, without being touched
+template <int Width, int Height>
+void BasicField<Width, Height>::ClearByRotation(int top, int cleared) {
+  int w = top;
+  for (int i = top; i < GetHeight(); i++) {
+    Row r = GetRow(i);
+    if (r == _fullRow)
+      continue;
+    if (w != i)
+      Write(w, r);
+    w++;
+  }
+  for (; w < GetHeight(); w++)
+    Write(w, 0);
+  _origin -= cleared;
+  if (_origin < 0)
+    _origin += GetHeight();
+  _stackTop = std::min(GetHeight(), _stackTop + cleared);
+  _rowsCleared += cleared;
+}
+
+template class BasicField<0, 0>;
+template class BasicField<10, 20>;
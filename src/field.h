@@ -2,31 +2,127 @@
 #define FIELD_H
 
 #include "piece.h"
+#include "random.h"
+#include "shape.h"
+#include <array>
+#include <cstdint>
+#include <type_traits>
 #include <vector>
 
 class Piece;
 
-class Field {
+// a field is sized at runtime, a field whose type gives a size other than
+// 0x0 has that size fixed at compile time. Both share one implementation:
+// with a fixed size the rows and the skyline are arrays inside the object,
+// so copying a board touches no heap memory and is about 3x faster. Placing
+// a piece and clearing rows touch only a few rows and cost about the same for
+// both. Fixed-size fields are meant to be small, so they keep their rows in
+// order instead of in a ring, which halves their size, and clears always move
+// the rows above down. Only the sizes instantiated in field.cpp can be used
+template <int Width, int Height> class BasicField;
+
+// returns true if the shape centered at the input cell stays inside the side
+// walls and the bottom of a grid of the input size, given by its rows top row
+// first, without overlapping any occupied cell. Rows above the top of the grid
+// are always free
+inline bool ShapeFits(const ShapeMask &shape, int centerX, int centerY,
+                      const std::uint64_t *rows, int width, int height) {
+  int x = centerX + shape.left;
+  int y = centerY + shape.top;
+  if (x < 0 or x + shape.width > width or y + shape.height > height)
+    return false;
+  for (int i = y < 0 ? -y : 0; i < shape.height; i++) {
+    if (rows[y + i] & (shape.rows[i] << x))
+      return false;
+  }
+  return true;
+}
+
+using Field = BasicField<0, 0>;
+using StandardField = BasicField<10, 20>; // the default grid
+
+template <int Width, int Height> class BasicField {
 public:
-  Field(int gridWidth, int gridHeight);
+  using Row = std::uint64_t; // one bit per column, bit 0 = left-most column
+  static constexpr int kMaxWidth{64};
+  // pieces spawn with cells from one column left to two columns right of
+  // width / 2 - 1, which lies inside the field from 4 columns on
+  static constexpr int kMinWidth{4};
+  // tallest grid the game and the file formats accept
+  static constexpr int kMaxHeight{4096};
+  static constexpr bool kFixedSize{Width > 0};
+  static constexpr bool kRing{!kFixedSize}; // see _rows
+  static_assert((Width > 0) == (Height > 0) and
+                    (Width == 0 or Width >= kMinWidth) and Width <= kMaxWidth,
+                "a fixed size needs 4-64 columns and at least one row");
+
+  // throws if a fixed size field is given another size
+  BasicField(int gridWidth, int gridHeight);
+
+  // returns true if a field of this type can have the input size
+  static constexpr bool HasSize(int gridWidth, int gridHeight) {
+    return !kFixedSize or (gridWidth == Width and gridHeight == Height);
+  };
 
   // getters
-  int GetWidth() const { return _gridWidth; };
-  int GetHeight() const { return _gridHeight; };
-  const std::vector<std::vector<int>> &GetGrid() const { return _grid; };
+  int GetWidth() const { return kFixedSize ? Width : _gridWidth; };
+  int GetHeight() const { return kFixedSize ? Height : _gridHeight; };
+  Row GetFullRow() const { return _fullRow; };
+  Row GetRow(int y) const { return _rows[GetOrigin() + y]; };
+  // returns the rows in order, top row first, valid until the field changes
+  const Row *GetRows() const { return _rows.data() + GetOrigin(); };
+  bool IsOccupied(int x, int y) const {
+    return (_rows[GetOrigin() + y] >> x) & 1;
+  };
+  // returns the row of the highest occupied cell of a column, or the height
+  // of the field if the column is empty
+  int GetColumnTop(int x) const { return _columnTops[x]; };
+  // hash of the settled cells, equal for equal fields of the same size and
+  // kept up to date by every change. It is the sum of the keys of the rows,
+  // each weighted by kHashBase to the power of the row's index. A row's key
+  // depends only on its cells and an empty row has key 0, so moving k rows
+  // down multiplies their part of the sum by kHashBase^k
+  std::uint64_t GetHash() const { return _hash; };
 
   // behavior methods
+  void SetRow(int y, Row row);
+  void SetRows(const Row *rows);
+  bool Fits(const ShapeMask &shape, int centerX, int centerY) const;
+  int GetDropDistance(const ShapeMask &shape, int centerX, int centerY) const;
+  int Place(const ShapeMask &shape, int centerX, int centerY);
   void AddPiece(const Piece &piece);
-  int GetRowsCleared() { return _rowsCleared; };
+  int GetRowsCleared() const { return _rowsCleared; };
+  void SetRowsCleared(int rows) { _rowsCleared = rows; };
 
 private:
+  int GetOrigin() const { return kRing ? _origin : 0; };
+  void Write(int y, Row row);
   void ClearFrom(const int &row);
+  void ClearByRotation(int top, int cleared);
+  void UpdateColumnTops(const ShapeMask &shape, int x, int y);
+  void FindColumnTops(Row columns, int fromRow);
+  std::uint64_t HashRows(int from, int to) const;
+  static std::uint64_t RowKey(Row row) {
+    return row == 0 ? 0 : SplitMix64(row);
+  };
+  static constexpr std::uint64_t kHashBase = 0x9e3779b97f4a7c15ull;
+
+  template <typename T, std::size_t N>
+  using Storage =
+      std::conditional_t<kFixedSize, std::array<T, N>, std::vector<T>>;
 
   int _gridWidth;
   int _gridHeight;
   int _rowsCleared{0};
-  std::vector<std::vector<int>>
-      _grid; // 2d vector with 0 and 1, 0 = empty, 1 = occupied
+  Row _fullRow; // mask with the lowest _gridWidth bits set
+  // ring of one word per row holding the rows in order from _origin on. The
+  // ring is stored twice in a row, so the rows are always contiguous. Without
+  // a ring the rows are stored once and _origin stays 0
+  Storage<Row, Height> _rows;
+  int _origin{0};   // index of the top row in _rows
+  int _stackTop;    // no row above it is occupied
+  Storage<int, Width> _columnTops; // skyline, see GetColumnTop
+  std::uint64_t _hash{0};          // see GetHash
 };
 
-#endif
\ No newline at end of file
+#endif
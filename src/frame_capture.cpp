@@ -0,0 +1,171 @@
+#include "frame_capture.h"
+#include "logger.h"
+#include <algorithm>
+#include <cinttypes>
+
+FrameCapture::FrameCapture(int width, int height, double framesPerSecond,
+                           int threads, int buffers)
+    : _width(width), _height(height), _framesPerSecond(framesPerSecond),
+      _pool(threads) {
+  std::size_t chroma = static_cast<std::size_t>((width + 1) / 2) *
+                       ((height + 1) / 2);
+  for (int i = 0; i < std::max(1, buffers); i++) {
+    auto frame = std::make_unique<Frame>();
+    frame->pixels.resize(static_cast<std::size_t>(3) * width * height);
+    frame->yuv.resize(static_cast<std::size_t>(width) * height + 2 * chroma);
+    _free.push_back(frame.get());
+    _frames.push_back(std::move(frame));
+  }
+}
+
+FrameCapture::~FrameCapture() { Close(); }
+
+bool FrameCapture::Open(const std::string &path) {
+  auto endsWith = [&path](const char *suffix) {
+    std::string s(suffix);
+    return path.size() >= s.size() and
+           path.compare(path.size() - s.size(), s.size(), s) == 0;
+  };
+  if (endsWith(".ppm")) {
+    _format = Format::kPpm;
+    _path = path.substr(0, path.size() - 4);
+    return true;
+  }
+  if (!endsWith(".y4m"))
+    return false;
+  _format = Format::kY4m;
+  _stream = std::fopen(path.c_str(), "wb");
+  if (_stream == nullptr)
+    return false;
+  // the frame rate is written as a fraction in thousandths
+  std::fprintf(_stream, "YUV4MPEG2 W%d H%d F%d:1000 Ip A1:1 C420jpeg\n",
+               _width, _height,
+               static_cast<int>(_framesPerSecond * 1000 + 0.5));
+  return true;
+}
+
+FrameCapture::Frame *FrameCapture::Acquire(bool wait) {
+  std::unique_lock<std::mutex> lck(_mutex);
+  if (wait)
+    _freed.wait(lck, [this] { return !_free.empty(); });
+  if (_free.empty()) {
+    _dropped++;
+    return nullptr;
+  }
+  Frame *frame = _free.back();
+  _free.pop_back();
+  frame->index = _nextIndex++;
+  frame->encoded = false;
+  return frame;
+}
+
+void FrameCapture::Submit(Frame *frame) {
+  _pool.Submit([this, frame] { Encode(frame); });
+}
+
+// runs on the pool: an image is written right away, a frame of the stream is
+// converted and then written once every frame before it has been
+void FrameCapture::Encode(Frame *frame) {
+  if (_format == Format::kPpm) {
+    WritePpm(*frame);
+    Release(frame);
+    return;
+  }
+  ConvertToYuv(*frame);
+  std::lock_guard<std::mutex> lck(_mutex);
+  frame->encoded = true;
+  _queued.push_back(frame);
+  // writes the queued frames that are next in order
+  while (true) {
+    auto next = std::find_if(_queued.begin(), _queued.end(), [this](Frame *f) {
+      return f->index == _nextWrite;
+    });
+    if (next == _queued.end())
+      break;
+    Frame *f = *next;
+    _queued.erase(next);
+    if (std::fputs("FRAME\n", _stream) < 0 or
+        std::fwrite(f->yuv.data(), 1, f->yuv.size(), _stream) !=
+            f->yuv.size()) {
+      if (!_failed.exchange(true))
+        LOG_ERROR("could not write frame {} of the capture", f->index);
+    } else {
+      _written++;
+    }
+    _nextWrite++;
+    _free.push_back(f);
+    _freed.notify_one();
+  }
+}
+
+void FrameCapture::WritePpm(const Frame &frame) {
+  char suffix[32];
+  std::snprintf(suffix, sizeof(suffix), "_%06" PRIu64 ".ppm", frame.index);
+  std::FILE *file = std::fopen((_path + suffix).c_str(), "wb");
+  bool ok = file != nullptr and
+            std::fprintf(file, "P6\n%d %d\n255\n", _width, _height) > 0 and
+            std::fwrite(frame.pixels.data(), 1, frame.pixels.size(), file) ==
+                frame.pixels.size();
+  if (file != nullptr and std::fclose(file) != 0)
+    ok = false;
+  if (ok)
+    _written++;
+  else if (!_failed.exchange(true))
+    LOG_ERROR("could not write frame {} of the capture", frame.index);
+}
+
+// converts RGB to full range BT.601 YUV with fixed point weights. Every
+// chroma sample averages a 2x2 block, or the pixels of it that exist at an
+// odd right or bottom edge
+void FrameCapture::ConvertToYuv(Frame &frame) const {
+  const std::uint8_t *rgb = frame.pixels.data();
+  std::uint8_t *y = frame.yuv.data();
+  int chromaWidth = (_width + 1) / 2;
+  int chromaHeight = (_height + 1) / 2;
+  std::uint8_t *u = y + static_cast<std::size_t>(_width) * _height;
+  std::uint8_t *v = u + static_cast<std::size_t>(chromaWidth) * chromaHeight;
+  for (int row = 0; row < _height; row++) {
+    const std::uint8_t *p = rgb + static_cast<std::size_t>(row) * 3 * _width;
+    for (int col = 0; col < _width; col++, p += 3)
+      y[row * _width + col] =
+          static_cast<std::uint8_t>((77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8);
+  }
+  for (int cy = 0; cy < chromaHeight; cy++) {
+    for (int cx = 0; cx < chromaWidth; cx++) {
+      int r = 0, g = 0, b = 0, n = 0;
+      for (int dy = 0; dy < 2 and 2 * cy + dy < _height; dy++) {
+        for (int dx = 0; dx < 2 and 2 * cx + dx < _width; dx++, n++) {
+          const std::uint8_t *p =
+              rgb + (static_cast<std::size_t>(2 * cy + dy) * _width + 2 * cx +
+                     dx) * 3;
+          r += p[0];
+          g += p[1];
+          b += p[2];
+        }
+      }
+      r /= n;
+      g /= n;
+      b /= n;
+      u[cy * chromaWidth + cx] =
+          static_cast<std::uint8_t>(((-43 * r - 85 * g + 128 * b) >> 8) + 128);
+      v[cy * chromaWidth + cx] =
+          static_cast<std::uint8_t>(((128 * r - 107 * g - 21 * b) >> 8) + 128);
+    }
+  }
+}
+
+void FrameCapture::Release(Frame *frame) {
+  std::lock_guard<std::mutex> lck(_mutex);
+  _free.push_back(frame);
+  _freed.notify_one();
+}
+
+bool FrameCapture::Close() {
+  _pool.Wait();
+  if (_stream != nullptr) {
+    if (std::fclose(_stream) != 0)
+      _failed = true;
+    _stream = nullptr;
+  }
+  return !_failed.load();
+}
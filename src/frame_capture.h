@@ -0,0 +1,90 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include "thread_pool.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// writes captured frames to an image sequence or a video stream. The frame
+// loop reads the pixels back into one of a fixed set of buffers and submits
+// it; converting and writing happen on a thread pool, so capturing costs the
+// frame loop one readback and never waits on encoding or the disk. When every
+// buffer is still being encoded the loop either drops the frame or, when it
+// renders offline, waits for a buffer
+class FrameCapture {
+public:
+  enum class Format {
+    kPpm, // one binary PPM image per frame, path_000000.ppm and so on
+    kY4m  // one YUV4MPEG2 stream with 4:2:0 chroma, readable by most players
+  };
+
+  // pixels of one frame, RGB with three bytes per pixel and no padding
+  struct Frame {
+    std::vector<std::uint8_t> pixels;
+    std::vector<std::uint8_t> yuv; // converted pixels of a Y4M stream
+    std::uint64_t index{0};        // position in the capture
+    bool encoded{false};           // converted, waiting to be written
+  };
+
+  FrameCapture(int width, int height, double framesPerSecond, int threads = 0,
+               int buffers = 8);
+  ~FrameCapture();
+
+  FrameCapture(const FrameCapture &) = delete;
+  FrameCapture &operator=(const FrameCapture &) = delete;
+
+  // picks the format from the extension of the path (.ppm or .y4m) and
+  // creates the stream, returns false if the format is unknown or the file
+  // cannot be created
+  bool Open(const std::string &path);
+
+  int GetWidth() const { return _width; };
+  int GetHeight() const { return _height; };
+  int GetPitch() const { return 3 * _width; };
+
+  // returns a free buffer for the next frame, or nullptr if every buffer is
+  // busy and wait is false, in which case the frame counts as dropped
+  Frame *Acquire(bool wait);
+
+  // queues the filled buffer for encoding
+  void Submit(Frame *frame);
+
+  // waits for every submitted frame to be written and closes the output,
+  // returns false if any frame could not be written
+  bool Close();
+
+  std::uint64_t GetWritten() const { return _written.load(); };
+  std::uint64_t GetDropped() const { return _dropped.load(); };
+
+private:
+  void Encode(Frame *frame);
+  void WritePpm(const Frame &frame);
+  void ConvertToYuv(Frame &frame) const;
+  void Release(Frame *frame);
+
+  int _width;
+  int _height;
+  double _framesPerSecond;
+  Format _format{Format::kY4m};
+  std::string _path;
+  std::FILE *_stream{nullptr}; // the Y4M stream
+  std::vector<std::unique_ptr<Frame>> _frames;
+  std::uint64_t _nextIndex{0}; // index of the next acquired frame
+  std::mutex _mutex;           // guards the free list and the stream order
+  std::condition_variable _freed;
+  std::vector<Frame *> _free;   // buffers ready to be filled
+  std::vector<Frame *> _queued; // Y4M frames converted out of order
+  std::uint64_t _nextWrite{0};  // index of the next frame of the stream
+  std::atomic<std::uint64_t> _written{0};
+  std::atomic<std::uint64_t> _dropped{0};
+  std::atomic<bool> _failed{false};
+  ThreadPool _pool; // declared last, so it stops before the rest goes away
+};
+
+#endif
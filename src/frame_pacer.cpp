@@ -0,0 +1,38 @@
+#include "frame_pacer.h"
+#include <algorithm>
+
+FramePacer::FramePacer(PacingMode mode, double framesPerSecond)
+    : _mode(mode),
+      _period(std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double>(1.0 / framesPerSecond))) {
+  Start();
+}
+
+void FramePacer::Start() { _deadline = Clock::now(); }
+
+// sleeps and updates the spun margin to twice the average time the sleeps
+// overran by
+void FramePacer::Sleep(Clock::duration duration) {
+  Clock::time_point start = Clock::now();
+  std::this_thread::sleep_for(duration);
+  Clock::duration over = Clock::now() - start - duration;
+  _oversleep += (over - _oversleep) / 8;
+  _margin = std::clamp(2 * _oversleep, kMinMargin, kMaxMargin);
+}
+
+bool FramePacer::ParseMode(const std::string &name, PacingMode &mode) {
+  static const PacingMode modes[] = {PacingMode::kVsync, PacingMode::kUncapped,
+                                     PacingMode::kPaced};
+  for (PacingMode m : modes) {
+    if (name == GetModeName(m)) {
+      mode = m;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *FramePacer::GetModeName(PacingMode mode) {
+  static const char *names[] = {"vsync", "uncapped", "paced"};
+  return names[static_cast<int>(mode)];
+}
@@ -0,0 +1,76 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+// how the game loop waits between frames
+enum class PacingMode {
+  kVsync,    // SDL_RenderPresent waits for the display's refresh
+  kUncapped, // no waiting at all, e.g. for benchmarking
+  kPaced     // sleeps, then spins up to the deadline of the next frame
+};
+
+// paces the frames of the game loop at an arbitrary rate (e.g. 144 or 240 Hz)
+// on the steady clock. Frame deadlines are kept on an absolute schedule, so
+// rounding never makes the rate drift. The time until a deadline is slept in
+// slices of at most a millisecond, the last part is spun instead since the OS
+// may wake a sleeping thread late; the spun margin follows how late the
+// recent sleeps woke up
+class FramePacer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  FramePacer(PacingMode mode, double framesPerSecond);
+
+  PacingMode GetMode() const { return _mode; };
+  // the intended duration of one frame
+  Clock::duration GetPeriod() const { return _period; };
+
+  // restarts the schedule with a frame starting now
+  void Start();
+
+  // waits until the next frame is due, calling poll() between the sleep
+  // slices. Does not wait unless paced, and starts a new schedule instead of
+  // rushing frames when a frame ran late by more than a whole period
+  template <typename Poll> void Wait(Poll &&poll);
+
+  // parses "vsync", "uncapped" or "paced", returns false if unknown
+  static bool ParseMode(const std::string &name, PacingMode &mode);
+  static const char *GetModeName(PacingMode mode);
+
+private:
+  static constexpr Clock::duration kSlice{std::chrono::milliseconds(1)};
+  static constexpr Clock::duration kMinMargin{std::chrono::microseconds(50)};
+  static constexpr Clock::duration kMaxMargin{std::chrono::milliseconds(2)};
+
+  void Sleep(Clock::duration duration);
+
+  PacingMode _mode;
+  Clock::duration _period;
+  Clock::time_point _deadline;                // end of the current frame
+  Clock::duration _margin{kMaxMargin};        // time spun before a deadline
+  Clock::duration _oversleep{std::chrono::microseconds(100)}; // recent average
+};
+
+template <typename Poll> void FramePacer::Wait(Poll &&poll) {
+  poll();
+  if (_mode != PacingMode::kPaced)
+    return;
+  _deadline += _period;
+  Clock::time_point now = Clock::now();
+  if (now > _deadline + _period) {
+    _deadline = now;
+    return;
+  }
+  while (_deadline - now > _margin) {
+    Sleep(std::min(kSlice, _deadline - now - _margin));
+    poll();
+    now = Clock::now();
+  }
+  while (Clock::now() < _deadline)
+    std::this_thread::yield();
+}
+
+#endif
@@ -0,0 +1,51 @@
+#include "frame_profiler.h"
+#include <fstream>
+
+namespace {
+std::uint64_t Nanoseconds(FrameProfiler::Clock::duration d) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+} // namespace
+
+void FrameProfiler::BeginFrame() {
+  _frameStart = Clock::now();
+  _phaseStart = _frameStart;
+}
+
+void FrameProfiler::EndPhase(FramePhase phase) {
+  Clock::time_point now = Clock::now();
+  _histograms[static_cast<int>(phase)].Record(Nanoseconds(now - _phaseStart));
+  _phaseStart = now;
+}
+
+void FrameProfiler::EndFrame() {
+  _histograms[static_cast<int>(FramePhase::kFrame)].Record(
+      Nanoseconds(Clock::now() - _frameStart));
+}
+
+void FrameProfiler::RecordInputLatency(Clock::time_point input) {
+  _inputLatency.Record(Nanoseconds(Clock::now() - input));
+}
+
+const char *FrameProfiler::GetPhaseName(FramePhase phase) {
+  static const char *names[] = {"input", "update", "render",
+                                "present", "sleep", "frame"};
+  return names[static_cast<int>(phase)];
+}
+
+bool FrameProfiler::WriteCsv(const std::string &path) const {
+  std::ofstream out(path);
+  if (!out)
+    return false;
+  out << "phase,count,mean_us,stddev_us,p50_us,p99_us,p999_us,max_us\n";
+  for (int i = 0; i <= kNumPhases; i++) {
+    const LatencyHistogram &h = i < kNumPhases ? _histograms[i] : _inputLatency;
+    out << (i < kNumPhases ? GetPhaseName(static_cast<FramePhase>(i))
+                           : "input_to_present")
+        << "," << h.GetCount() << "," << h.GetMean() / 1e3 << ","
+        << h.GetStdDev() / 1e3 << "," << h.GetPercentile(50) / 1e3 << ","
+        << h.GetPercentile(99) / 1e3 << "," << h.GetPercentile(99.9) / 1e3
+        << "," << h.GetMax() / 1e3 << "\n";
+  }
+  return static_cast<bool>(out);
+}
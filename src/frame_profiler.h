@@ -0,0 +1,57 @@
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include "histogram.h"
+#include <array>
+#include <chrono>
+#include <string>
+
+// phases of one frame of the game loop, kFrame covers the whole frame
+enum class FramePhase {
+  kInput = 0,
+  kUpdate,
+  kRender,
+  kPresent,
+  kSleep,
+  kFrame
+};
+
+// records how long each phase of every frame takes into one latency histogram
+// per phase, so tail latencies (stutter) are visible and not only the average
+class FrameProfiler {
+public:
+  static constexpr int kNumPhases{6};
+  using Clock = std::chrono::steady_clock;
+
+  // starts a new frame, the first phase is measured from here
+  void BeginFrame();
+
+  // ends a phase, measured from the end of the previous phase
+  void EndPhase(FramePhase phase);
+
+  // records the duration of the whole frame
+  void EndFrame();
+
+  // records the time from an input event to the end of the present showing
+  // its effect
+  void RecordInputLatency(Clock::time_point input);
+
+  const LatencyHistogram &GetHistogram(FramePhase phase) const {
+    return _histograms[static_cast<int>(phase)];
+  };
+  const LatencyHistogram &GetInputLatency() const { return _inputLatency; };
+  static const char *GetPhaseName(FramePhase phase);
+
+  // writes count, mean, standard deviation, p50, p99, p99.9 and max of every
+  // phase and of the input latency in microseconds, returns false if the file
+  // cannot be written
+  bool WriteCsv(const std::string &path) const;
+
+private:
+  std::array<LatencyHistogram, kNumPhases> _histograms;
+  LatencyHistogram _inputLatency;
+  Clock::time_point _frameStart;
+  Clock::time_point _phaseStart;
+};
+
+#endif
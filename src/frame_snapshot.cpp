@@ -0,0 +1,19 @@
+#include "frame_snapshot.h"
+
+FrameSnapshot::FrameSnapshot(int gridWidth, int gridHeight)
+    : width(gridWidth), height(gridHeight), rows(gridHeight, 0) {}
+
+void FrameSnapshot::Capture(const Simulation &simulation) {
+  const Field &field = simulation.GetField();
+  const Piece &piece = simulation.GetPiece();
+  width = field.GetWidth();
+  height = field.GetHeight();
+  rows.assign(field.GetRows(), field.GetRows() + height);
+  pieceType = piece.GetType();
+  body = piece.GetBody();
+  ghostDrop = piece.GetDropDistance();
+  score = simulation.GetScore();
+  level = simulation.GetLevel();
+  gameOver = simulation.IsGameOver();
+  tick = simulation.GetTick();
+}
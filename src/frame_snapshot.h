@@ -0,0 +1,35 @@
+#ifndef FRAME_SNAPSHOT_H
+#define FRAME_SNAPSHOT_H
+
+#include "field.h"
+#include "shape.h"
+#include "simulation.h"
+#include <cstdint>
+#include <vector>
+
+// everything the renderer draws, copied out of the simulation so the two can
+// run on different threads. Handed from the simulation thread to the render
+// loop through a TripleBuffer
+struct FrameSnapshot {
+  int width{0};
+  int height{0};
+  std::vector<Field::Row> rows; // settled cells, top row first
+  PieceType pieceType{PieceType::kLong};
+  Body body{};       // cells of the current piece
+  int ghostDrop{0};  // rows the current piece would fall when dropped
+  int score{0};
+  int level{0};
+  bool gameOver{false};
+  std::uint64_t tick{0}; // simulation tick the snapshot was taken at
+  // number of player key presses applied, set by the owner of the simulation
+  std::uint64_t keyPresses{0};
+
+  // sized for the input grid, so capturing it never allocates
+  FrameSnapshot() = default;
+  FrameSnapshot(int gridWidth, int gridHeight);
+
+  // copies the state of the simulation
+  void Capture(const Simulation &simulation);
+};
+
+#endif
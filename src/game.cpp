@@ -1,102 +1,283 @@
 #include "game.h"
 #include "SDL.h"
+#include "logger.h"
 #include <algorithm>
-#include <future>
+#include <chrono>
 #include <iostream>
-#include <random>
+#include <thread>
 
 // Initialize the game with empty field and a starting piece
 Game::Game(std::size_t gridWidth, std::size_t gridHeight)
-    : _gridWidth(gridWidth), _gridHeight(gridHeight) {
-  _field = std::make_shared<Field>(_gridWidth, _gridHeight);
-  generator = PieceGenerator();
-  _piece = generator.GeneratePiece(_gridWidth, _gridHeight, _baseDescendSpeed,
-                                   _field);
-}
+    : _simulation(gridWidth, gridHeight),
+      _scheduler(std::chrono::milliseconds(Simulation::kTickMs),
+                 kMaxTicksPerUpdate),
+      _keyQueue(kKeyQueueSize),
+      _frames(FrameSnapshot(gridWidth, gridHeight)) {}
 
+// the simulation thread advances the game at its fixed tick rate and publishes
+// a snapshot after every update, while this thread reads the player's input,
+// draws the latest snapshot and presents it. Neither waits for the other, so
+// a slow present delays no tick and a burst of ticks delays no frame. Input is
+// also read while the pacer waits for the next frame, so key events reach the
+// simulation within about a millisecond rather than once per frame
 void Game::Run(Controller const &controller, Renderer &renderer,
-               std::size_t target_frame_duration) {
+               FramePacer &pacer) {
   Uint32 title_timestamp = SDL_GetTicks();
-  Uint32 frame_start;
   Uint32 frame_end;
-  Uint32 frame_duration;
   int frame_count = 0;
-  int rowCleared = 0;
   bool running = true;
-  bool alive = true; // whether the current piece is alive or not
+  auto target_frame_duration =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(pacer.GetPeriod());
 
-  SimulatePiece(); // simulates the starting piece
+  PublishFrame();
+  _running = true;
+  std::thread simulation(&Game::Simulate, this);
+  pacer.Start();
 
-  // Input, Update, Render - the main game loop.
+  // Input, Render - the main game loop.
   while (running) {
-    frame_start = SDL_GetTicks();
-    // keeps generating new pieces and simulating its descent with a child
-    // thread, repeately checking the status of the future, the promis would
-    // return when the piece reaches the field in the child thread
-    if (alive and _future.wait_for(std::chrono::milliseconds(0)) ==
-                      std::future_status::ready) {
-      // updates score when a new piece is generated, and uses the score to
-      // determine next piece's speed
-      UpdateScore();
-      _piece = generator.GeneratePiece(_gridWidth, _gridHeight,
-                                       ComputePieceDescendSpeed(), _field);
-      // game ends if the new piece cannot be placed
-      if (_piece->IsPlaceble()) {
-        std::cout << _piece->GetName() << " cannot be created. Game Over."
-                  << std::endl;
-        alive = false;
-      } else {
-        // otherwise, simulates the new piece's descent
-        SimulatePiece();
+    _profiler.BeginFrame();
+    ReadInput(controller, running);
+    _profiler.EndPhase(FramePhase::kInput);
+
+    // takes the latest snapshot, the previous one is drawn again if the
+    // simulation published nothing since
+    _frames.Update();
+    const FrameSnapshot &frame = _frames.GetFront();
+    _profiler.EndPhase(FramePhase::kUpdate);
+
+    renderer.Render(frame);
+    if (_overlay)
+      renderer.RenderOverlay(_profiler, target_frame_duration);
+    // a frame is dropped rather than waiting while every capture buffer is
+    // still being encoded
+    if (_capture != nullptr) {
+      if (FrameCapture::Frame *shot = _capture->Acquire(false)) {
+        renderer.ReadPixels(shot->pixels.data(), _capture->GetPitch());
+        _capture->Submit(shot);
       }
     }
-    controller.HandleInput(running, *_piece);
-    std::unique_lock<std::mutex> lck(_mutex);
-    renderer.Render(*_piece, *_field);
-    lck.unlock();
+    _profiler.EndPhase(FramePhase::kRender);
+    renderer.Present();
+    _profiler.EndPhase(FramePhase::kPresent);
+    // every key press applied to the presented snapshot is now on screen
+    for (; _pressesShown < frame.keyPresses and !_pressTimes.empty();
+         _pressesShown++) {
+      _profiler.RecordInputLatency(_pressTimes.front());
+      _pressTimes.pop_front();
+    }
 
     frame_end = SDL_GetTicks();
-
-    // Keep track of how long each loop through the input/update/render cycle
-    // takes.
     frame_count++;
-    frame_duration = frame_end - frame_start;
 
     // After every second, update the window title.
     if (frame_end - title_timestamp >= 1000) {
-      renderer.UpdateWindowTitle(_score, _level, frame_count);
+      renderer.UpdateWindowTitle(frame.score, frame.level, frame_count,
+                                 _overlay ? &_profiler : nullptr);
       frame_count = 0;
       title_timestamp = frame_end;
     }
 
-    // If the time for this frame is too small (i.e. frame_duration is
-    // smaller than the target ms_per_frame), delay the loop to
-    // achieve the correct frame rate.
-    if (frame_duration < target_frame_duration) {
-      SDL_Delay(target_frame_duration - frame_duration);
+    // waits for the next frame according to the pacing mode, reading input
+    // every millisecond
+    pacer.Wait([&] { ReadInput(controller, running); });
+    _profiler.EndPhase(FramePhase::kSleep);
+    _profiler.EndFrame();
+  }
+
+  _running = false;
+  simulation.join();
+  if (_recorder)
+    _recorder->Close(_simulation);
+  StopCheckpoints();
+}
+
+// reads the pending key events and sends them to the simulation thread,
+// remembering when each press happened to measure its latency. A replay
+// ignores the player's keys
+void Game::ReadInput(Controller const &controller, bool &running) {
+  _keyEvents.clear();
+  controller.HandleInput(running, _overlay, _keyEvents);
+  if (IsReplaying())
+    return;
+  for (const KeyEvent &event : _keyEvents) {
+    if (!_keyQueue.Push(event)) {
+      LOG_WARNING("key queue full, key event dropped");
+      continue;
+    }
+    if (event.pressed)
+      _pressTimes.push_back(event.time);
+  }
+}
+
+// runs on the simulation thread: moves the player's key events out of the
+// queue, advances the simulation by the ticks the scheduler reports as due
+// and sleeps until the next one
+void Game::Simulate() {
+  _scheduler.Start();
+  KeyEvent queued;
+  while (_running.load(std::memory_order_relaxed)) {
+    while (_keyQueue.Pop(queued))
+      _keys.push_back(queued);
+    int ticks = _scheduler.Update();
+    Advance(ticks, _scheduler.GetTicks() - ticks);
+    if (ticks > 0)
+      PublishFrame();
+    std::this_thread::sleep_until(_scheduler.GetNextTick());
+  }
+}
+
+// advances the simulation by the input number of ticks, the first of which
+// has the input number on the scheduler's clock. The pending inputs of the
+// autoplayer are applied one per tick and any left over wait for the next
+// call, each key event is handed to the auto-shift on the tick it happened
+// and its actions are added to the tick's input. A replay supplies the input
+// of every tick instead
+void Game::Advance(int ticks, std::uint64_t tick) {
+  std::size_t applied = 0;
+  std::size_t keys = 0;
+  for (int i = 0; i < ticks; i++, tick++) {
+    Input input;
+    if (_replayPlayer) {
+      if (_replayPlayer->IsDone(_simulation))
+        break;
+      input = _replayPlayer->GetInput(_simulation.GetTick());
+    } else {
+      // a key event read late still counts from the tick it happened
+      for (; keys < _keys.size(); keys++) {
+        std::uint64_t at = _scheduler.GetTickAt(_keys[keys].time);
+        if (at > tick)
+          break;
+        if (_keys[keys].pressed) {
+          _autoShift.Press(_keys[keys].action, at);
+          _keyPresses++;
+        } else {
+          _autoShift.Release(_keys[keys].action, at);
+        }
+      }
+      if (_autoPlayer)
+        _autoPlayer->HandleInput(_simulation, _inputs);
+      if (applied < _inputs.size())
+        input = _inputs[applied++];
+      input.actions |= _autoShift.Next(tick).actions;
     }
+    if (_recorder and !_simulation.IsGameOver())
+      _recorder->Record(_simulation.GetTick(), input);
+    _simulation.Step(input);
   }
+  _inputs.erase(_inputs.begin(), _inputs.begin() + applied);
+  _keys.erase(_keys.begin(), _keys.begin() + keys);
+  if (_checkpointer and _simulation.GetTick() >= _nextCheckpoint)
+    SaveCheckpoint();
 }
 
-// Simulates the piece's descent in the child thread. Uses promise and future
-// communiate between child thread and the main thread.
-void Game::SimulatePiece() {
-  std::promise<void> prms = std::promise<void>();
-  _future = prms.get_future();
-  _piece->Simulate(std::move(prms));
+// renders the game offline as fast as it can be played: the simulation is
+// advanced by the game time of one frame at a time and every frame is
+// captured, waiting for a free buffer rather than dropping frames
+std::uint64_t Game::Export(Renderer &renderer, FrameCapture &capture,
+                           double framesPerSecond, std::uint64_t maxFrames) {
+  FrameSnapshot &frame = _frames.GetBack(); // unused while Run is not running
+  double ticksPerFrame = Simulation::kTicksPerSecond / framesPerSecond;
+  std::uint64_t frames = 0;
+  std::uint64_t tick = 0;
+  while (maxFrames == 0 or frames < maxFrames) {
+    frame.Capture(_simulation);
+    renderer.Render(frame);
+    // every acquired buffer is submitted, so a stream has no gaps
+    FrameCapture::Frame *shot = capture.Acquire(true);
+    renderer.ReadPixels(shot->pixels.data(), capture.GetPitch());
+    capture.Submit(shot);
+    renderer.Present();
+    frames++;
+    if (_replayPlayer ? _replayPlayer->IsDone(_simulation)
+                      : _simulation.IsGameOver())
+      break;
+    auto end = static_cast<std::uint64_t>(frames * ticksPerFrame);
+    Advance(static_cast<int>(end - tick), tick);
+    tick = end;
+  }
+  if (_recorder)
+    _recorder->Close(_simulation);
+  StopCheckpoints();
+  return frames;
 }
 
-// Adds the square of the additional rows cleared to the total score, and
-// updates current level
-void Game::UpdateScore() {
-  int cleared = _field->GetRowsCleared() - _rowsCleared;
-  _rowsCleared = _field->GetRowsCleared();
-  _score += cleared * cleared;
-  _level = std::min(_maxLevel, 1 + static_cast<int>(_score / _scorePerLevel));
-};
+// copies the simulation into the back snapshot, which allocates nothing since
+// the snapshots are sized for the grid, and hands it to the render loop
+void Game::PublishFrame() {
+  FrameSnapshot &frame = _frames.GetBack();
+  frame.Capture(_simulation);
+  frame.keyPresses = _keyPresses;
+  _frames.Publish();
+}
 
-// Increases descending speed linearly at each level until reaching max level.
-float Game::ComputePieceDescendSpeed() { return _baseDescendSpeed * _level; }
+// hands the state to the checkpoint writer, a copy of a few hundred bytes
+void Game::SaveCheckpoint() {
+  _simulation.Save(_checkpointer->GetState());
+  _checkpointer->Submit();
+  _nextCheckpoint = _simulation.GetTick() + _checkpointTicks;
+}
+
+// saves the final state and waits until it is written
+void Game::StopCheckpoints() {
+  if (!_checkpointer)
+    return;
+  SaveCheckpoint();
+  _checkpointer->Close();
+}
+
+void Game::SetAutoShift(int delayMs, int repeatMs) {
+  _autoShift = AutoShift(delayMs / Simulation::kTickMs,
+                         repeatMs / Simulation::kTickMs);
+}
+
+void Game::EnableAutoPlayer(const AutoPlayer::Config &config) {
+  _autoPlayer = std::make_unique<AutoPlayer>(config);
+}
+
+bool Game::StartRecording(const std::string &path) {
+  _recorder = std::make_unique<ReplayWriter>();
+  if (!_recorder->Open(path, _simulation)) {
+    _recorder.reset();
+    return false;
+  }
+  return true;
+}
+
+bool Game::StartReplay(const std::string &path) {
+  if (!Replay::Load(path, _replay) or
+      _replay.width != _simulation.GetField().GetWidth() or
+      _replay.height != _simulation.GetField().GetHeight())
+    return false;
+  _simulation = Simulation(_replay.width, _replay.height, _replay.seed);
+  _replayPlayer = std::make_unique<ReplayPlayer>(_replay);
+  return true;
+}
+
+bool Game::IsReplayDone() const {
+  return _replayPlayer and _replayPlayer->IsDone(_simulation);
+}
+
+bool Game::ReplayMatches() const {
+  return _replayPlayer and _replayPlayer->Matches(_simulation);
+}
+
+bool Game::Resume(const std::string &path) {
+  GameState state;
+  if (!Checkpoint::Read(path, state) or
+      state.width != _simulation.GetField().GetWidth() or
+      state.height != _simulation.GetField().GetHeight() or state.gameOver)
+    return false;
+  _simulation.Restore(state);
+  return true;
+}
+
+void Game::StartCheckpoints(const std::string &path, int intervalMs) {
+  _checkpointer = std::make_unique<Checkpointer>();
+  _checkpointer->Open(path);
+  _checkpointTicks = std::max(1, intervalMs / Simulation::kTickMs);
+  _nextCheckpoint = _simulation.GetTick() + _checkpointTicks;
+}
 
-int Game::GetScore() const { return _score; }
-int Game::GetLevel() const { return _level; }
\ No newline at end of file
+int Game::GetScore() const { return _simulation.GetScore(); }
+int Game::GetLevel() const { return _simulation.GetLevel(); }
@@ -2,46 +2,114 @@
 #define GAME_H
 
 #include "SDL.h"
+#include "auto_shift.h"
+#include "autoplayer.h"
+#include "checkpoint.h"
 #include "controller.h"
-#include "field.h"
-#include "piece.h"
+#include "frame_capture.h"
+#include "frame_pacer.h"
+#include "frame_profiler.h"
+#include "frame_snapshot.h"
 #include "renderer.h"
-#include <future>
+#include "replay.h"
+#include "replay_writer.h"
+#include "ring_buffer.h"
+#include "scheduler.h"
+#include "simulation.h"
+#include "triple_buffer.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <memory>
-#include <mutex>
-#include <random>
+#include <string>
+#include <vector>
 
 class Game {
 public:
   Game(std::size_t grid_width, std::size_t grid_height);
+  // runs the simulation on its own thread and the input and render loop on
+  // the calling thread until the window is closed, frames are paced by the
+  // input pacer
   void Run(Controller const &controller, Renderer &renderer,
-           std::size_t target_frame_duration);
+           FramePacer &pacer);
+  // plays the game without pacing and captures one frame every
+  // 1/framesPerSecond seconds of game time, until the replay or the game
+  // ends or maxFrames (unless 0) are captured. Returns the number of frames
+  std::uint64_t Export(Renderer &renderer, FrameCapture &capture,
+                       double framesPerSecond, std::uint64_t maxFrames);
+
+  // captures every presented frame of Run while set, not owned
+  void SetCapture(FrameCapture *capture) { _capture = capture; };
+
+  // the state of the simulation is only read while Run is not running
   int GetScore() const;
   int GetLevel() const;
+  const FrameProfiler &GetFrameProfiler() const { return _profiler; };
+
+  // sets the delay after which a held move key repeats and the interval of
+  // the repeats, in milliseconds
+  void SetAutoShift(int delayMs, int repeatMs);
+
+  // lets the computer play, its inputs are queued after the player's
+  void EnableAutoPlayer(const AutoPlayer::Config &config);
+  const AutoPlayer *GetAutoPlayer() const { return _autoPlayer.get(); };
+
+  // records the session to a replay file, returns false if it cannot be
+  // written
+  bool StartRecording(const std::string &path);
+
+  // restarts the game from a replay file and plays its inputs instead of the
+  // player's, returns false if it cannot be read or has another grid size
+  bool StartReplay(const std::string &path);
+  bool IsReplaying() const { return _replayPlayer != nullptr; };
+  bool IsReplayDone() const;
+  bool ReplayMatches() const;
+
+  // continues the game saved in a checkpoint file, returns false if it
+  // cannot be read, has another grid size or its game is over
+  bool Resume(const std::string &path);
+  // saves the game to a checkpoint file every intervalMs of game time on a
+  // background thread, and once more when the session ends
+  void StartCheckpoints(const std::string &path, int intervalMs);
+  const Checkpointer *GetCheckpointer() const { return _checkpointer.get(); };
 
 private:
-  // private behavior methods
-  void SimulatePiece();
-  void UpdateScore();
-  float ComputePieceDescendSpeed();
-
-  std::size_t _gridWidth;
-  std::size_t _gridHeight;
-  PieceGenerator generator;
-  std::unique_ptr<Piece> _piece; // pointer to the current piece
-  std::shared_ptr<Field> _field; // pointer to the field
-  std::mutex _mutex;
-  std::future<void> _future;
-
-  int _score{0};
-  int _rowsCleared{0}; // number of rows cleared
-  int _scorePerLevel{10};
-  int _maxLevel{5};
-  int _level{1};                // current level of the game
-  float _baseDescendSpeed{0.1}; // default descending speed, 0.1 cells per cycle
-
-  void PlaceFood();
-  void Update();
+  static constexpr int kMaxTicksPerUpdate{250}; // catch up at most 250 ms
+  static constexpr std::size_t kKeyQueueSize{256};
+
+  void ReadInput(Controller const &controller, bool &running);
+  void Simulate();
+  void Advance(int ticks, std::uint64_t tick);
+  void PublishFrame();
+  void SaveCheckpoint();
+  void StopCheckpoints();
+
+  // owned by the simulation thread while Run runs
+  Simulation _simulation; // rules of the game, advanced by fixed ticks
+  Scheduler _scheduler;   // hands out the simulation ticks on a steady clock
+  std::vector<Input> _inputs; // inputs waiting to be applied, one per tick
+  std::vector<KeyEvent> _keys; // key events waiting for their tick
+  AutoShift _autoShift;        // turns the key events into inputs
+  std::uint64_t _keyPresses{0}; // key presses applied so far
+  // shared between the threads without locks
+  RingBuffer<KeyEvent> _keyQueue;      // player key events for the simulation
+  TripleBuffer<FrameSnapshot> _frames; // latest state for the render loop
+  std::atomic<bool> _running{false};   // false stops the simulation thread
+  // owned by the render loop
+  std::vector<KeyEvent> _keyEvents; // key events read by the controller
+  // times of the key presses sent but not yet shown on screen
+  std::deque<std::chrono::steady_clock::time_point> _pressTimes;
+  std::uint64_t _pressesShown{0}; // key presses shown on screen so far
+  FrameProfiler _profiler;        // time spent in each phase of every frame
+  bool _overlay{false};           // shows the frame phase timings on screen
+  FrameCapture *_capture{nullptr}; // captures the frames when set
+  std::unique_ptr<AutoPlayer> _autoPlayer; // plays when enabled
+  std::unique_ptr<ReplayWriter> _recorder; // records the session when set
+  Replay _replay;                          // session being replayed
+  std::unique_ptr<ReplayPlayer> _replayPlayer; // replays it when set
+  std::unique_ptr<Checkpointer> _checkpointer; // saves the game when set
+  std::uint64_t _checkpointTicks{0};           // ticks between checkpoints
+  std::uint64_t _nextCheckpoint{0}; // tick of the next checkpoint
 };
 
-#endif
\ No newline at end of file
+#endif
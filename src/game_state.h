@@ -0,0 +1,50 @@
+#ifndef GAME_STATE_H
+#define GAME_STATE_H
+
+#include "field.h"
+#include "piece.h"
+#include "shape.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// complete state of a Simulation between two ticks in one flat block of
+// plain data (328 bytes), so it can be copied with a memcpy, kept in arrays
+// for what-if searches or written to disk as is. Only fields up to
+// kMaxHeight rows fit, taller ones are saved with a Simulation::Snapshot.
+// Value-initialize it (GameState state{}) when every byte must be defined
+struct GameState {
+  static constexpr int kMaxHeight{32};
+
+  std::uint64_t rngState;
+  std::uint64_t rngIncrement;
+  std::uint64_t tick;
+  std::uint64_t pieceCount;
+  std::uint32_t seed;
+  std::int32_t score;
+  std::int32_t rowsCleared;
+  std::int32_t pieceTicks;
+  std::int32_t descendSpeed;
+  std::int32_t descendProgress;
+  std::int16_t pieceX;
+  std::int16_t pieceY;
+  std::uint8_t width;
+  std::uint8_t height;
+  std::uint8_t level;
+  std::uint8_t gameOver;
+  PieceType pieceType;
+  std::uint8_t pieceRotation;
+  std::array<PieceType, PieceGenerator::kPreviewSize> preview;
+  std::uint8_t reserved; // 0, leaves no padding bytes to compare or hash
+  Field::Row rows[kMaxHeight]; // top row first, unused rows are 0
+};
+
+static_assert(std::is_trivial<GameState>::value and
+                  std::is_standard_layout<GameState>::value,
+              "GameState must stay plain data");
+static_assert(sizeof(GameState) == 328 and
+                  offsetof(GameState, rows) == 72,
+              "GameState must not have padding");
+
+#endif
@@ -0,0 +1,66 @@
+#include "histogram.h"
+#include <algorithm>
+#include <cmath>
+
+// values below kSubBuckets get one bucket each, larger values are bucketed by
+// their highest set bit and the kSubBucketBits bits below it
+int LatencyHistogram::BucketOf(std::uint64_t ns) {
+  if (ns < kSubBuckets)
+    return static_cast<int>(ns);
+  int msb = 63 - __builtin_clzll(ns);
+  int shift = msb - kSubBucketBits;
+  int sub = static_cast<int>((ns >> shift) & (kSubBuckets - 1));
+  return (shift + 1) * kSubBuckets + sub;
+}
+
+std::uint64_t LatencyHistogram::UpperBoundOf(int bucket) {
+  if (bucket < kSubBuckets)
+    return bucket;
+  int shift = bucket / kSubBuckets - 1;
+  std::uint64_t sub = bucket % kSubBuckets;
+  std::uint64_t lower = (kSubBuckets + sub) << shift;
+  return lower + ((std::uint64_t{1} << shift) - 1);
+}
+
+void LatencyHistogram::Record(std::uint64_t ns) {
+  _buckets[BucketOf(ns)]++;
+  _count++;
+  _sum += ns;
+  _sumSquares += static_cast<double>(ns) * ns;
+  _min = std::min(_min, ns);
+  _max = std::max(_max, ns);
+}
+
+void LatencyHistogram::Reset() { *this = LatencyHistogram(); }
+
+void LatencyHistogram::Merge(const LatencyHistogram &other) {
+  for (std::size_t i = 0; i < _buckets.size(); i++)
+    _buckets[i] += other._buckets[i];
+  _count += other._count;
+  _sum += other._sum;
+  _sumSquares += other._sumSquares;
+  _min = std::min(_min, other._min);
+  _max = std::max(_max, other._max);
+}
+
+double LatencyHistogram::GetStdDev() const {
+  if (_count == 0)
+    return 0.0;
+  double mean = GetMean();
+  return std::sqrt(std::max(0.0, _sumSquares / _count - mean * mean));
+}
+
+std::uint64_t LatencyHistogram::GetPercentile(double percentile) const {
+  if (_count == 0)
+    return 0;
+  auto rank = static_cast<std::uint64_t>(
+      std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * _count));
+  rank = std::max<std::uint64_t>(rank, 1);
+  std::uint64_t seen{0};
+  for (std::size_t i = 0; i < _buckets.size(); i++) {
+    seen += _buckets[i];
+    if (seen >= rank)
+      return std::min(UpperBoundOf(static_cast<int>(i)), _max);
+  }
+  return _max;
+}
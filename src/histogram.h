@@ -0,0 +1,46 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <array>
+#include <cstdint>
+
+// fixed-size log-linear histogram of latencies in nanoseconds. Each power of
+// two is split into kSubBuckets buckets, so recorded values are kept within
+// 1 / kSubBuckets (about 3%) of their true value. Recording is a few
+// instructions and never allocates
+class LatencyHistogram {
+public:
+  static constexpr int kSubBucketBits{5};
+  static constexpr int kSubBuckets{1 << kSubBucketBits};
+
+  void Record(std::uint64_t ns);
+  void Reset();
+  void Merge(const LatencyHistogram &other);
+
+  std::uint64_t GetCount() const { return _count; };
+  std::uint64_t GetMax() const { return _max; };
+  std::uint64_t GetMin() const { return _count == 0 ? 0 : _min; };
+  double GetMean() const {
+    return _count == 0 ? 0.0 : static_cast<double>(_sum) / _count;
+  };
+  // standard deviation of the recorded values, exact rather than bucketed
+  double GetStdDev() const;
+
+  // returns the upper bound of the bucket holding the input percentile
+  // (0 - 100) of the recorded values, never more than the maximum
+  std::uint64_t GetPercentile(double percentile) const;
+
+private:
+  static int BucketOf(std::uint64_t ns);
+  static std::uint64_t UpperBoundOf(int bucket);
+
+  std::array<std::uint64_t, (64 - kSubBucketBits + 1) * kSubBuckets>
+      _buckets{};
+  std::uint64_t _count{0};
+  std::uint64_t _sum{0};
+  double _sumSquares{0}; // a double, squared nanoseconds overflow quickly
+  std::uint64_t _min{~std::uint64_t{0}};
+  std::uint64_t _max{0};
+};
+
+#endif
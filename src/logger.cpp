@@ -0,0 +1,102 @@
+#include "logger.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+Logger &Logger::Instance() {
+  static Logger logger;
+  return logger;
+}
+
+Logger::Logger() : _records(4096) {}
+
+Logger::~Logger() { Stop(); }
+
+void Logger::Start() {
+  if (_running.exchange(true))
+    return;
+  _thread = std::thread(&Logger::Run, this);
+}
+
+void Logger::Stop() {
+  _running = false;
+  if (_thread.joinable())
+    _thread.join();
+}
+
+std::int64_t Logger::Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// drains the ring buffer, formats the records into one batch and writes it,
+// sleeps briefly whenever the buffer is empty. Queued records are still
+// written after Stop is called
+void Logger::Run() {
+  LogRecord record;
+  std::string batch;
+  while (true) {
+    bool running = _running.load();
+    batch.clear();
+    while (batch.size() < 16384 and _records.Pop(record))
+      Format(record, batch);
+    if (!batch.empty()) {
+      std::clog.write(batch.data(), batch.size());
+      std::clog.flush();
+    } else if (!running) {
+      break;
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  std::uint64_t dropped = _dropped.exchange(0);
+  if (dropped > 0)
+    std::clog << "[log] " << dropped << " records dropped\n";
+}
+
+// writes one line: time in seconds, level and the message with every "{}"
+// replaced by the next argument
+void Logger::Format(const LogRecord &record, std::string &out) {
+  static const char *names[] = {"DEBUG", "INFO ", "WARN ", "ERROR", "OFF  "};
+  char buf[64];
+  std::snprintf(buf, sizeof(buf), "[%12.6f] %s ", record.time * 1e-9,
+                names[static_cast<int>(record.level)]);
+  out += buf;
+  int arg = 0;
+  for (const char *c = record.format; *c != '\0'; c++) {
+    if (c[0] == '{' and c[1] == '}' and arg < record.numArgs) {
+      const LogArg &a = record.args[arg++];
+      switch (a.type) {
+      case LogArg::Type::kInt:
+        out += std::to_string(a.i);
+        break;
+      case LogArg::Type::kUInt:
+        out += std::to_string(a.u);
+        break;
+      case LogArg::Type::kDouble:
+        std::snprintf(buf, sizeof(buf), "%g", a.d);
+        out += buf;
+        break;
+      case LogArg::Type::kString:
+        out += a.s != nullptr ? a.s : "(null)";
+        break;
+      }
+      c++;
+    } else {
+      out += *c;
+    }
+  }
+  out += '\n';
+}
+
+bool Logger::ParseLevel(const std::string &name, LogLevel &level) {
+  static const char *names[] = {"debug", "info", "warning", "error", "off"};
+  for (int i = 0; i <= static_cast<int>(LogLevel::kOff); i++) {
+    if (name == names[i]) {
+      level = static_cast<LogLevel>(i);
+      return true;
+    }
+  }
+  return false;
+}
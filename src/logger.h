@@ -0,0 +1,131 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include "ring_buffer.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+enum class LogLevel : std::uint8_t {
+  kDebug = 0,
+  kInfo,
+  kWarning,
+  kError,
+  kOff
+};
+
+// log statements below this level are removed at compile time, the build
+// defaults to keeping info and above
+#ifndef TETRIS_LOG_MIN_LEVEL
+#define TETRIS_LOG_MIN_LEVEL 1
+#endif
+
+// one argument of a log record, strings must outlive the record (literals or
+// static tables) since they are only read when the record is formatted
+struct LogArg {
+  enum class Type : std::uint8_t { kInt, kUInt, kDouble, kString };
+  Type type{Type::kInt};
+  union {
+    long long i;
+    unsigned long long u;
+    double d;
+    const char *s;
+  };
+
+  LogArg() : i(0){};
+  template <typename T,
+            std::enable_if_t<std::is_integral<T>::value, int> = 0>
+  LogArg(T v) {
+    if (std::is_signed<T>::value) {
+      type = Type::kInt;
+      i = v;
+    } else {
+      type = Type::kUInt;
+      u = v;
+    }
+  };
+  LogArg(double v) : type(Type::kDouble), d(v){};
+  LogArg(const char *v) : type(Type::kString), s(v){};
+};
+
+// a log statement captured on the calling thread, formatting is deferred to
+// the logger's thread
+struct LogRecord {
+  static constexpr int kMaxArgs{6};
+  LogLevel level{LogLevel::kInfo};
+  std::uint8_t numArgs{0};
+  std::int64_t time{0};         // steady clock nanoseconds
+  const char *format{nullptr}; // "{}" marks where each argument goes
+  LogArg args[kMaxArgs];
+};
+
+// asynchronous logger: records are pushed into a lock-free ring buffer and
+// formatted and written by a background thread, so logging never blocks on
+// terminal I/O. Records are dropped (and counted) while the buffer is full
+class Logger {
+public:
+  static Logger &Instance();
+
+  ~Logger();
+
+  // starts and stops the background thread, Stop writes every queued record
+  void Start();
+  void Stop();
+
+  void SetLevel(LogLevel level) {
+    _level.store(level, std::memory_order_relaxed);
+  };
+  LogLevel GetLevel() const { return _level.load(std::memory_order_relaxed); };
+  bool IsEnabled(LogLevel level) const { return level >= GetLevel(); };
+  std::uint64_t GetDropped() const {
+    return _dropped.load(std::memory_order_relaxed);
+  };
+
+  template <typename... Args>
+  void Log(LogLevel level, const char *format, Args... args) {
+    static_assert(sizeof...(Args) <= LogRecord::kMaxArgs,
+                  "too many log arguments");
+    LogRecord record;
+    record.level = level;
+    record.time = Now();
+    record.format = format;
+    record.numArgs = sizeof...(Args);
+    int i = 0;
+    ((record.args[i++] = LogArg(args)), ...);
+    (void)i;
+    if (!_records.Push(record))
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+  };
+
+  // parses "debug", "info", "warning", "error" or "off", returns false if the
+  // name is unknown
+  static bool ParseLevel(const std::string &name, LogLevel &level);
+
+private:
+  Logger();
+  static std::int64_t Now();
+  void Run();
+  static void Format(const LogRecord &record, std::string &out);
+
+  RingBuffer<LogRecord> _records;
+  std::atomic<LogLevel> _level{LogLevel::kInfo};
+  std::atomic<std::uint64_t> _dropped{0};
+  std::atomic<bool> _running{false};
+  std::thread _thread;
+};
+
+#define TETRIS_LOG(level, ...)                                                 \
+  do {                                                                         \
+    if (static_cast<int>(level) >= TETRIS_LOG_MIN_LEVEL and                    \
+        Logger::Instance().IsEnabled(level))                                   \
+      Logger::Instance().Log(level, __VA_ARGS__);                              \
+  } while (false)
+
+#define LOG_DEBUG(...) TETRIS_LOG(LogLevel::kDebug, __VA_ARGS__)
+#define LOG_INFO(...) TETRIS_LOG(LogLevel::kInfo, __VA_ARGS__)
+#define LOG_WARNING(...) TETRIS_LOG(LogLevel::kWarning, __VA_ARGS__)
+#define LOG_ERROR(...) TETRIS_LOG(LogLevel::kError, __VA_ARGS__)
+
+#endif
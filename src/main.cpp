@@ -1,21 +1,156 @@
+#include "config.h"
 #include "controller.h"
+#include "frame_pacer.h"
 #include "game.h"
+#include "logger.h"
 #include "renderer.h"
+#include "wall.h"
+#include "wall_renderer.h"
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <string>
 
-int main() {
-  constexpr std::size_t kFramesPerSecond{60};
-  constexpr std::size_t kMsPerFrame{1000 / kFramesPerSecond};
-  constexpr std::size_t kScreenWidth{480};
-  constexpr std::size_t kScreenHeight{960};
-  constexpr std::size_t kGridWidth{10};
-  constexpr std::size_t kGridHeight{20};
+namespace {
+// frame times in milliseconds, the deviation shows how evenly paced they are
+void PrintFrameTimes(const FrameProfiler &profiler, PacingMode pacing) {
+  const LatencyHistogram &frames = profiler.GetHistogram(FramePhase::kFrame);
+  std::cout << "Frame ms (" << FramePacer::GetModeName(pacing)
+            << ") mean: " << frames.GetMean() / 1e6
+            << " stddev: " << frames.GetStdDev() / 1e6
+            << " p99: " << frames.GetPercentile(99) / 1e6 << "\n";
+}
 
-  Renderer renderer(kScreenWidth, kScreenHeight, kGridWidth, kGridHeight);
+// shows many bot games at once instead of one game
+int RunWall(const Config &config) {
+  WallRenderer renderer(config.screenWidth, config.screenHeight,
+                        config.wallBoards, config.gridWidth, config.gridHeight,
+                        config.pacing == PacingMode::kVsync, config.software);
   Controller controller;
-  Game game(kGridWidth, kGridHeight);
-  game.Run(controller, renderer, kMsPerFrame);
+  Wall wall(config.wallBoards, config.gridWidth, config.gridHeight, 1);
+  FramePacer pacer(config.pacing, config.framesPerSecond);
+  wall.Run(controller, renderer, pacer);
+  std::cout << "Wall: " << wall.GetGamesPlayed() << " games finished, "
+            << wall.GetPiecesPlayed() << " pieces\n";
+  PrintFrameTimes(wall.GetFrameProfiler(), config.pacing);
+  Logger::Instance().Stop();
+  return 0;
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  // --autoplay lets the computer play, e.g. for demos and soak tests,
+  // --record writes the session to a replay file and --replay plays one back,
+  // --pacing and --fps choose how frames are paced, see Config for the rest
+  Config config;
+  std::string error;
+  if (!Config::Parse(argc, argv, config, error)) {
+    if (!error.empty())
+      std::cerr << error << "\n";
+    std::cerr << Config::GetUsage();
+    return error.empty() ? 0 : 1;
+  }
+
+  // log level can be lowered or raised at runtime, e.g. TETRIS_LOG_LEVEL=debug
+  LogLevel level;
+  const char *levelName = std::getenv("TETRIS_LOG_LEVEL");
+  if (levelName != nullptr and Logger::ParseLevel(levelName, level))
+    Logger::Instance().SetLevel(level);
+  Logger::Instance().Start();
+  if (config.wallBoards > 0)
+    return RunWall(config);
+
+  // an export renders offscreen, SDL_VIDEODRIVER can still pick a driver
+  bool offline = !config.exportPath.empty();
+  if (offline and std::getenv("SDL_VIDEODRIVER") == nullptr)
+    SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+  Renderer renderer(config.screenWidth, config.screenHeight, config.gridWidth,
+                    config.gridHeight,
+                    config.pacing == PacingMode::kVsync and !offline,
+                    config.software or offline, offline);
+  Controller controller;
+  Game game(config.gridWidth, config.gridHeight);
+  if (config.autoplay)
+    game.EnableAutoPlayer(AutoPlayer::Config{});
+  if (!config.recordPath.empty() and !game.StartRecording(config.recordPath))
+    std::cerr << "Cannot record to " << config.recordPath << "\n";
+  if (!config.replayPath.empty() and !game.StartReplay(config.replayPath)) {
+    std::cerr << "Cannot replay " << config.replayPath << "\n";
+    return 1;
+  }
+  // a session that cannot be resumed starts a new game
+  if (config.resume and !game.Resume(config.checkpointPath))
+    std::cerr << "Cannot resume from " << config.checkpointPath
+              << ", starting a new game\n";
+  if (!config.checkpointPath.empty())
+    game.StartCheckpoints(config.checkpointPath, config.checkpointMs);
+  game.SetAutoShift(config.autoShiftDelayMs, config.autoShiftRepeatMs);
+
+  std::unique_ptr<FrameCapture> capture;
+  const std::string &capturePath =
+      offline ? config.exportPath : config.capturePath;
+  if (!capturePath.empty()) {
+    capture = std::make_unique<FrameCapture>(
+        config.screenWidth, config.screenHeight, config.framesPerSecond);
+    if (!capture->Open(capturePath)) {
+      std::cerr << "Cannot capture to " << capturePath
+                << ", the path must end in .y4m or .ppm\n";
+      return 1;
+    }
+  }
+  if (offline) {
+    auto start = std::chrono::steady_clock::now();
+    std::uint64_t frames = game.Export(
+        renderer, *capture, config.framesPerSecond, config.maxFrames);
+    bool written = capture->Close();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    double gameSeconds = frames / config.framesPerSecond;
+    std::cout << "Exported " << capture->GetWritten() << " of " << frames
+              << " frames (" << gameSeconds << " s of game) in "
+              << elapsed.count() << " s, "
+              << gameSeconds / elapsed.count() << "x real time\n";
+    Logger::Instance().Stop();
+    return written ? 0 : 1;
+  }
+
+  game.SetCapture(capture.get());
+  FramePacer pacer(config.pacing, config.framesPerSecond);
+  game.Run(controller, renderer, pacer);
+  if (capture) {
+    capture->Close();
+    std::cout << "Captured " << capture->GetWritten() << " frames, "
+              << capture->GetDropped() << " dropped\n";
+  }
   std::cout << "Game has terminated successfully!\n";
   std::cout << "Score: " << game.GetScore() << "\n";
+  if (game.IsReplaying()) {
+    if (!game.IsReplayDone())
+      std::cout << "Replay stopped before its end\n";
+    else if (game.ReplayMatches())
+      std::cout << "Replay matches the recording\n";
+    else
+      std::cout << "Replay differs from the recording\n";
+  }
+  if (const AutoPlayer *player = game.GetAutoPlayer()) {
+    const AutoPlayer::Stats &stats = player->GetStats();
+    std::cout << "Autoplayer: " << stats.searches << " pieces, "
+              << stats.GetPlacementsPerSecond() << " placements/s, "
+              << 100 * stats.GetCacheHitRate() << "% from the cache\n";
+  }
+  if (const Checkpointer *checkpointer = game.GetCheckpointer())
+    std::cout << checkpointer->GetWritten() << " checkpoints written to "
+              << config.checkpointPath << "\n";
+  const LatencyHistogram &latency = game.GetFrameProfiler().GetInputLatency();
+  if (latency.GetCount() > 0)
+    std::cout << "Input to present ms p50: "
+              << latency.GetPercentile(50) / 1e6
+              << " p99: " << latency.GetPercentile(99) / 1e6
+              << " max: " << latency.GetMax() / 1e6 << "\n";
+  PrintFrameTimes(game.GetFrameProfiler(), config.pacing);
+  if (game.GetFrameProfiler().WriteCsv("frame_timings.csv"))
+    std::cout << "Frame timings written to frame_timings.csv\n";
+  Logger::Instance().Stop();
   return 0;
 }
\ No newline at end of file
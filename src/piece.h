@@ -1,55 +1,56 @@
 #ifndef PIECE_H
 #define PIECE_H
 
-#include "SDL.h"
 #include "field.h"
-#include <future>
-#include <map>
+#include "random.h"
+#include "shape.h"
+#include <array>
+#include <cstdint>
 #include <memory>
-#include <mutex>
 #include <random>
-#include <string>
-#include <thread>
-#include <vector>
 
-class Field;
+template <int Width, int Height> class BasicField;
+using Field = BasicField<0, 0>; // see field.h
 
 enum class Rotation { kForward = 0, kBackward };
 enum class Direction { kDown = 0, kLeft, kRight };
 
 class Piece {
 public:
-  // constructor / destructor
-  Piece(int gridWdth, int gridHeight);
-  ~Piece();
+  // constructor, pieces are small values that own no resources
+  Piece(PieceType type, int gridWdth, int gridHeight);
 
   // getter and setter
-  int GetSize() { return size; };
-  int GetCenterCellX() { return _centerCellX; };
-  int GetCenterCellY() { return _centerCellY; };
-  float GetDescendSpeed() { return _descendSpeed; };
-  void SetDesecendSpeed(float s) { _descendSpeed = s; };
-  const std::vector<std::vector<int>> &GetBody() const { return _body; };
-
-  // abstract methods
-
-  virtual const std::map<int, std::vector<std::vector<int>>> &
-  GetShapes() = 0; // returns a map defining all shapes of the piece
-
-  virtual const std::string GetName() = 0; // returns the name of the piece
-
-  virtual const std::vector<int> &
-  GetColorCodes() const = 0; // returns the RGBA code of the piece
+  int GetSize() const { return size; };
+  int GetCenterCellX() const { return _centerCellX; };
+  int GetCenterCellY() const { return _centerCellY; };
+  PieceType GetType() const { return _type; };
+  int GetRotation() const { return _currentShape; };
+  const Body &GetBody() const { return _body; };
+  const ShapeMask &GetMask() const { return GetShapes().masks[_currentShape]; };
+
+  // returns the compile-time table with all shapes of the piece
+  const PieceShapes &GetShapes() const { return GetPieceShapes(_type); };
+
+  // returns the name of the piece
+  const char *GetName() const { return GetShapes().name; };
+
+  // returns the RGBA code of the piece
+  const std::array<std::uint8_t, 4> &GetColorCodes() const {
+    return GetShapes().color;
+  };
 
   // typical behavior methods
   bool IsFree() { return _free; };
-  void SetField(std::shared_ptr<Field> field);
-  void Simulate(std::promise<void> &&prms);
-  void InitBody();
-  void Descend(std::promise<void> &&prms);
+  void SetField(const Field *field);
+  bool Descend();
+  bool IsLanded();
   void Move(const Direction &d);
   void Rotate(const Rotation &r);
   void Drop();
+  void MoveTo(int centerX, int centerY, int shape);
+  bool IsBlocked(const Direction &d) const;
+  int GetDropDistance() const;
   bool CellOutsideScreen(const int &x, const int &y) const;
   bool CellOccupied(const int &x, const int &y) const;
   bool IsPlaceble();
@@ -59,140 +60,51 @@ public:
 private:
   // private behavior methods
   void UpdateBody();
-  bool IsBlocked(const Direction &d);
-  void AddToField();
 
+  PieceType _type;   // which of the seven tetrominoes this piece is
   int _gridWidth;    // number of columns in the screen
   int _gridHeight;   // number of rows in the screen
-  bool _free{false}; // true if the piece is allowed to move, rotate or descend
-  float _centerX;   // floating value of the x-coordindate of the piece's center
-  float _centerY;   // floating value of the y-coordiate of the piece's center
-  int _centerCellX; // displayed x-coordidate of the piece's center
-  int _centerCellY; // displayed y-cooridate of the piece's center
+  bool _free{true}; // true if the piece is allowed to move, rotate or descend
+  int _centerCellX; // x-coordidate of the piece's center
+  int _centerCellY; // y-cooridate of the piece's center
   int _currentShape{0};       // current shape of the piece
-  float _descendSpeed{0.1f};  // initial descend speed, number of cells
-  int _descendCycleTime{100}; // descend every 100 milliseconds
-  std::vector<std::vector<int>>
-      _body; // vecotr of cells representing the current shape of the piece
-  std::shared_ptr<Field> _field; // pointer to the field object
-  std::thread _thread;           // thread to simulate the piece's descent
-  std::mutex _mutex; // mutex to protect modifying private variables from
-                     // different threads
-};
-
-// define each invididual piece class by filling out the missing virtual methods
-
-class LongPiece : public Piece {
-public:
-  LongPiece(int gridWidth, int gridHeight) : Piece(gridWidth, gridHeight){};
-  const std::string GetName() { return name; };
-  const std::map<int, std::vector<std::vector<int>>> &GetShapes() {
-    return shapes;
-  };
-  const std::vector<int> &GetColorCodes() const { return color_codes; };
-
-  static const std::string name;
-  static const std::map<int, std::vector<std::vector<int>>> shapes;
-  static const std::vector<int> color_codes;
+  Body _body{}; // absolute cells of the current shape of the piece
+  const Field *_field{nullptr}; // field the piece moves in, not owned
 };
 
-class SquarePiece : public Piece {
-public:
-  SquarePiece(int gridWidth, int gridHeight) : Piece(gridWidth, gridHeight){};
-  void Rotate(const Rotation &r){}; // square piece does not rotate
-  const std::string GetName() { return name; };
-  const std::map<int, std::vector<std::vector<int>>> &GetShapes() {
-    return shapes;
-  };
-  const std::vector<int> &GetColorCodes() const { return color_codes; };
-
-  static const std::string name;
-  static const std::map<int, std::vector<std::vector<int>>> shapes;
-  static const std::vector<int> color_codes;
-};
-
-class JPiece : public Piece {
-public:
-  JPiece(int gridWidth, int gridHeight) : Piece(gridWidth, gridHeight){};
-  const std::string GetName() { return name; };
-  const std::map<int, std::vector<std::vector<int>>> &GetShapes() {
-    return shapes;
-  };
-  const std::vector<int> &GetColorCodes() const { return color_codes; };
-
-  static const std::string name;
-  static const std::map<int, std::vector<std::vector<int>>> shapes;
-  static const std::vector<int> color_codes;
-};
+// factory class able to generate random piece objects
 
-class LPiece : public Piece {
+class PieceGenerator {
 public:
-  LPiece(int gridWidth, int gridHeight) : Piece(gridWidth, gridHeight){};
-  const std::string GetName() { return name; };
-  const std::map<int, std::vector<std::vector<int>>> &GetShapes() {
-    return shapes;
-  };
-  const std::vector<int> &GetColorCodes() const { return color_codes; };
+  static constexpr int kPreviewSize{5}; // number of upcoming pieces known
 
-  static const std::string name;
-  static const std::map<int, std::vector<std::vector<int>>> shapes;
-  static const std::vector<int> color_codes;
-};
-
-class SPiece : public Piece {
-public:
-  SPiece(int gridWidth, int gridHeight) : Piece(gridWidth, gridHeight){};
-  const std::string GetName() { return name; };
-  const std::map<int, std::vector<std::vector<int>>> &GetShapes() {
-    return shapes;
+  PieceGenerator() : PieceGenerator(std::random_device{}()){};
+  explicit PieceGenerator(std::uint32_t seed) : _engine(seed) {
+    for (PieceType &t : _preview)
+      t = RandomType();
   };
-  const std::vector<int> &GetColorCodes() const { return color_codes; };
-
-  static const std::string name;
-  static const std::map<int, std::vector<std::vector<int>>> shapes;
-  static const std::vector<int> color_codes;
-};
-
-class TPiece : public Piece {
-public:
-  TPiece(int gridWidth, int gridHeight) : Piece(gridWidth, gridHeight){};
-  const std::string GetName() { return name; };
-  const std::map<int, std::vector<std::vector<int>>> &GetShapes() {
-    return shapes;
+  // restores a generator from its engine and upcoming pieces
+  PieceGenerator(const Pcg32 &engine,
+                 const std::array<PieceType, kPreviewSize> &preview)
+      : _engine(engine), _preview(preview){};
+  Piece GeneratePiece(int gridWidth, int gridHeight, const Field *field);
+
+  // returns the type of the i-th upcoming piece, 0 is the next one
+  PieceType GetPreview(int i) const {
+    return _preview[(_previewHead + i) % kPreviewSize];
   };
-  const std::vector<int> &GetColorCodes() const { return color_codes; };
 
-  static const std::string name;
-  static const std::map<int, std::vector<std::vector<int>>> shapes;
-  static const std::vector<int> color_codes;
-};
+  const Pcg32 &GetEngine() const { return _engine; };
 
-class ZPiece : public Piece {
-public:
-  ZPiece(int gridWidth, int gridHeight) : Piece(gridWidth, gridHeight){};
-  const std::string GetName() { return name; };
-  const std::map<int, std::vector<std::vector<int>>> &GetShapes() {
-    return shapes;
+private:
+  PieceType NextType();
+  PieceType RandomType() {
+    return static_cast<PieceType>(_engine.Below(kNumPieceTypes));
   };
-  const std::vector<int> &GetColorCodes() const { return color_codes; };
-
-  static const std::string name;
-  static const std::map<int, std::vector<std::vector<int>>> shapes;
-  static const std::vector<int> color_codes;
-};
-
-// factory class able to generate random piece objects
 
-class PieceGenerator {
-public:
-  PieceGenerator() : engine(std::random_device{}()), random_t(0, 6){};
-  std::unique_ptr<Piece> GeneratePiece(int gridWidth, int gridHeight,
-                                       float speed,
-                                       std::shared_ptr<Field> field);
-
-private:
-  std::mt19937 engine;
-  std::uniform_int_distribution<int> random_t;
+  Pcg32 _engine; // small enough to store in every replay keyframe
+  std::array<PieceType, kPreviewSize> _preview; // queue of upcoming pieces
+  int _previewHead{0};                          // index of the next piece
 };
 
 #endif
\ No newline at end of file
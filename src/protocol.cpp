@@ -0,0 +1,245 @@
+#include "protocol.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+void PutU16(std::string &out, std::uint16_t v) {
+  out += static_cast<char>(v);
+  out += static_cast<char>(v >> 8);
+}
+
+void PutU32(std::string &out, std::uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    out += static_cast<char>(v >> (8 * i));
+}
+
+void PutU64(std::string &out, std::uint64_t v) {
+  for (int i = 0; i < 8; i++)
+    out += static_cast<char>(v >> (8 * i));
+}
+
+std::uint16_t GetU16(const std::uint8_t *p) {
+  return static_cast<std::uint16_t>(p[0] | p[1] << 8);
+}
+
+std::uint32_t GetU32(const std::uint8_t *p) {
+  std::uint32_t v = 0;
+  for (int i = 0; i < 4; i++)
+    v |= static_cast<std::uint32_t>(p[i]) << (8 * i);
+  return v;
+}
+
+std::uint64_t GetU64(const std::uint8_t *p) {
+  std::uint64_t v = 0;
+  for (int i = 0; i < 8; i++)
+    v |= static_cast<std::uint64_t>(p[i]) << (8 * i);
+  return v;
+}
+
+std::size_t RowSize(int width) { return width <= 16 ? 2 : 8; }
+
+// the address after its scheme, or nullptr if it has another scheme
+const char *Strip(const std::string &address, const char *scheme) {
+  std::size_t n = std::strlen(scheme);
+  return address.compare(0, n, scheme) == 0 ? address.c_str() + n : nullptr;
+}
+
+// fills the socket address of a UNIX or loopback TCP address, returns its
+// size or 0 if the address is malformed
+socklen_t ParseAddress(const std::string &address, sockaddr_storage &storage) {
+  std::memset(&storage, 0, sizeof(storage));
+  if (const char *path = Strip(address, "unix:")) {
+    auto *un = reinterpret_cast<sockaddr_un *>(&storage);
+    if (*path == '\0' or std::strlen(path) >= sizeof(un->sun_path))
+      return 0;
+    un->sun_family = AF_UNIX;
+    std::strcpy(un->sun_path, path);
+    return sizeof(sockaddr_un);
+  }
+  if (const char *port = Strip(address, "tcp:")) {
+    char *end;
+    long number = std::strtol(port, &end, 10);
+    if (end == port or *end != '\0' or number < 1 or number > 65535)
+      return 0;
+    auto *in = reinterpret_cast<sockaddr_in *>(&storage);
+    in->sin_family = AF_INET;
+    in->sin_port = htons(static_cast<std::uint16_t>(number));
+    in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return sizeof(sockaddr_in);
+  }
+  return 0;
+}
+
+} // namespace
+
+void Protocol::EncodeJoin(std::string &out, const Join &join) {
+  PutU16(out, kJoinSize - kLengthSize);
+  out += static_cast<char>(MessageType::kJoin);
+  PutU32(out, join.seed);
+  out += static_cast<char>(join.width);
+  out += static_cast<char>(join.height);
+}
+
+void Protocol::EncodeInput(std::string &out, std::uint8_t actions) {
+  PutU16(out, kInputSize - kLengthSize);
+  out += static_cast<char>(MessageType::kInput);
+  out += static_cast<char>(actions);
+}
+
+bool Protocol::EncodeDelta(std::string &out, const GameState &previous,
+                           std::uint32_t previousInputs,
+                           const GameState &current,
+                           std::uint32_t inputsApplied, std::uint8_t flags) {
+  std::uint32_t changed = 0;
+  for (int y = 0; y < current.height; y++) {
+    if ((flags & kReset) or current.rows[y] != previous.rows[y])
+      changed |= std::uint32_t{1} << y;
+  }
+  if (changed == 0 and flags == 0 and inputsApplied == previousInputs and
+      current.pieceType == previous.pieceType and
+      current.pieceRotation == previous.pieceRotation and
+      current.pieceX == previous.pieceX and
+      current.pieceY == previous.pieceY and
+      current.score == previous.score and current.level == previous.level)
+    return false;
+
+  std::size_t rowSize = RowSize(current.width);
+  std::size_t size = kDeltaHeaderSize - kLengthSize +
+                     rowSize * __builtin_popcount(changed);
+  PutU16(out, static_cast<std::uint16_t>(size));
+  out += static_cast<char>(MessageType::kDelta);
+  PutU32(out, static_cast<std::uint32_t>(current.tick));
+  PutU32(out, inputsApplied);
+  PutU32(out, changed);
+  out += static_cast<char>(flags);
+  out += static_cast<char>(current.pieceType);
+  out += static_cast<char>(current.pieceRotation);
+  out += static_cast<char>(current.pieceX);
+  out += static_cast<char>(current.pieceY);
+  out += static_cast<char>(current.level);
+  PutU32(out, static_cast<std::uint32_t>(current.score));
+  for (std::uint32_t bits = changed; bits != 0; bits &= bits - 1) {
+    Field::Row row = current.rows[__builtin_ctz(bits)];
+    if (rowSize == 2)
+      PutU16(out, static_cast<std::uint16_t>(row));
+    else
+      PutU64(out, row);
+  }
+  return true;
+}
+
+bool Protocol::NextMessage(const std::string &stream, std::size_t &offset,
+                           MessageType &type, const std::uint8_t *&payload,
+                           std::size_t &size) {
+  if (stream.size() - offset < kLengthSize + 1)
+    return false;
+  auto *p = reinterpret_cast<const std::uint8_t *>(stream.data()) + offset;
+  std::size_t length = GetU16(p);
+  if (length == 0 or stream.size() - offset - kLengthSize < length)
+    return false;
+  type = static_cast<MessageType>(p[kLengthSize]);
+  payload = p + kLengthSize + 1;
+  size = length - 1;
+  offset += kLengthSize + length;
+  return true;
+}
+
+bool Protocol::DecodeJoin(const std::uint8_t *payload, std::size_t size,
+                          Join &join) {
+  if (size != kJoinSize - kLengthSize - 1)
+    return false;
+  join.seed = GetU32(payload);
+  join.width = payload[4];
+  join.height = payload[5];
+  return join.width >= kMinWidth and join.width <= Field::kMaxWidth and
+         join.height >= kMinHeight and join.height <= kMaxRows;
+}
+
+bool Protocol::DecodeDelta(const std::uint8_t *payload, std::size_t size,
+                           int width, int height, Delta &delta,
+                           Field::Row *rows) {
+  std::size_t header = kDeltaHeaderSize - kLengthSize - 1;
+  if (size < header)
+    return false;
+  delta.tick = GetU32(payload);
+  delta.inputsApplied = GetU32(payload + 4);
+  delta.changedRows = GetU32(payload + 8);
+  delta.flags = payload[12];
+  delta.pieceType = static_cast<PieceType>(payload[13] % kNumPieceTypes);
+  delta.pieceRotation = payload[14];
+  delta.pieceX = static_cast<std::int8_t>(payload[15]);
+  delta.pieceY = static_cast<std::int8_t>(payload[16]);
+  delta.level = payload[17];
+  delta.score = static_cast<std::int32_t>(GetU32(payload + 18));
+  std::size_t rowSize = RowSize(width);
+  if ((height < 32 and delta.changedRows >> height != 0) or
+      size != header + rowSize * __builtin_popcount(delta.changedRows))
+    return false;
+  const std::uint8_t *p = payload + header;
+  for (std::uint32_t bits = delta.changedRows; bits != 0; bits &= bits - 1) {
+    rows[__builtin_ctz(bits)] = rowSize == 2 ? GetU16(p) : GetU64(p);
+    p += rowSize;
+  }
+  return true;
+}
+
+int Protocol::Listen(const std::string &address, std::string &error) {
+  sockaddr_storage storage;
+  socklen_t length = ParseAddress(address, storage);
+  if (length == 0) {
+    error = "malformed address " + address + ", expected unix:PATH or tcp:PORT";
+    return -1;
+  }
+  int fd = ::socket(storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (fd < 0) {
+    error = std::strerror(errno);
+    return -1;
+  }
+  if (storage.ss_family == AF_UNIX) {
+    ::unlink(reinterpret_cast<sockaddr_un *>(&storage)->sun_path);
+  } else {
+    int on = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  }
+  if (::bind(fd, reinterpret_cast<sockaddr *>(&storage), length) != 0 or
+      ::listen(fd, SOMAXCONN) != 0) {
+    error = "cannot listen on " + address + ": " + std::strerror(errno);
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int Protocol::Connect(const std::string &address, std::string &error) {
+  sockaddr_storage storage;
+  socklen_t length = ParseAddress(address, storage);
+  if (length == 0) {
+    error = "malformed address " + address + ", expected unix:PATH or tcp:PORT";
+    return -1;
+  }
+  int fd = ::socket(storage.ss_family, SOCK_STREAM, 0);
+  if (fd < 0) {
+    error = std::strerror(errno);
+    return -1;
+  }
+  // connects blocking, so the caller can send right away
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&storage), length) != 0) {
+    error = "cannot connect to " + address + ": " + std::strerror(errno);
+    ::close(fd);
+    return -1;
+  }
+  if (storage.ss_family == AF_INET) {
+    int on = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+  }
+  ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return fd;
+}
@@ -0,0 +1,84 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include "game_state.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// messages between tetris_server and its clients over a stream socket. Every
+// message is its length (u16, not counting itself), its type (u8) and its
+// payload, all integers are little-endian.
+//
+// A client joins with the seed and grid size of its game, then sends inputs
+// whenever it likes, each one is applied on the next tick. The server answers
+// with deltas: the tick, the number of inputs applied so far, a mask of the
+// rows that changed since the previous delta followed by those rows, and the
+// piece, score and level, which are small enough to always be sent. Rows are
+// two bytes for grids up to 16 columns wide and eight bytes otherwise. The
+// first delta of a game, marked kReset, holds every row
+namespace Protocol {
+enum class MessageType : std::uint8_t { kJoin = 1, kInput = 2, kDelta = 3 };
+
+constexpr std::size_t kLengthSize{2};
+constexpr std::size_t kJoinSize{kLengthSize + 7};
+constexpr std::size_t kInputSize{kLengthSize + 2};
+constexpr std::size_t kDeltaHeaderSize{kLengthSize + 23};
+constexpr int kMaxRows{GameState::kMaxHeight};
+constexpr int kMinWidth{Field::kMinWidth};
+constexpr int kMinHeight{4};
+
+constexpr std::uint8_t kGameOver{1 << 0}; // delta flag: the game ended
+constexpr std::uint8_t kReset{1 << 1};    // delta flag: a new game began
+
+struct Join {
+  std::uint32_t seed{0};
+  int width{10};
+  int height{20};
+};
+
+struct Delta {
+  std::uint32_t tick{0};           // low bits of the simulation tick
+  std::uint32_t inputsApplied{0}; // inputs of the client applied so far
+  std::uint32_t changedRows{0};   // bit y set if row y follows
+  std::uint8_t flags{0};
+  PieceType pieceType{PieceType::kLong};
+  std::uint8_t pieceRotation{0};
+  std::int8_t pieceX{0};
+  std::int8_t pieceY{0};
+  std::uint8_t level{0};
+  std::int32_t score{0};
+};
+
+void EncodeJoin(std::string &out, const Join &join);
+void EncodeInput(std::string &out, std::uint8_t actions);
+
+// appends the delta from the previous state and input count to the current
+// ones, or every row if the flags have kReset. Returns false, appending
+// nothing, if nothing but the tick changed
+bool EncodeDelta(std::string &out, const GameState &previous,
+                 std::uint32_t previousInputs, const GameState &current,
+                 std::uint32_t inputsApplied, std::uint8_t flags);
+
+// finds the next complete message of a received byte stream from the input
+// offset on. Sets the message's type, payload and payload size and advances
+// the offset past it, returns false if the stream ends before the message
+bool NextMessage(const std::string &stream, std::size_t &offset,
+                 MessageType &type, const std::uint8_t *&payload,
+                 std::size_t &size);
+
+// decode payloads, return false if they are malformed
+bool DecodeJoin(const std::uint8_t *payload, std::size_t size, Join &join);
+// applies the changed rows to the rows of the receiver, whose grid is
+// width columns wide and height rows tall
+bool DecodeDelta(const std::uint8_t *payload, std::size_t size, int width,
+                 int height, Delta &delta, Field::Row *rows);
+
+// sockets for addresses of the form unix:/path/to/socket, or tcp:port for the
+// loopback stand-in. Both return a non-blocking file descriptor, or -1 and a
+// message. Listening on a UNIX socket replaces a stale socket file
+int Listen(const std::string &address, std::string &error);
+int Connect(const std::string &address, std::string &error);
+} // namespace Protocol
+
+#endif
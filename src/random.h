@@ -0,0 +1,61 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+
+// PCG32 random number generator (O'Neill, pcg-random.org): 16 bytes of state
+// that can be saved and restored, and the same sequence for a seed on every
+// platform and standard library
+class Pcg32 {
+public:
+  explicit Pcg32(std::uint64_t seed = 0, std::uint64_t stream = 0x5851f42d)
+      : _state(0), _inc(stream << 1 | 1) {
+    Next();
+    _state += seed;
+    Next();
+  };
+
+  std::uint32_t Next() {
+    std::uint64_t old = _state;
+    _state = old * 6364136223846793005ull + _inc;
+    auto xorshifted = static_cast<std::uint32_t>(((old >> 18) ^ old) >> 27);
+    auto rot = static_cast<std::uint32_t>(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+  };
+
+  // returns a uniform value in [0, bound), bound must not be 0. Values of the
+  // biased low range are rejected
+  std::uint32_t Below(std::uint32_t bound) {
+    std::uint32_t threshold = (0u - bound) % bound;
+    while (true) {
+      std::uint32_t r = Next();
+      if (r >= threshold)
+        return r % bound;
+    }
+  };
+
+  // raw state, for snapshots
+  std::uint64_t GetState() const { return _state; };
+  std::uint64_t GetIncrement() const { return _inc; };
+  static Pcg32 FromState(std::uint64_t state, std::uint64_t inc) {
+    Pcg32 engine;
+    engine._state = state;
+    engine._inc = inc | 1;
+    return engine;
+  };
+
+private:
+  std::uint64_t _state;
+  std::uint64_t _inc; // odd, selects the stream
+};
+
+// SplitMix64 finalizer (Steele et al.): mixes every input bit into every
+// output bit, used to derive hash keys on the fly instead of storing tables
+inline std::uint64_t SplitMix64(std::uint64_t x) {
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+#endif
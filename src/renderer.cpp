@@ -1,10 +1,12 @@
 #include "renderer.h"
+#include <algorithm>
 #include <iostream>
 #include <string>
 
 Renderer::Renderer(const std::size_t screen_width,
                    const std::size_t screen_height,
-                   const std::size_t grid_width, const std::size_t grid_height)
+                   const std::size_t grid_width, const std::size_t grid_height,
+                   bool vsync, bool software, bool hidden)
     : screen_width(screen_width), screen_height(screen_height),
       grid_width(grid_width), grid_height(grid_height) {
   // Initialize SDL
@@ -16,7 +18,8 @@ Renderer::Renderer(const std::size_t screen_width,
   // Create Window
   sdl_window = SDL_CreateWindow("Tetris Game", SDL_WINDOWPOS_CENTERED,
                                 SDL_WINDOWPOS_CENTERED, screen_width,
-                                screen_height, SDL_WINDOW_SHOWN);
+                                screen_height,
+                                hidden ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN);
 
   if (nullptr == sdl_window) {
     std::cerr << "Window could not be created.\n";
@@ -24,60 +27,202 @@ Renderer::Renderer(const std::size_t screen_width,
   }
 
   // Create renderer
-  sdl_renderer = SDL_CreateRenderer(sdl_window, -1, SDL_RENDERER_ACCELERATED);
+  Uint32 flags = software ? SDL_RENDERER_SOFTWARE : SDL_RENDERER_ACCELERATED;
+  if (vsync)
+    flags |= SDL_RENDERER_PRESENTVSYNC;
+  sdl_renderer = SDL_CreateRenderer(sdl_window, -1, flags);
   if (nullptr == sdl_renderer) {
     std::cerr << "Renderer could not be created.\n";
     std::cerr << "SDL_Error: " << SDL_GetError() << "\n";
   }
+
+  // Create the texture caching the settled field, without it the field is
+  // drawn directly every frame
+  field_texture =
+      SDL_CreateTexture(sdl_renderer, SDL_PIXELFORMAT_RGBA8888,
+                        SDL_TEXTUREACCESS_TARGET, screen_width, screen_height);
+  if (nullptr == field_texture) {
+    std::cerr << "Field texture could not be created.\n";
+    std::cerr << "SDL_Error: " << SDL_GetError() << "\n";
+  } else {
+    SDL_SetRenderTarget(sdl_renderer, field_texture);
+    SDL_SetRenderDrawColor(sdl_renderer, 0x1E, 0x1E, 0x1E, 0xFF);
+    SDL_RenderClear(sdl_renderer);
+    SDL_SetRenderTarget(sdl_renderer, nullptr);
+  }
+
+  // leave one extra space outside space to represent border
+  block.w = screen_width / grid_width - 2;
+  block.h = screen_height / grid_height - 2;
+  rects.reserve(grid_width * grid_height);
+  drawn_rows.assign(grid_height, 0);
+  SDL_SetRenderDrawBlendMode(sdl_renderer, SDL_BLENDMODE_BLEND);
 }
 
 Renderer::~Renderer() {
+  if (field_texture != nullptr)
+    SDL_DestroyTexture(field_texture);
+  SDL_DestroyRenderer(sdl_renderer);
   SDL_DestroyWindow(sdl_window);
   SDL_Quit();
 }
 
-void Renderer::Render(Piece const &piece, Field const &field) {
-  SDL_Rect block;
-  // leave one extra space outside space to represent border
-  block.w = screen_width / grid_width - 2;
-  block.h = screen_height / grid_height - 2;
+void Renderer::AddCellRect(int x, int y) {
+  block.x = 1 + x * (block.w + 2);
+  block.y = 1 + y * (block.h + 2);
+  rects.emplace_back(block);
+}
 
-  // Clear screen
+// redraws the rows of the field that changed since the previous frame into the
+// field texture: each dirty band is cleared to the background color and its
+// occupied cells are filled with a single batched call. The snapshot is
+// compared with the rows last drawn, so snapshots skipped by the render loop
+// are accounted for
+void Renderer::UpdateFieldTexture(FrameSnapshot const &frame) {
+  int height = std::min<int>(frame.height, drawn_rows.size());
+  int top = 0;
+  while (top < height and frame.rows[top] == drawn_rows[top])
+    top++;
+  int bottom = height - 1;
+  while (bottom >= top and frame.rows[bottom] == drawn_rows[bottom])
+    bottom--;
+  if (top > bottom)
+    return;
+  std::copy(frame.rows.begin() + top, frame.rows.begin() + bottom + 1,
+            drawn_rows.begin() + top);
+
+  SDL_SetRenderTarget(sdl_renderer, field_texture);
+  SDL_Rect band{0, top * (block.h + 2), static_cast<int>(screen_width),
+                (bottom - top + 1) * (block.h + 2)};
   SDL_SetRenderDrawColor(sdl_renderer, 0x1E, 0x1E, 0x1E, 0xFF);
-  SDL_RenderClear(sdl_renderer);
+  SDL_RenderFillRect(sdl_renderer, &band);
+
+  rects.clear();
+  for (int y = top; y <= bottom; y++) {
+    // visits the occupied cells of the row, lowest bit first
+    for (Field::Row row = frame.rows[y]; row != 0; row &= row - 1)
+      AddCellRect(__builtin_ctzll(row), y);
+  }
+  SDL_SetRenderDrawColor(sdl_renderer, 255, 255, 255, 255);
+  SDL_RenderFillRects(sdl_renderer, rects.data(), rects.size());
+  SDL_SetRenderTarget(sdl_renderer, nullptr);
+}
+
+// draws the cached field texture, then the ghost and the current piece with one
+// call per color, so the number of draw calls does not depend on the grid size
+void Renderer::Render(FrameSnapshot const &frame) {
+  if (field_texture != nullptr) {
+    UpdateFieldTexture(frame);
+    SDL_RenderCopy(sdl_renderer, field_texture, nullptr, nullptr);
+  } else {
+    // without a texture every row is redrawn straight to the screen
+    SDL_SetRenderDrawColor(sdl_renderer, 0x1E, 0x1E, 0x1E, 0xFF);
+    SDL_RenderClear(sdl_renderer);
+    rects.clear();
+    for (int y = 0; y < frame.height; y++) {
+      for (Field::Row row = frame.rows[y]; row != 0; row &= row - 1)
+        AddCellRect(__builtin_ctzll(row), y);
+    }
+    SDL_SetRenderDrawColor(sdl_renderer, 255, 255, 255, 255);
+    SDL_RenderFillRects(sdl_renderer, rects.data(), rects.size());
+  }
+
+  const std::array<std::uint8_t, 4> &color =
+      GetPieceShapes(frame.pieceType).color;
+  // cells outside the field, e.g. above its top, are not drawn
+  auto visible = [&frame](int x, int y) {
+    return x >= 0 and x < frame.width and y >= 0 and y < frame.height;
+  };
+
+  // Render ghost piece, a translucent copy of the piece where it would land
+  int drop = ghost_piece ? frame.ghostDrop : 0;
+  if (drop > 0) {
+    rects.clear();
+    for (auto &c : frame.body) {
+      if (visible(c.x, c.y + drop))
+        AddCellRect(c.x, c.y + drop);
+    }
+    SDL_SetRenderDrawColor(sdl_renderer, color[0], color[1], color[2], 0x50);
+    SDL_RenderFillRects(sdl_renderer, rects.data(), rects.size());
+  }
 
   // Render piece
-  const std::vector<int> &color = piece.GetColorCodes();
+  rects.clear();
+  for (auto &c : frame.body) {
+    if (visible(c.x, c.y))
+      AddCellRect(c.x, c.y);
+  }
   SDL_SetRenderDrawColor(sdl_renderer, color[0], color[1], color[2], color[3]);
+  SDL_RenderFillRects(sdl_renderer, rects.data(), rects.size());
+}
 
-  for (auto &c : piece.GetBody()) {
-    if (!piece.CellOutsideScreen(c[0], c[1])) {
-      block.x = 1 + c[0] * (block.w + 2);
-      block.y = 1 + c[1] * (block.h + 2);
-      SDL_RenderFillRect(sdl_renderer, &block);
+// draws one row of bars per frame phase: max, p99.9, p99 and p50 on top of
+// each other, scaled so the target frame duration (white line) is at half of
+// the panel
+void Renderer::RenderOverlay(FrameProfiler const &profiler,
+                             std::chrono::nanoseconds target_frame_duration) {
+  constexpr int kRowHeight{12};
+  constexpr int kMargin{4};
+  const double percentiles[] = {100.0, 99.9, 99.0, 50.0};
+  const Uint8 colors[][3] = {
+      {200, 40, 40}, {240, 140, 0}, {240, 220, 0}, {60, 200, 60}};
+  int width = static_cast<int>(screen_width) - 2 * kMargin;
+  double pixelsPerNs = width / (2.0 * target_frame_duration.count());
+
+  SDL_Rect panel{kMargin, kMargin, width,
+                 FrameProfiler::kNumPhases * kRowHeight + kMargin};
+  SDL_SetRenderDrawColor(sdl_renderer, 0, 0, 0, 0xB0);
+  SDL_RenderFillRect(sdl_renderer, &panel);
+
+  for (int p = 0; p < 4; p++) {
+    rects.clear();
+    for (int i = 0; i < FrameProfiler::kNumPhases; i++) {
+      const LatencyHistogram &h =
+          profiler.GetHistogram(static_cast<FramePhase>(i));
+      double w = h.GetPercentile(percentiles[p]) * pixelsPerNs;
+      rects.emplace_back(SDL_Rect{kMargin, kMargin + 2 + i * kRowHeight,
+                                  static_cast<int>(std::min<double>(w, width)),
+                                  kRowHeight - 2});
     }
+    SDL_SetRenderDrawColor(sdl_renderer, colors[p][0], colors[p][1],
+                           colors[p][2], 0xFF);
+    SDL_RenderFillRects(sdl_renderer, rects.data(), rects.size());
   }
 
-  // Render field
+  SDL_Rect budget{kMargin + width / 2, kMargin, 1, panel.h};
   SDL_SetRenderDrawColor(sdl_renderer, 255, 255, 255, 255);
+  SDL_RenderFillRect(sdl_renderer, &budget);
+}
 
-  auto &grid = field.GetGrid();
-  for (int x = 0; x < field.GetWidth(); x++) {
-    for (int y = 0; y < field.GetHeight(); y++) {
-      if (grid[y][x] == 1) {
-        block.x = 1 + x * (block.w + 2);
-        block.y = 1 + y * (block.h + 2);
-        SDL_RenderFillRect(sdl_renderer, &block);
-      }
-    }
+bool Renderer::ReadPixels(std::uint8_t *pixels, int pitch) {
+  SDL_Rect frame{0, 0, static_cast<int>(screen_width),
+                 static_cast<int>(screen_height)};
+  if (SDL_RenderReadPixels(sdl_renderer, &frame, SDL_PIXELFORMAT_RGB24, pixels,
+                           pitch) != 0) {
+    std::cerr << "Pixels could not be read.\n";
+    std::cerr << "SDL_Error: " << SDL_GetError() << "\n";
+    return false;
   }
-
-  // Update Screen
-  SDL_RenderPresent(sdl_renderer);
+  return true;
 }
 
-void Renderer::UpdateWindowTitle(int score, int level, int fps) {
+// Update Screen
+void Renderer::Present() { SDL_RenderPresent(sdl_renderer); }
+
+void Renderer::UpdateWindowTitle(int score, int level, int fps,
+                                 FrameProfiler const *profiler) {
   std::string title{"Tetris Score: " + std::to_string(score) + " Level: " +
                     std::to_string(level) + " FPS: " + std::to_string(fps)};
+  if (profiler != nullptr) {
+    // frame time percentiles in milliseconds, with one decimal
+    const LatencyHistogram &h = profiler->GetHistogram(FramePhase::kFrame);
+    auto ms = [](std::uint64_t ns) {
+      return std::to_string(ns / 1000000) + "." +
+             std::to_string(ns / 100000 % 10);
+    };
+    title += " Frame ms p50: " + ms(h.GetPercentile(50)) +
+             " p99: " + ms(h.GetPercentile(99)) +
+             " p99.9: " + ms(h.GetPercentile(99.9)) + " max: " + ms(h.GetMax());
+  }
   SDL_SetWindowTitle(sdl_window, title.c_str());
 }
@@ -3,26 +3,49 @@
 
 #include "SDL.h"
 #include "field.h"
-#include "piece.h"
+#include "frame_profiler.h"
+#include "frame_snapshot.h"
+#include <chrono>
 #include <vector>
 
 class Renderer {
 public:
+  // with vsync, Present waits for the display's refresh, software renders
+  // without the GPU and hidden does not show the window, e.g. to capture
+  // frames offscreen
   Renderer(const std::size_t screen_width, const std::size_t screen_height,
-           const std::size_t grid_width, const std::size_t grid_height);
+           const std::size_t grid_width, const std::size_t grid_height,
+           bool vsync = false, bool software = false, bool hidden = false);
   ~Renderer();
 
-  void Render(Piece const &piece, Field const &field);
-  void UpdateWindowTitle(int score, int level, int fps);
+  void Render(FrameSnapshot const &frame);
+  void RenderOverlay(FrameProfiler const &profiler,
+                     std::chrono::nanoseconds target_frame_duration);
+  // copies the rendered frame as RGB, three bytes per pixel, into the input
+  // buffer of screen_width x screen_height pixels. Called before Present,
+  // which leaves the frame undefined. Returns false if it fails
+  bool ReadPixels(std::uint8_t *pixels, int pitch);
+  void Present();
+  void UpdateWindowTitle(int score, int level, int fps,
+                         FrameProfiler const *profiler = nullptr);
+  void SetGhostPiece(bool enabled) { ghost_piece = enabled; }
 
 private:
+  void UpdateFieldTexture(FrameSnapshot const &frame);
+  void AddCellRect(int x, int y);
+
   SDL_Window *sdl_window;
   SDL_Renderer *sdl_renderer;
+  SDL_Texture *field_texture{nullptr}; // settled field, redrawn by dirty rows
+  std::vector<Field::Row> drawn_rows; // rows currently in the field texture
 
   const std::size_t screen_width;
   const std::size_t screen_height;
   const std::size_t grid_width;
   const std::size_t grid_height;
+  bool ghost_piece{true}; // draws where the piece would land when dropped
+  SDL_Rect block;         // size of one cell on screen
+  std::vector<SDL_Rect> rects; // cells batched into one draw call per color
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,137 @@
+#include "replay.h"
+#include <fstream>
+#include <iterator>
+
+constexpr char Replay::kMagic[4];
+
+void Replay::PutVarint(std::string &out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out += static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+bool Replay::GetVarint(const std::uint8_t *&p, const std::uint8_t *end,
+                       std::uint64_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 64 and p < end; shift += 7) {
+    std::uint8_t byte = *p++;
+    value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+void Replay::EncodeHeader(std::string &out, const Simulation &simulation) {
+  out.append(kMagic, sizeof(kMagic));
+  out += static_cast<char>(kVersion);
+  PutVarint(out, simulation.GetField().GetWidth());
+  PutVarint(out, simulation.GetField().GetHeight());
+  PutVarint(out, simulation.GetSeed());
+}
+
+void Replay::EncodeEvent(std::string &out, std::uint64_t ticks,
+                         std::uint8_t actions) {
+  PutVarint(out, ticks << 4 | (actions & 0x0f));
+}
+
+void Replay::EncodeEnd(std::string &out, std::uint64_t ticks,
+                       const Simulation &simulation) {
+  PutVarint(out, ticks << 4);
+  PutVarint(out, simulation.GetScore());
+  PutVarint(out, simulation.GetRowsCleared());
+  std::uint64_t hash = HashField(simulation.GetField());
+  for (int i = 0; i < 8; i++)
+    out += static_cast<char>(hash >> (8 * i));
+}
+
+std::uint64_t Replay::HashField(const Field &field) {
+  std::uint64_t hash = 14695981039346656037ull;
+  for (int y = 0; y < field.GetHeight(); y++) {
+    Field::Row row = field.GetRow(y);
+    for (int i = 0; i < 8; i++) {
+      hash ^= (row >> (8 * i)) & 0xff;
+      hash *= 1099511628211ull;
+    }
+  }
+  return hash;
+}
+
+bool Replay::Load(const std::string &path, Replay &replay) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    return false;
+  std::string data((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+  const auto *p = reinterpret_cast<const std::uint8_t *>(data.data());
+  const std::uint8_t *end = p + data.size();
+  if (data.size() < sizeof(kMagic) + 1 or
+      data.compare(0, sizeof(kMagic), kMagic, sizeof(kMagic)) != 0 or
+      p[sizeof(kMagic)] != kVersion)
+    return false;
+  p += sizeof(kMagic) + 1;
+
+  std::uint64_t width, height, seed;
+  if (!GetVarint(p, end, width) or !GetVarint(p, end, height) or
+      !GetVarint(p, end, seed) or width < Field::kMinWidth or
+      width > Field::kMaxWidth or height == 0 or height > Field::kMaxHeight)
+    return false;
+  replay = Replay{};
+  replay.width = static_cast<int>(width);
+  replay.height = static_cast<int>(height);
+  replay.seed = static_cast<std::uint32_t>(seed);
+
+  std::uint64_t tick{0};
+  std::uint64_t value;
+  while (GetVarint(p, end, value)) {
+    tick += value >> 4;
+    std::uint8_t actions = value & 0x0f;
+    if (actions != 0) {
+      replay.events.push_back(Event{tick, actions});
+      continue;
+    }
+    std::uint64_t score, rows;
+    if (!GetVarint(p, end, score) or !GetVarint(p, end, rows) or end - p < 8)
+      return false;
+    replay.finalTick = tick;
+    replay.score = static_cast<int>(score);
+    replay.rowsCleared = static_cast<int>(rows);
+    for (int i = 0; i < 8; i++)
+      replay.fieldHash |= static_cast<std::uint64_t>(p[i]) << (8 * i);
+    replay.finished = true;
+    break;
+  }
+  if (!replay.finished and !replay.events.empty())
+    replay.finalTick = replay.events.back().tick + 1;
+  return true;
+}
+
+Input ReplayPlayer::GetInput(std::uint64_t tick) {
+  while (_next < _replay.events.size() and _replay.events[_next].tick < tick)
+    _next++;
+  Input input;
+  if (_next < _replay.events.size() and _replay.events[_next].tick == tick)
+    input.actions = _replay.events[_next++].actions;
+  return input;
+}
+
+bool ReplayPlayer::IsDone(const Simulation &simulation) const {
+  return simulation.IsGameOver() or
+         simulation.GetTick() >= _replay.finalTick;
+}
+
+bool ReplayPlayer::Matches(const Simulation &simulation) const {
+  return _replay.finished and simulation.GetTick() == _replay.finalTick and
+         simulation.GetScore() == _replay.score and
+         simulation.GetRowsCleared() == _replay.rowsCleared and
+         Replay::HashField(simulation.GetField()) == _replay.fieldHash;
+}
+
+bool ReplayPlayer::Run(const Replay &replay, Simulation &simulation) {
+  ReplayPlayer player(replay);
+  while (!player.IsDone(simulation))
+    simulation.Step(player.GetInput(simulation.GetTick()));
+  return player.Matches(simulation);
+}
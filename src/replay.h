@@ -0,0 +1,79 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "field.h"
+#include "simulation.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// a recorded session: the size and seed of the game, the input applied on
+// every tick that had one, and the final state a playback must reach.
+//
+// On disk a replay is the magic "TRPL", a version byte, then varints for the
+// width, height and seed. Every input follows as one varint holding the ticks
+// since the previous input shifted left by four bits, with the four action
+// bits below, so most inputs take one or two bytes. A varint with no action
+// bits marks the end: its ticks lead to the final tick, and the final score,
+// rows cleared and an 8-byte hash of the field follow
+struct Replay {
+  struct Event {
+    std::uint64_t tick;   // tick the input is applied on
+    std::uint8_t actions; // actions of the input
+  };
+
+  static constexpr char kMagic[4] = {'T', 'R', 'P', 'L'};
+  static constexpr std::uint8_t kVersion{2}; // 2: PCG32 piece generator
+
+  int width{0};
+  int height{0};
+  std::uint32_t seed{0};
+  std::vector<Event> events;
+  bool finished{false}; // the end of the session was recorded
+  std::uint64_t finalTick{0};
+  int score{0};
+  int rowsCleared{0};
+  std::uint64_t fieldHash{0};
+
+  // reads a replay file, returns false if it cannot be read or is malformed.
+  // A replay cut short (e.g. by a crash) loads with finished set to false
+  static bool Load(const std::string &path, Replay &replay);
+
+  static void PutVarint(std::string &out, std::uint64_t value);
+  static bool GetVarint(const std::uint8_t *&p, const std::uint8_t *end,
+                        std::uint64_t &value);
+  static void EncodeHeader(std::string &out, const Simulation &simulation);
+  static void EncodeEvent(std::string &out, std::uint64_t ticks,
+                          std::uint8_t actions);
+  static void EncodeEnd(std::string &out, std::uint64_t ticks,
+                        const Simulation &simulation);
+
+  // FNV-1a hash of the rows of a field
+  static std::uint64_t HashField(const Field &field);
+};
+
+// feeds the inputs of a replay to a simulation created from it
+class ReplayPlayer {
+public:
+  explicit ReplayPlayer(const Replay &replay) : _replay(replay){};
+
+  // returns the input recorded for the step at the input tick, ticks must be
+  // asked for in increasing order
+  Input GetInput(std::uint64_t tick);
+
+  // true once the simulation reached the end of the recording
+  bool IsDone(const Simulation &simulation) const;
+
+  // true if the simulation ended in the recorded state
+  bool Matches(const Simulation &simulation) const;
+
+  // plays the whole replay headless as fast as possible, returns true if the
+  // final state matches the recording
+  static bool Run(const Replay &replay, Simulation &simulation);
+
+private:
+  const Replay &_replay;
+  std::size_t _next{0}; // next event to apply
+};
+
+#endif
@@ -0,0 +1,77 @@
+#include "replay_writer.h"
+#include "logger.h"
+#include <chrono>
+
+ReplayWriter::~ReplayWriter() {
+  _running = false;
+  if (_thread.joinable())
+    _thread.join();
+}
+
+bool ReplayWriter::Open(const std::string &path,
+                        const Simulation &simulation) {
+  _out.open(path, std::ios::binary | std::ios::trunc);
+  if (!_out) {
+    LOG_ERROR("Could not open replay file");
+    return false;
+  }
+  _buffer.clear();
+  Replay::EncodeHeader(_buffer, simulation);
+  _lastTick = 0;
+  _running = true;
+  _thread = std::thread(&ReplayWriter::Run, this);
+  return true;
+}
+
+void ReplayWriter::Record(std::uint64_t tick, const Input &input) {
+  if (input.actions == 0)
+    return;
+  Replay::Event event{tick, input.actions};
+  // keeps the order of the inputs: nothing passes the ones waiting already
+  std::size_t handed = 0;
+  while (handed < _overflow.size() and _events.Push(_overflow[handed]))
+    handed++;
+  _overflow.erase(_overflow.begin(), _overflow.begin() + handed);
+  if (!_overflow.empty() or !_events.Push(event))
+    _overflow.push_back(event);
+}
+
+// encodes the queued inputs and writes them in blocks
+void ReplayWriter::Drain() {
+  Replay::Event event;
+  while (_events.Pop(event)) {
+    Replay::EncodeEvent(_buffer, event.tick - _lastTick, event.actions);
+    _lastTick = event.tick;
+  }
+  if (!_buffer.empty()) {
+    _out.write(_buffer.data(), _buffer.size());
+    _buffer.clear();
+  }
+}
+
+void ReplayWriter::Run() {
+  while (_running.load()) {
+    Drain();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void ReplayWriter::Close(const Simulation &simulation) {
+  if (!_out.is_open())
+    return;
+  _running = false;
+  if (_thread.joinable())
+    _thread.join();
+  Drain();
+  std::size_t handed = 0;
+  while (handed < _overflow.size()) {
+    while (handed < _overflow.size() and _events.Push(_overflow[handed]))
+      handed++;
+    Drain();
+  }
+  _overflow.clear();
+  Replay::EncodeEnd(_buffer, simulation.GetTick() - _lastTick, simulation);
+  _out.write(_buffer.data(), _buffer.size());
+  _buffer.clear();
+  _out.close();
+}
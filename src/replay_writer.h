@@ -0,0 +1,49 @@
+#ifndef REPLAY_WRITER_H
+#define REPLAY_WRITER_H
+
+#include "replay.h"
+#include "ring_buffer.h"
+#include "simulation.h"
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// records a session to a replay file. The frame loop hands each input to a
+// lock-free ring buffer and a background thread encodes and writes them, so
+// recording never waits on the disk
+class ReplayWriter {
+public:
+  ReplayWriter() : _events(kCapacity){};
+  ~ReplayWriter();
+
+  // writes the header for the simulation and starts the writer thread,
+  // returns false if the file cannot be opened
+  bool Open(const std::string &path, const Simulation &simulation);
+
+  // records the input applied on the step at the input tick. Only called by
+  // one thread; if the ring buffer is full the input waits in a local list
+  // and is handed over on a later call, so nothing is lost
+  void Record(std::uint64_t tick, const Input &input);
+
+  // writes every pending input and the end of the session, then closes the
+  // file
+  void Close(const Simulation &simulation);
+
+private:
+  static constexpr std::size_t kCapacity{1 << 14};
+
+  void Run();
+  void Drain();
+
+  RingBuffer<Replay::Event> _events;
+  std::vector<Replay::Event> _overflow; // inputs not yet in the ring buffer
+  std::ofstream _out;
+  std::string _buffer;          // encoded bytes not yet written
+  std::uint64_t _lastTick{0};   // tick of the last encoded input
+  std::atomic<bool> _running{false};
+  std::thread _thread;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// bounded lock-free queue for any number of producers and consumers. Each slot
+// carries a sequence number telling whether it is free to write or ready to
+// read, so neither side ever waits on a lock: Push fails when the queue is
+// full and Pop fails when it is empty
+template <typename T> class RingBuffer {
+public:
+  // capacity is rounded up to a power of two
+  explicit RingBuffer(std::size_t capacity)
+      : _capacity(RoundUp(capacity)), _mask(_capacity - 1),
+        _slots(std::make_unique<Slot[]>(_capacity)) {
+    for (std::size_t i = 0; i < _capacity; i++)
+      _slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  std::size_t GetCapacity() const { return _capacity; }
+
+  // copies the value into the queue, returns false if the queue is full
+  bool Push(const T &value) {
+    std::size_t pos = _tail.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+      slot = &_slots[pos & _mask];
+      std::size_t seq = slot->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+      if (diff == 0) {
+        if (_tail.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = _tail.load(std::memory_order_relaxed);
+      }
+    }
+    slot->value = value;
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // moves the oldest value out of the queue, returns false if it is empty
+  bool Pop(T &value) {
+    std::size_t pos = _head.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+      slot = &_slots[pos & _mask];
+      std::size_t seq = slot->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+      if (diff == 0) {
+        if (_head.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = _head.load(std::memory_order_relaxed);
+      }
+    }
+    value = std::move(slot->value);
+    slot->sequence.store(pos + _capacity, std::memory_order_release);
+    return true;
+  }
+
+  // number of queued values, only exact while no other thread is active
+  std::size_t Size() const {
+    return _tail.load(std::memory_order_acquire) -
+           _head.load(std::memory_order_acquire);
+  }
+
+private:
+  struct Slot {
+    std::atomic<std::size_t> sequence;
+    T value;
+  };
+
+  static std::size_t RoundUp(std::size_t n) {
+    std::size_t c = 1;
+    while (c < n)
+      c <<= 1;
+    return c;
+  }
+
+  const std::size_t _capacity;
+  const std::size_t _mask;
+  std::unique_ptr<Slot[]> _slots;
+  // producers and consumers touch different cache lines
+  alignas(64) std::atomic<std::size_t> _tail{0};
+  alignas(64) std::atomic<std::size_t> _head{0};
+};
+
+#endif
@@ -0,0 +1,25 @@
+#include "scheduler.h"
+
+Scheduler::Scheduler(Clock::duration tick, int maxTicksPerUpdate)
+    : _tick(tick), _maxTicksPerUpdate(maxTicksPerUpdate) {
+  Start();
+}
+
+void Scheduler::Start() {
+  _start = Clock::now();
+  _ticks = 0;
+}
+
+// the number of due ticks is derived from the total time elapsed since the
+// start rather than from the previous call, so rounding errors never add up
+int Scheduler::Update() {
+  std::uint64_t due = (Clock::now() - _start) / _tick;
+  std::uint64_t ticks = due - _ticks;
+  if (ticks > static_cast<std::uint64_t>(_maxTicksPerUpdate)) {
+    // skips the ticks that cannot be caught up by moving the start forward
+    _start += (ticks - _maxTicksPerUpdate) * _tick;
+    ticks = _maxTicksPerUpdate;
+  }
+  _ticks += ticks;
+  return static_cast<int>(ticks);
+}
@@ -0,0 +1,42 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <chrono>
+#include <cstdint>
+
+// converts steady clock time into the number of fixed simulation ticks that
+// are due, so gravity, locking and spawning all follow a single time base
+class Scheduler {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  Scheduler(Clock::duration tick, int maxTicksPerUpdate);
+
+  // restarts counting ticks from now
+  void Start();
+
+  // returns the number of ticks that became due since the previous call, at
+  // most maxTicksPerUpdate, the rest is dropped after a long stall
+  int Update();
+
+  std::uint64_t GetTicks() const { return _ticks; };
+
+  // returns the tick during which the input time lies, ticks are numbered
+  // from 0 and tick n becomes due once it is over
+  std::uint64_t GetTickAt(Clock::time_point time) const {
+    return time <= _start ? 0 : (time - _start) / _tick;
+  };
+
+  // returns the time at which the next tick becomes due
+  Clock::time_point GetNextTick() const {
+    return _start + (_ticks + 1) * _tick;
+  };
+
+private:
+  Clock::duration _tick;    // duration of one tick
+  int _maxTicksPerUpdate;   // limit of ticks caught up at once
+  Clock::time_point _start; // time of tick 0
+  std::uint64_t _ticks{0};  // number of ticks handed out since the start
+};
+
+#endif
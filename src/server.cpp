@@ -0,0 +1,414 @@
+#include "server.h"
+#include "logger.h"
+#include "protocol.h"
+#include "scheduler.h"
+#include "simulation.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kMaxEvents{256};
+constexpr int kMaxTicksPerUpdate{250}; // catch up at most 250 ms
+constexpr int kAcceptsPerWake{64};     // leaves the rest to the other loops
+constexpr int kWaitMs{100};            // how soon a stop is noticed
+constexpr std::size_t kMaxInbox{1 << 16}; // larger bursts close the session
+// a client that reads slower than its deltas arrive gets no new deltas until
+// it catches up, it misses nothing since deltas are taken from the last state
+// it was sent
+constexpr std::size_t kMaxOutbox{1 << 16};
+
+// one client connection and its game
+struct Session {
+  int fd{-1};
+  std::size_t index{0}; // position in the loop's sessions
+  Protocol::Join join;
+  std::unique_ptr<Simulation> simulation; // set once the client joined
+  Input pending;                          // inputs received since the tick
+  std::uint32_t inputsReceived{0};
+  std::uint32_t inputsApplied{0};
+  GameState sent{};             // state of the last delta sent
+  std::uint32_t sentInputs{0};  // inputs applied as of the last delta
+  std::uint8_t flags{0};        // flags of the next delta
+  std::string inbox;            // received bytes not yet decoded
+  std::string outbox;           // encoded deltas not yet sent
+  bool writable{true};          // false until the socket takes more bytes
+  bool closed{false};
+};
+
+} // namespace
+
+// the sessions of one thread, see Server
+class EventLoop {
+public:
+  EventLoop(int listenFd, const Server::Config &config);
+  ~EventLoop();
+  EventLoop(const EventLoop &) = delete;
+  EventLoop &operator=(const EventLoop &) = delete;
+
+  void Run(const std::atomic<bool> &running);
+
+  std::uint64_t GetSessions() const {
+    return _sessionCount.load(std::memory_order_relaxed);
+  };
+  // only valid while the loop is not running
+  const Server::Stats &GetStats() const { return _stats; };
+
+private:
+  void Accept();
+  void Read(Session &session);
+  void Write(Session &session);
+  void Handle(Session &session, Protocol::MessageType type,
+              const std::uint8_t *payload, std::size_t size);
+  void Advance();
+  void SendDeltas();
+  void Close(Session &session);
+  void Reap();
+
+  const Server::Config &_config;
+  int _listenFd;
+  int _epoll;
+  int _timer; // fires every tick
+  Scheduler _scheduler;
+  int _sendTicks;              // ticks between two deltas
+  std::uint64_t _nextSend{0}; // tick of the next deltas
+  std::vector<std::unique_ptr<Session>> _sessions;
+  std::vector<Session *> _closed; // deleted once their events are handled
+  GameState _current{};           // state being sent
+  std::atomic<std::uint64_t> _sessionCount{0};
+  Server::Stats _stats;
+};
+
+EventLoop::EventLoop(int listenFd, const Server::Config &config)
+    : _config(config), _listenFd(listenFd),
+      _epoll(::epoll_create1(EPOLL_CLOEXEC)),
+      _timer(::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+      _scheduler(std::chrono::milliseconds(Simulation::kTickMs),
+                 kMaxTicksPerUpdate),
+      _sendTicks(std::max(1, config.sendIntervalMs / Simulation::kTickMs)) {
+  // every loop waits for new connections, but only one is woken per
+  // connection
+  epoll_event event{};
+  event.events = EPOLLIN | EPOLLEXCLUSIVE;
+  event.data.ptr = &_listenFd;
+  ::epoll_ctl(_epoll, EPOLL_CTL_ADD, _listenFd, &event);
+  event.events = EPOLLIN;
+  event.data.ptr = &_timer;
+  ::epoll_ctl(_epoll, EPOLL_CTL_ADD, _timer, &event);
+}
+
+EventLoop::~EventLoop() {
+  for (auto &session : _sessions) {
+    if (!session->closed)
+      ::close(session->fd);
+  }
+  ::close(_timer);
+  ::close(_epoll);
+}
+
+// waits for socket and timer events until the server stops. A session's
+// events are handled completely before the next epoll_wait, and a session
+// closed on the way is only deleted afterwards, since later events of the
+// same batch may still point at it
+void EventLoop::Run(const std::atomic<bool> &running) {
+  itimerspec period{};
+  period.it_interval.tv_nsec = Simulation::kTickMs * 1000000L;
+  period.it_value = period.it_interval;
+  ::timerfd_settime(_timer, 0, &period, nullptr);
+  _scheduler.Start();
+  _nextSend = _sendTicks;
+
+  Clock::time_point start = Clock::now();
+  Clock::duration waiting{0};
+  epoll_event events[kMaxEvents];
+  while (running.load(std::memory_order_relaxed)) {
+    Clock::time_point waitStart = Clock::now();
+    int n = ::epoll_wait(_epoll, events, kMaxEvents, kWaitMs);
+    waiting += Clock::now() - waitStart;
+    for (int i = 0; i < n; i++) {
+      void *ptr = events[i].data.ptr;
+      if (ptr == &_listenFd) {
+        Accept();
+      } else if (ptr == &_timer) {
+        std::uint64_t expirations;
+        if (::read(_timer, &expirations, sizeof(expirations)) > 0)
+          Advance();
+      } else {
+        Session &session = *static_cast<Session *>(ptr);
+        if (!session.closed and
+            events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+          Read(session);
+        if (!session.closed and events[i].events & EPOLLOUT) {
+          session.writable = true;
+          Write(session);
+        }
+      }
+    }
+    Reap();
+  }
+  itimerspec stop{};
+  ::timerfd_settime(_timer, 0, &stop, nullptr);
+  _stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  _stats.busySeconds =
+      _stats.seconds - std::chrono::duration<double>(waiting).count();
+  _stats.sessions = _sessions.size();
+}
+
+void EventLoop::Accept() {
+  for (int i = 0; i < kAcceptsPerWake; i++) {
+    int fd = ::accept4(_listenFd, nullptr, nullptr,
+                       SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+      return;
+    if (_sessions.size() >=
+        static_cast<std::size_t>(_config.maxSessionsPerLoop)) {
+      ::close(fd);
+      continue;
+    }
+    // fails harmlessly on UNIX sockets
+    int on = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    auto session = std::make_unique<Session>();
+    session->fd = fd;
+    session->index = _sessions.size();
+    // edge-triggered, so a session costs no epoll_ctl after this one
+    epoll_event event{};
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = session.get();
+    if (::epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+      ::close(fd);
+      continue;
+    }
+    _sessions.push_back(std::move(session));
+    _sessionCount.store(_sessions.size(), std::memory_order_relaxed);
+    _stats.peakSessions = std::max<std::uint64_t>(_stats.peakSessions,
+                                                  _sessions.size());
+  }
+}
+
+// reads until the socket is drained, then handles every complete message
+void EventLoop::Read(Session &session) {
+  char buffer[4096];
+  while (true) {
+    ssize_t n = ::recv(session.fd, buffer, sizeof(buffer), 0);
+    if (n > 0) {
+      session.inbox.append(buffer, n);
+      if (session.inbox.size() > kMaxInbox) {
+        Close(session);
+        return;
+      }
+      continue;
+    }
+    if (n < 0 and errno == EINTR)
+      continue;
+    if (n == 0 or (errno != EAGAIN and errno != EWOULDBLOCK)) {
+      Close(session);
+      return;
+    }
+    break;
+  }
+  std::size_t offset = 0;
+  Protocol::MessageType type;
+  const std::uint8_t *payload;
+  std::size_t size;
+  while (!session.closed and
+         Protocol::NextMessage(session.inbox, offset, type, payload, size))
+    Handle(session, type, payload, size);
+  if (!session.closed)
+    session.inbox.erase(0, offset);
+}
+
+// sends as much of the outbox as the socket takes, the rest waits for the
+// next EPOLLOUT
+void EventLoop::Write(Session &session) {
+  std::size_t sent = 0;
+  while (session.writable and sent < session.outbox.size()) {
+    ssize_t n = ::send(session.fd, session.outbox.data() + sent,
+                       session.outbox.size() - sent, MSG_NOSIGNAL);
+    if (n >= 0) {
+      sent += n;
+    } else if (errno == EAGAIN or errno == EWOULDBLOCK) {
+      session.writable = false;
+    } else if (errno != EINTR) {
+      Close(session);
+      return;
+    }
+  }
+  session.outbox.erase(0, sent);
+  _stats.bytesSent += sent;
+}
+
+// a client must join before its inputs count, anything unexpected closes the
+// connection
+void EventLoop::Handle(Session &session, Protocol::MessageType type,
+                       const std::uint8_t *payload, std::size_t size) {
+  if (type == Protocol::MessageType::kJoin and !session.simulation and
+      Protocol::DecodeJoin(payload, size, session.join)) {
+    session.simulation = std::make_unique<Simulation>(
+        session.join.width, session.join.height, session.join.seed);
+    session.flags = Protocol::kReset;
+    _stats.joined++;
+    _stats.games++;
+  } else if (type == Protocol::MessageType::kInput and session.simulation and
+             size == 1) {
+    session.pending.actions |= payload[0];
+    session.inputsReceived++;
+  } else {
+    Close(session);
+  }
+}
+
+// advances every game by the ticks that became due, applying the inputs
+// received since the last tick on the first of them, and sends the deltas
+// when they are due
+void EventLoop::Advance() {
+  int ticks = _scheduler.Update();
+  if (ticks == 0)
+    return;
+  Clock::duration tick = std::chrono::milliseconds(Simulation::kTickMs);
+  Clock::time_point firstDue = _scheduler.GetNextTick() - ticks * tick;
+  for (auto &session : _sessions) {
+    Simulation *simulation = session->simulation.get();
+    if (session->closed or !simulation)
+      continue;
+    simulation->Step(session->pending);
+    _stats.inputs += session->inputsReceived - session->inputsApplied;
+    session->inputsApplied = session->inputsReceived;
+    session->pending = Input{};
+    for (int i = 1; i < ticks and !simulation->IsGameOver(); i++)
+      simulation->Step(Input{});
+    _stats.ticks += ticks;
+  }
+  Clock::time_point end = Clock::now();
+  for (int i = 0; i < ticks; i++)
+    _stats.tickLatency.Record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - firstDue -
+                                                             i * tick)
+            .count());
+  if (_scheduler.GetTicks() >= _nextSend) {
+    SendDeltas();
+    _nextSend = _scheduler.GetTicks() + _sendTicks;
+  }
+}
+
+// encodes the changes since the last delta of every session and sends them.
+// A game that ended is reported and replaced by a new one with the next seed
+void EventLoop::SendDeltas() {
+  for (auto &session : _sessions) {
+    Simulation *simulation = session->simulation.get();
+    if (session->closed or !simulation or
+        session->outbox.size() > kMaxOutbox)
+      continue;
+    simulation->Save(_current);
+    std::uint8_t flags = session->flags;
+    if (simulation->IsGameOver())
+      flags |= Protocol::kGameOver;
+    if (Protocol::EncodeDelta(session->outbox, session->sent,
+                              session->sentInputs, _current,
+                              session->inputsApplied, flags)) {
+      std::memcpy(&session->sent, &_current, sizeof(GameState));
+      session->sentInputs = session->inputsApplied;
+      session->flags = 0;
+      _stats.deltas++;
+    }
+    if (simulation->IsGameOver()) {
+      session->join.seed++;
+      session->simulation = std::make_unique<Simulation>(
+          session->join.width, session->join.height, session->join.seed);
+      session->flags = Protocol::kReset;
+      _stats.games++;
+    }
+    Write(*session);
+  }
+}
+
+void EventLoop::Close(Session &session) {
+  if (session.closed)
+    return;
+  session.closed = true;
+  ::close(session.fd);
+  _closed.push_back(&session);
+}
+
+// deletes the closed sessions, moving the last session into each one's place
+void EventLoop::Reap() {
+  for (Session *session : _closed) {
+    std::size_t index = session->index;
+    _sessions[index] = std::move(_sessions.back());
+    _sessions[index]->index = index;
+    _sessions.pop_back();
+  }
+  _closed.clear();
+  _sessionCount.store(_sessions.size(), std::memory_order_relaxed);
+}
+
+Server::Server(const Config &config) : _config(config) {
+  if (_config.threads <= 0)
+    _config.threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+Server::~Server() {
+  Stop();
+  if (_listenFd >= 0)
+    ::close(_listenFd);
+}
+
+bool Server::Listen(const std::string &address, std::string &error) {
+  _listenFd = Protocol::Listen(address, error);
+  return _listenFd >= 0;
+}
+
+void Server::Start() {
+  _running = true;
+  for (int i = 0; i < _config.threads; i++) {
+    _loops.push_back(std::make_unique<EventLoop>(_listenFd, _config));
+    _threads.emplace_back(&EventLoop::Run, _loops.back().get(),
+                          std::cref(_running));
+  }
+  LOG_INFO("Server started {} event loops", _config.threads);
+}
+
+void Server::Stop() {
+  _running = false;
+  for (std::thread &thread : _threads)
+    thread.join();
+  _threads.clear();
+}
+
+std::uint64_t Server::GetSessions() const {
+  std::uint64_t sessions = 0;
+  for (const auto &loop : _loops)
+    sessions += loop->GetSessions();
+  return sessions;
+}
+
+Server::Stats Server::GetStats() const {
+  Stats stats;
+  stats.loops = GetLoops();
+  for (const auto &loop : _loops) {
+    const Stats &s = loop->GetStats();
+    stats.sessions += s.sessions;
+    stats.peakSessions += s.peakSessions;
+    stats.joined += s.joined;
+    stats.games += s.games;
+    stats.ticks += s.ticks;
+    stats.inputs += s.inputs;
+    stats.deltas += s.deltas;
+    stats.bytesSent += s.bytesSent;
+    stats.seconds = std::max(stats.seconds, s.seconds);
+    stats.busySeconds += s.busySeconds;
+    stats.tickLatency.Merge(s.tickLatency);
+  }
+  return stats;
+}
@@ -0,0 +1,73 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "histogram.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class EventLoop;
+
+// headless game server hosting many sessions, one per client connection.
+// Every event loop thread owns an epoll instance, a timer and the sessions it
+// accepted: it reads their inputs, advances all their simulations on the
+// fixed tick and sends each client a delta of its game every send interval.
+// The listening socket is shared by all loops, each connection is accepted
+// by whichever loop wakes up for it and stays on that loop, so nothing is
+// shared between the loops while they run
+class Server {
+public:
+  struct Config {
+    int threads{0};          // event loops, 0 for one per hardware core
+    int sendIntervalMs{16};  // deltas are sent at most this often
+    int maxSessionsPerLoop{65536};
+  };
+
+  // counters of all loops, complete once the server stopped
+  struct Stats {
+    int loops{0};
+    std::uint64_t sessions{0};     // sessions connected when stopped
+    std::uint64_t peakSessions{0}; // sum of the most each loop ever held
+    std::uint64_t joined{0};       // sessions that joined a game
+    std::uint64_t games{0};        // games started, including restarts
+    std::uint64_t ticks{0};        // ticks simulated, summed over sessions
+    std::uint64_t inputs{0};       // inputs applied
+    std::uint64_t deltas{0};       // deltas sent
+    std::uint64_t bytesSent{0};
+    double seconds{0};             // time the loops ran
+    double busySeconds{0};         // time they worked, summed over loops
+    // time from a tick becoming due until every session of its loop was
+    // advanced past it
+    LatencyHistogram tickLatency;
+  };
+
+  explicit Server(const Config &config);
+  ~Server();
+  Server(const Server &) = delete;
+  Server &operator=(const Server &) = delete;
+
+  // opens the listening socket, see Protocol::Listen for the address format.
+  // Returns false and a message if it cannot be opened
+  bool Listen(const std::string &address, std::string &error);
+
+  // starts the event loops, which run until Stop
+  void Start();
+  void Stop();
+
+  int GetLoops() const { return static_cast<int>(_loops.size()); };
+  // sessions connected right now, safe to call while running
+  std::uint64_t GetSessions() const;
+  Stats GetStats() const;
+
+private:
+  Config _config;
+  int _listenFd{-1};
+  std::atomic<bool> _running{false};
+  std::vector<std::unique_ptr<EventLoop>> _loops;
+  std::vector<std::thread> _threads;
+};
+
+#endif
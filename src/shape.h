@@ -0,0 +1,132 @@
+#ifndef SHAPE_H
+#define SHAPE_H
+
+#include <array>
+#include <cstdint>
+
+// compile-time tables describing the shapes of the seven tetrominoes
+
+enum class PieceType : std::uint8_t {
+  kLong = 0,
+  kSquare,
+  kJ,
+  kL,
+  kS,
+  kT,
+  kZ
+};
+
+constexpr int kNumPieceTypes{7};
+constexpr int kMaxRotations{4};
+
+// x-y position of a cell, either absolute or relative to the piece's center
+struct Cell {
+  int x;
+  int y;
+};
+
+using Body = std::array<Cell, 4>; // cells of a tetromino
+
+// bitmask of one piece shape, one word per row of its bounding box, bit 0 of
+// each word is the leftmost column of the bounding box
+struct ShapeMask {
+  int left{0};   // column offset of bit 0 relative to the piece's center
+  int top{0};    // row offset of rows[0] relative to the piece's center
+  int width{0};  // number of columns of the bounding box
+  int height{0}; // number of rows of the bounding box
+  std::array<std::uint64_t, 4> rows{};
+  std::uint64_t columns{0}; // one bit per column of the bounding box
+  std::array<int, 4> bottoms{}; // row offset of the lowest cell per column
+};
+
+// computes the bitmask of a shape from the offsets of its cells
+constexpr ShapeMask MakeShapeMask(const Body &body) {
+  ShapeMask mask;
+  int right = body[0].x;
+  int bottom = body[0].y;
+  mask.left = body[0].x;
+  mask.top = body[0].y;
+  for (const Cell &c : body) {
+    mask.left = c.x < mask.left ? c.x : mask.left;
+    mask.top = c.y < mask.top ? c.y : mask.top;
+    right = c.x > right ? c.x : right;
+    bottom = c.y > bottom ? c.y : bottom;
+  }
+  mask.width = right - mask.left + 1;
+  mask.height = bottom - mask.top + 1;
+  for (int i = 0; i < mask.width; i++)
+    mask.bottoms[i] = mask.top;
+  for (const Cell &c : body) {
+    int col = c.x - mask.left;
+    mask.rows[c.y - mask.top] |= std::uint64_t{1} << col;
+    mask.columns |= std::uint64_t{1} << col;
+    mask.bottoms[col] = c.y > mask.bottoms[col] ? c.y : mask.bottoms[col];
+  }
+  return mask;
+}
+
+// all rotations of one tetromino, along with its name and RGBA color
+struct PieceShapes {
+  const char *name;
+  int rotations; // number of distinct rotations, shapes beyond are unused
+  std::array<Body, kMaxRotations> bodies;
+  std::array<ShapeMask, kMaxRotations> masks;
+  std::array<std::uint8_t, 4> color;
+};
+
+constexpr PieceShapes MakePieceShapes(const char *name, int rotations,
+                                      std::array<Body, kMaxRotations> bodies,
+                                      std::array<std::uint8_t, 4> color) {
+  PieceShapes shapes{name, rotations, bodies, {}, color};
+  for (int r = 0; r < kMaxRotations; r++)
+    shapes.masks[r] = MakeShapeMask(bodies[r < rotations ? r : 0]);
+  return shapes;
+}
+
+// shapes of each piece, indexed by PieceType
+inline constexpr std::array<PieceShapes, kNumPieceTypes> kPieceShapes{{
+    MakePieceShapes("LongPiece", 2,
+                    {{{{{-1, 0}, {0, 0}, {1, 0}, {2, 0}}},
+                      {{{0, -2}, {0, -1}, {0, 0}, {0, 1}}}}},
+                    {255, 0, 0, 255}), // red
+    MakePieceShapes("SquarePiece", 1, {{{{{0, 0}, {1, 0}, {0, 1}, {1, 1}}}}},
+                    {255, 255, 0, 255}), // yellow
+    MakePieceShapes("J-Piece", 4,
+                    {{{{{-1, 0}, {0, 0}, {1, 0}, {1, 1}}},
+                      {{{0, -1}, {0, 0}, {0, 1}, {-1, 1}}},
+                      {{{-1, -1}, {-1, 0}, {0, 0}, {1, 0}}},
+                      {{{1, -1}, {0, -1}, {0, 0}, {0, 1}}}}},
+                    {0, 0, 255, 255}), // blue
+    MakePieceShapes("L-Piece", 4,
+                    {{{{{-1, 1}, {-1, 0}, {0, 0}, {1, 0}}},
+                      {{{-1, -1}, {0, -1}, {0, 0}, {0, 1}}},
+                      {{{-1, 0}, {0, 0}, {1, 0}, {1, -1}}},
+                      {{{0, -1}, {0, 0}, {0, 1}, {1, 1}}}}},
+                    {255, 165, 0, 255}), // orange
+    MakePieceShapes("S-Piece", 2,
+                    {{{{{0, 0}, {1, 0}, {-1, 1}, {0, 1}}},
+                      {{{-1, -1}, {-1, 0}, {0, 0}, {0, 1}}}}},
+                    {255, 0, 255, 255}), // pink
+    MakePieceShapes("T-Piece", 4,
+                    {{{{{-1, 0}, {0, 0}, {1, 0}, {0, 1}}},
+                      {{{0, -1}, {-1, 0}, {0, 0}, {0, 1}}},
+                      {{{0, 0}, {-1, 1}, {0, 1}, {1, 1}}},
+                      {{{0, -1}, {0, 0}, {1, 0}, {0, 1}}}}},
+                    {0, 255, 255, 255}), // cyan
+    MakePieceShapes("Z-Piece", 2,
+                    {{{{{-1, 0}, {0, 0}, {0, 1}, {1, 1}}},
+                      {{{1, -1}, {0, 0}, {1, 0}, {0, 1}}}}},
+                    {0, 255, 0, 255}), // green
+}};
+
+inline constexpr const PieceShapes &GetPieceShapes(PieceType type) {
+  return kPieceShapes[static_cast<int>(type)];
+}
+
+// sanity checks evaluated by the compiler
+static_assert(GetPieceShapes(PieceType::kLong).masks[0].rows[0] == 0xF);
+static_assert(GetPieceShapes(PieceType::kLong).masks[1].height == 4);
+static_assert(GetPieceShapes(PieceType::kSquare).masks[0].columns == 0x3);
+static_assert(GetPieceShapes(PieceType::kT).masks[0].bottoms[1] == 1);
+
+#endif
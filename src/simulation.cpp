@@ -0,0 +1,261 @@
+#include "simulation.h"
+#include "logger.h"
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+Simulation::Simulation(int gridWidth, int gridHeight)
+    : Simulation(gridWidth, gridHeight, std::random_device{}()) {}
+
+// Initialize the game with empty field and a starting piece
+Simulation::Simulation(int gridWidth, int gridHeight, std::uint32_t seed)
+    : _gridWidth(gridWidth), _gridHeight(gridHeight), _seed(seed),
+      _generator(seed),
+      _field(std::make_unique<Field>(_gridWidth, _gridHeight)),
+      _piece(PieceType::kLong, _gridWidth, _gridHeight) {
+  Events events;
+  SpawnPiece(events);
+}
+
+namespace {
+
+// returns true if the pieces of a GameState or Snapshot exist and its piece
+// lies inside the grid given by the rows. A running game's piece does not
+// overlap the stack, the piece that ended a game may
+template <typename State>
+bool HasValidPieces(const State &state, const Field::Row *rows) {
+  if (static_cast<int>(state.pieceType) >= kNumPieceTypes)
+    return false;
+  for (PieceType t : state.preview) {
+    if (static_cast<int>(t) >= kNumPieceTypes)
+      return false;
+  }
+  // the cells of a piece lie within two cells of its center, which keeps the
+  // position far from overflowing once offset by the shape
+  int rotation = state.pieceRotation;
+  if (rotation < 0 or rotation >= kMaxRotations or state.pieceX < -2 or
+      state.pieceX > state.width + 2 or state.pieceY < -2 or
+      state.pieceY > state.height + 2)
+    return false;
+  const PieceShapes &shapes = GetPieceShapes(state.pieceType);
+  const ShapeMask &mask = shapes.masks[rotation % shapes.rotations];
+  if (!state.gameOver)
+    return ShapeFits(mask, state.pieceX, state.pieceY, rows, state.width,
+                     state.height);
+  int left = state.pieceX + mask.left;
+  int top = state.pieceY + mask.top;
+  return left >= 0 and left + mask.width <= state.width and
+         top + mask.height <= state.height;
+}
+
+// returns the state if it can be restored, throws otherwise
+template <typename State> const State &CheckRestorable(const State &state) {
+  if (!Simulation::CanRestore(state))
+    throw std::invalid_argument("Simulation state has an unsupported grid "
+                                "size or piece, or a piece outside the grid");
+  return state;
+}
+
+} // namespace
+
+Simulation::Simulation(const Snapshot &snapshot)
+    : _gridWidth(CheckRestorable(snapshot).width), _gridHeight(snapshot.height),
+      _seed(snapshot.seed),
+      _generator(Pcg32::FromState(snapshot.rngState, snapshot.rngIncrement),
+                 snapshot.preview),
+      _field(std::make_unique<Field>(_gridWidth, _gridHeight)),
+      _piece(snapshot.pieceType, _gridWidth, _gridHeight),
+      _tick(snapshot.tick), _pieceCount(snapshot.pieceCount),
+      _pieceTicks(snapshot.pieceTicks),
+      _descendSpeed(snapshot.descendSpeed),
+      _descendProgress(snapshot.descendProgress),
+      _gameOver(snapshot.gameOver), _score(snapshot.score),
+      _rowsCleared(snapshot.rowsCleared), _level(snapshot.level) {
+  _field->SetRows(snapshot.rows.data());
+  _field->SetRowsCleared(snapshot.rowsCleared);
+  _piece.SetField(_field.get());
+  _piece.MoveTo(snapshot.pieceX, snapshot.pieceY, snapshot.pieceRotation);
+}
+
+void Simulation::GetSnapshot(Snapshot &snapshot) const {
+  snapshot.width = _gridWidth;
+  snapshot.height = _gridHeight;
+  snapshot.seed = _seed;
+  snapshot.rows.assign(_field->GetRows(), _field->GetRows() + _gridHeight);
+  snapshot.pieceType = _piece.GetType();
+  snapshot.pieceRotation = _piece.GetRotation();
+  snapshot.pieceX = _piece.GetCenterCellX();
+  snapshot.pieceY = _piece.GetCenterCellY();
+  snapshot.rngState = _generator.GetEngine().GetState();
+  snapshot.rngIncrement = _generator.GetEngine().GetIncrement();
+  for (int i = 0; i < PieceGenerator::kPreviewSize; i++)
+    snapshot.preview[i] = _generator.GetPreview(i);
+  snapshot.tick = _tick;
+  snapshot.pieceCount = _pieceCount;
+  snapshot.pieceTicks = _pieceTicks;
+  snapshot.descendSpeed = _descendSpeed;
+  snapshot.descendProgress = _descendProgress;
+  snapshot.gameOver = _gameOver;
+  snapshot.score = _score;
+  snapshot.rowsCleared = _rowsCleared;
+  snapshot.level = _level;
+}
+
+
+Simulation::Simulation(const GameState &state)
+    : _gridWidth(CheckRestorable(state).width), _gridHeight(state.height),
+      _seed(state.seed),
+      _generator(Pcg32::FromState(state.rngState, state.rngIncrement),
+                 state.preview),
+      _field(std::make_unique<Field>(_gridWidth, _gridHeight)),
+      _piece(state.pieceType, _gridWidth, _gridHeight) {
+  Restore(state);
+}
+
+bool Simulation::Save(GameState &state) const {
+  if (_gridHeight > GameState::kMaxHeight)
+    return false;
+  state.rngState = _generator.GetEngine().GetState();
+  state.rngIncrement = _generator.GetEngine().GetIncrement();
+  state.tick = _tick;
+  state.pieceCount = _pieceCount;
+  state.seed = _seed;
+  state.score = _score;
+  state.rowsCleared = _rowsCleared;
+  state.pieceTicks = _pieceTicks;
+  state.descendSpeed = _descendSpeed;
+  state.descendProgress = _descendProgress;
+  state.pieceX = static_cast<std::int16_t>(_piece.GetCenterCellX());
+  state.pieceY = static_cast<std::int16_t>(_piece.GetCenterCellY());
+  state.width = static_cast<std::uint8_t>(_gridWidth);
+  state.height = static_cast<std::uint8_t>(_gridHeight);
+  state.level = static_cast<std::uint8_t>(_level);
+  state.gameOver = _gameOver;
+  state.pieceType = _piece.GetType();
+  state.pieceRotation = static_cast<std::uint8_t>(_piece.GetRotation());
+  for (int i = 0; i < PieceGenerator::kPreviewSize; i++)
+    state.preview[i] = _generator.GetPreview(i);
+  state.reserved = 0;
+  const Field::Row *rows = _field->GetRows();
+  for (int y = 0; y < GameState::kMaxHeight; y++)
+    state.rows[y] = y < _gridHeight ? rows[y] : 0;
+  return true;
+}
+
+bool Simulation::CanRestore(const GameState &state) {
+  return state.width >= Field::kMinWidth and
+         state.width <= Field::kMaxWidth and state.height >= 1 and
+         state.height <= GameState::kMaxHeight and
+         HasValidPieces(state, state.rows);
+}
+
+bool Simulation::CanRestore(const Snapshot &snapshot) {
+  return snapshot.width >= Field::kMinWidth and
+         snapshot.width <= Field::kMaxWidth and snapshot.height >= 1 and
+         snapshot.height <= Field::kMaxHeight and
+         snapshot.rows.size() == static_cast<std::size_t>(snapshot.height) and
+         HasValidPieces(snapshot, snapshot.rows.data());
+}
+void Simulation::Restore(const GameState &state) {
+  CheckRestorable(state);
+  if (state.width != _gridWidth or state.height != _gridHeight) {
+    _gridWidth = state.width;
+    _gridHeight = state.height;
+    _field = std::make_unique<Field>(_gridWidth, _gridHeight);
+  }
+  _field->SetRows(state.rows);
+  _field->SetRowsCleared(state.rowsCleared);
+  _seed = state.seed;
+  _generator = PieceGenerator(
+      Pcg32::FromState(state.rngState, state.rngIncrement), state.preview);
+  _piece = Piece(state.pieceType, _gridWidth, _gridHeight);
+  _piece.SetField(_field.get());
+  _piece.MoveTo(state.pieceX, state.pieceY, state.pieceRotation);
+  _tick = state.tick;
+  _pieceCount = state.pieceCount;
+  _pieceTicks = state.pieceTicks;
+  _descendSpeed = state.descendSpeed;
+  _descendProgress = state.descendProgress;
+  _gameOver = state.gameOver != 0;
+  _score = state.score;
+  _rowsCleared = state.rowsCleared;
+  _level = state.level;
+}
+
+// applies the input to the current piece, then lets gravity act on it for one
+// tick. A landed piece is added to the field and replaced by a new one on the
+// same tick
+Events Simulation::Step(const Input &input) {
+  Events events;
+  if (_gameOver) {
+    events.gameOver = true;
+    return events;
+  }
+  _tick++;
+
+  if (input.Has(Action::kMoveLeft))
+    _piece.Move(Direction::kLeft);
+  if (input.Has(Action::kMoveRight))
+    _piece.Move(Direction::kRight);
+  if (input.Has(Action::kRotate))
+    _piece.Rotate(Rotation::kForward);
+  if (input.Has(Action::kDrop))
+    _piece.Drop();
+
+  // a piece spawned on top of the field lands without descending
+  bool landed =
+      !_piece.IsFree() or (_pieceTicks++ == 0 and _piece.IsLanded());
+
+  // gravity is kept as an exact fraction of a cell, the piece descends one cell
+  // every time a whole cell has accumulated
+  _descendProgress += _descendSpeed;
+  while (!landed and _descendProgress >= kTicksPerSecond) {
+    _descendProgress -= kTicksPerSecond;
+    landed = _piece.Descend();
+  }
+  if (landed)
+    LockPiece(events);
+  return events;
+}
+
+// adds the current piece to the field, updates the score and spawns the next
+// piece
+void Simulation::LockPiece(Events &events) {
+  int rowsCleared = _field->GetRowsCleared();
+  _field->AddPiece(_piece);
+  events.pieceLocked = true;
+  events.rowsCleared = _field->GetRowsCleared() - rowsCleared;
+  // updates score when a new piece is generated, and uses the score to
+  // determine next piece's speed
+  UpdateScore();
+  SpawnPiece(events);
+}
+
+// generates a new piece at the top, the game ends if it cannot be placed
+void Simulation::SpawnPiece(Events &events) {
+  _piece = _generator.GeneratePiece(_gridWidth, _gridHeight, _field.get());
+  _pieceCount++;
+  _pieceTicks = 0;
+  _descendSpeed = ComputePieceDescendSpeed();
+  _descendProgress = 0;
+  events.pieceSpawned = true;
+  if (_piece.IsPlaceble()) {
+    LOG_INFO("{} cannot be created. Game Over.", _piece.GetName());
+    _gameOver = true;
+    events.gameOver = true;
+  }
+}
+
+// Adds the square of the additional rows cleared to the total score, and
+// updates current level
+void Simulation::UpdateScore() {
+  int cleared = _field->GetRowsCleared() - _rowsCleared;
+  _rowsCleared = _field->GetRowsCleared();
+  _score += cleared * cleared;
+  _level = std::min(_maxLevel, 1 + static_cast<int>(_score / _scorePerLevel));
+};
+
+// Increases descending speed linearly at each level until reaching max level.
+int Simulation::ComputePieceDescendSpeed() {
+  return _baseDescendSpeed * _level;
+}
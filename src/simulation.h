@@ -0,0 +1,141 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "field.h"
+#include "game_state.h"
+#include "piece.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// actions a player can apply to the current piece within one tick
+enum class Action : std::uint8_t {
+  kNone = 0,
+  kMoveLeft = 1 << 0,
+  kMoveRight = 1 << 1,
+  kRotate = 1 << 2,
+  kDrop = 1 << 3
+};
+
+// set of actions applied in one tick
+struct Input {
+  std::uint8_t actions{0};
+
+  void Add(Action a) { actions |= static_cast<std::uint8_t>(a); };
+  bool Has(Action a) const {
+    return actions & static_cast<std::uint8_t>(a);
+  };
+};
+
+// what happened during one tick
+struct Events {
+  bool pieceLocked{false};  // the current piece was added to the field
+  bool pieceSpawned{false}; // a new piece was generated
+  bool gameOver{false};     // the new piece could not be placed
+  int rowsCleared{0};       // rows cleared by the locked piece
+};
+
+// headless Tetris rules advanced by a fixed tick, independent of SDL, threads
+// and wall-clock time
+class Simulation {
+public:
+  static constexpr int kTickMs{1}; // duration of one tick
+  static constexpr int kTicksPerSecond{1000 / kTickMs};
+
+  // throw std::invalid_argument if the grid is narrower than
+  // Field::kMinWidth or otherwise not a valid Field size
+  Simulation(int gridWidth, int gridHeight);
+  Simulation(int gridWidth, int gridHeight, std::uint32_t seed);
+
+  // complete state between two ticks, restoring it continues the game exactly
+  // as the original would have
+  struct Snapshot {
+    int width{0};
+    int height{0};
+    std::uint32_t seed{0};
+    std::vector<Field::Row> rows;
+    PieceType pieceType{PieceType::kLong};
+    int pieceRotation{0};
+    int pieceX{0};
+    int pieceY{0};
+    std::uint64_t rngState{0};
+    std::uint64_t rngIncrement{0};
+    std::array<PieceType, PieceGenerator::kPreviewSize> preview{};
+    std::uint64_t tick{0};
+    std::uint64_t pieceCount{0};
+    int pieceTicks{0};
+    int descendSpeed{0};
+    int descendProgress{0};
+    bool gameOver{false};
+    int score{0};
+    int rowsCleared{0};
+    int level{1};
+  };
+  // throws std::invalid_argument if CanRestore rejects the snapshot
+  explicit Simulation(const Snapshot &snapshot);
+  // fills the snapshot, reusing its storage
+  void GetSnapshot(Snapshot &snapshot) const;
+
+  // same as a snapshot, but flat and fixed size. Save returns false, leaving
+  // the state untouched, if the field is taller than GameState::kMaxHeight.
+  // Restore reuses the field if the state has the same size, so neither
+  // allocates on the way. Restoring a state CanRestore rejects throws
+  // std::invalid_argument and leaves the simulation unchanged
+  explicit Simulation(const GameState &state);
+  bool Save(GameState &state) const;
+  void Restore(const GameState &state);
+  // returns true if the state has a supported grid size and valid pieces,
+  // and its piece lies inside the grid without overlapping the stack unless
+  // the game is over
+  static bool CanRestore(const GameState &state);
+  static bool CanRestore(const Snapshot &snapshot);
+
+  // advances the game by one tick after applying the input
+  Events Step(const Input &input);
+
+  // getters
+  const Field &GetField() const { return *_field; };
+  const Piece &GetPiece() const { return _piece; };
+  int GetScore() const { return _score; };
+  int GetLevel() const { return _level; };
+  int GetRowsCleared() const { return _rowsCleared; };
+  bool IsGameOver() const { return _gameOver; };
+  std::uint64_t GetPieceCount() const { return _pieceCount; };
+  PieceType GetPreview(int i) const { return _generator.GetPreview(i); };
+  std::uint64_t GetTick() const { return _tick; };
+  std::uint32_t GetSeed() const { return _seed; };
+
+private:
+  // private behavior methods
+  void SpawnPiece(Events &events);
+  void LockPiece(Events &events);
+  void UpdateScore();
+  int ComputePieceDescendSpeed();
+
+  int _gridWidth;
+  int _gridHeight;
+  std::uint32_t _seed; // seed of the piece generator, replays the game
+  PieceGenerator _generator;
+  // the field is allocated once per game so its address, which the piece
+  // keeps, survives moving the simulation. The current piece is a value
+  // replaced in place on every spawn, without any allocation
+  std::unique_ptr<Field> _field;
+  Piece _piece;
+  std::uint64_t _tick{0};        // number of ticks simulated so far
+  std::uint64_t _pieceCount{0};  // number of pieces spawned so far
+  int _pieceTicks{0};            // ticks since the current piece spawned
+  int _descendSpeed{0};          // current piece's speed, cells per second
+  int _descendProgress{0}; // fraction of a cell descended since the last
+                           // cell, in 1 / kTicksPerSecond cells
+  bool _gameOver{false};
+
+  int _score{0};
+  int _rowsCleared{0}; // number of rows cleared
+  int _scorePerLevel{10};
+  int _maxLevel{5};
+  int _level{1};                // current level of the game
+  int _baseDescendSpeed{1}; // default descending speed, 1 cell per second
+};
+
+#endif
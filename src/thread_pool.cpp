@@ -0,0 +1,142 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace {
+// the pool and queue of the worker running on this thread
+thread_local ThreadPool *currentPool{nullptr};
+thread_local int currentIndex{-1};
+} // namespace
+
+ThreadPool::ThreadPool(int threads) {
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 0; i < threads; i++)
+    _queues.push_back(std::make_unique<Queue>());
+  for (int i = 0; i < threads; i++)
+    _workers.emplace_back(&ThreadPool::Work, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lck(_mutex);
+    _stopping = true;
+  }
+  _condition.notify_all();
+  for (std::thread &t : _workers)
+    t.join();
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+  int index = currentPool == this
+                  ? currentIndex
+                  : static_cast<int>(_nextQueue++ % _queues.size());
+  _unfinished++;
+  {
+    std::lock_guard<std::mutex> lck(_queues[index]->mutex);
+    _queues[index]->tasks.emplace_back(std::move(task));
+  }
+  _queued++;
+  // taking the lock orders the notification after a worker's last check
+  std::lock_guard<std::mutex> lck(_mutex);
+  _condition.notify_one();
+}
+
+void ThreadPool::Wait() {
+  std::unique_lock<std::mutex> lck(_mutex);
+  _idle.wait(lck, [this] { return _unfinished.load() == 0; });
+}
+
+// takes the newest task of the own queue or else the oldest of another one
+bool ThreadPool::TryPop(int index, std::function<void()> &task) {
+  int n = static_cast<int>(_queues.size());
+  for (int k = 0; k < n; k++) {
+    Queue &q = *_queues[(index + k) % n];
+    std::lock_guard<std::mutex> lck(q.mutex);
+    if (q.tasks.empty())
+      continue;
+    if (k == 0) {
+      task = std::move(q.tasks.back());
+      q.tasks.pop_back();
+    } else {
+      task = std::move(q.tasks.front());
+      q.tasks.pop_front();
+    }
+    _queued--;
+    return true;
+  }
+  return false;
+}
+
+// runs tasks until the pool is destroyed and no task is left, and joins every
+// loop opened while it waits
+void ThreadPool::Work(int index) {
+  currentPool = this;
+  currentIndex = index;
+  std::function<void()> task;
+  unsigned joined{0}; // generation of the last loop joined
+  while (true) {
+    if (TryPop(index, task)) {
+      task();
+      task = nullptr;
+      if (--_unfinished == 0) {
+        std::lock_guard<std::mutex> lck(_mutex);
+        _idle.notify_all();
+      }
+      continue;
+    }
+    std::unique_lock<std::mutex> lck(_mutex);
+    _condition.wait(lck, [&] {
+      return _stopping or _queued.load() > 0 or
+             (_loopOpen and _loopGeneration != joined);
+    });
+    if (_loopOpen and _loopGeneration != joined) {
+      joined = _loopGeneration;
+      _loopWorkers++;
+      lck.unlock();
+      RunLoop();
+      lck.lock();
+      if (--_loopWorkers == 0)
+        _idle.notify_all();
+      continue;
+    }
+    if (_stopping and _queued.load() == 0)
+      return;
+  }
+}
+
+// indices are handed out through an atomic counter, so fast threads take more
+// of them. The calling thread works through the indices too, so the loop ends
+// even if no worker is idle. Once the caller runs out of indices it closes the
+// loop to further workers and waits for the ones inside, after which _loop is
+// free for the next call
+void ThreadPool::RunParallel(int n, void *fn, void (*call)(void *fn, int i)) {
+  if (n <= 1 or _loopBusy.exchange(true)) {
+    for (int i = 0; i < n; i++)
+      call(fn, i);
+    return;
+  }
+  _loop.n = n;
+  _loop.fn = fn;
+  _loop.call = call;
+  _loop.next.store(0);
+  {
+    std::lock_guard<std::mutex> lck(_mutex);
+    _loopOpen = true;
+    _loopGeneration++;
+  }
+  _condition.notify_all();
+  RunLoop();
+  {
+    std::unique_lock<std::mutex> lck(_mutex);
+    _loopOpen = false;
+    _idle.wait(lck, [this] { return _loopWorkers == 0; });
+  }
+  _loopBusy.store(false);
+}
+
+// calls the loop's function for the indices left
+void ThreadPool::RunLoop() {
+  int i;
+  while ((i = _loop.next.fetch_add(1)) < _loop.n)
+    _loop.call(_loop.fn, i);
+}
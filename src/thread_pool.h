@@ -0,0 +1,83 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// fixed set of worker threads running submitted tasks. Every worker has its
+// own queue: it takes its newest task first and, when its queue is empty,
+// steals the oldest task of another worker, so uneven tasks still keep all
+// workers busy
+class ThreadPool {
+public:
+  // 0 threads uses one per hardware core
+  explicit ThreadPool(int threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  int GetThreads() const { return static_cast<int>(_workers.size()); };
+
+  // queues a task, on the own queue when called from a worker and spread over
+  // the workers otherwise
+  void Submit(std::function<void()> task);
+
+  // blocks until every submitted task has finished
+  void Wait();
+
+  // runs fn(i) for every i in [0, n) on the calling thread and the idle
+  // workers, returns once all calls are done. It does not allocate. Only one
+  // loop runs on the workers at a time, a loop started meanwhile, such as a
+  // nested one, runs on its calling thread alone
+  template <typename Fn> void ParallelFor(int n, Fn &&fn) {
+    using F = std::remove_reference_t<Fn>;
+    RunParallel(n, const_cast<void *>(static_cast<const void *>(&fn)),
+                [](void *f, int i) { (*static_cast<F *>(f))(i); });
+  };
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  // the loop of the running ParallelFor, fn type-erased so it is not copied
+  struct Loop {
+    int n{0};
+    void *fn{nullptr};
+    void (*call)(void *fn, int i){nullptr};
+    std::atomic<int> next{0}; // next index to run
+  };
+
+  void Work(int index);
+  bool TryPop(int index, std::function<void()> &task);
+  void RunParallel(int n, void *fn, void (*call)(void *fn, int i));
+  void RunLoop();
+
+  std::vector<std::unique_ptr<Queue>> _queues; // one per worker
+  std::vector<std::thread> _workers;
+  std::atomic<int> _queued{0};     // tasks waiting in any queue
+  std::atomic<int> _unfinished{0}; // tasks submitted and not yet finished
+  std::atomic<unsigned> _nextQueue{0};
+  std::mutex _mutex; // guards the sleeping of workers and waiters
+  std::condition_variable _condition;
+  std::condition_variable _idle;
+  bool _stopping{false};
+  Loop _loop;
+  std::atomic<bool> _loopBusy{false}; // a ParallelFor owns _loop
+  // guarded by _mutex: workers may join _loop while it is open, each loop
+  // once, and the loop waits for the workers inside it before returning
+  bool _loopOpen{false};
+  unsigned _loopGeneration{0};
+  int _loopWorkers{0};
+};
+
+#endif
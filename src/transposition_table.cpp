@@ -0,0 +1,86 @@
+#include "transposition_table.h"
+#include "random.h"
+#include <cstring>
+
+TranspositionTable::TranspositionTable(std::size_t entries) {
+  std::size_t size = kWays;
+  while (size < entries)
+    size *= 2;
+  _slots = std::vector<Slot>(size);
+  _bucketMask = size / kWays - 1;
+}
+
+std::uint64_t TranspositionTable::Key(std::uint64_t fieldHash, int width,
+                                      int height, PieceType type,
+                                      int rotation, int x, int startY) {
+  // fields are at most 64 columns wide and a piece starts at most a few cells
+  // outside of them, so every value but the height fits a byte
+  std::uint64_t placement = static_cast<std::uint64_t>(type) |
+                            static_cast<std::uint64_t>(rotation & 0xff) << 8 |
+                            static_cast<std::uint64_t>(x & 0xff) << 16 |
+                            static_cast<std::uint64_t>(startY & 0xff) << 24 |
+                            static_cast<std::uint64_t>(width) << 32 |
+                            static_cast<std::uint64_t>(height) << 40;
+  return SplitMix64(fieldHash ^ SplitMix64(placement));
+}
+
+// meta holds the generation in bits 0-7, the rows cleared in bits 8-15, the
+// landing row in bits 16-31 and kUsed
+std::uint64_t TranspositionTable::Pack(const Entry &entry,
+                                       std::uint8_t generation) {
+  return kUsed | generation |
+         static_cast<std::uint64_t>(entry.lines & 0xff) << 8 |
+         static_cast<std::uint64_t>(static_cast<std::uint16_t>(entry.y))
+             << 16;
+}
+
+// reads a slot, returns false unless it holds the key
+bool TranspositionTable::Read(const Slot &slot, std::uint64_t key,
+                              std::uint64_t &score,
+                              std::uint64_t &meta) const {
+  std::uint64_t check = slot.check.load(std::memory_order_relaxed);
+  score = slot.score.load(std::memory_order_relaxed);
+  meta = slot.meta.load(std::memory_order_relaxed);
+  return (meta & kUsed) and (check ^ score ^ meta) == key;
+}
+
+bool TranspositionTable::Probe(std::uint64_t key, Entry &entry) const {
+  const Slot *bucket = &_slots[(key & _bucketMask) * kWays];
+  std::uint64_t score;
+  std::uint64_t meta;
+  for (int i = 0; i < kWays; i++) {
+    if (!Read(bucket[i], key, score, meta))
+      continue;
+    std::memcpy(&entry.score, &score, sizeof(score));
+    entry.lines = static_cast<int>(meta >> 8 & 0xff);
+    entry.y = static_cast<std::int16_t>(meta >> 16);
+    return true;
+  }
+  return false;
+}
+
+void TranspositionTable::Store(std::uint64_t key, const Entry &entry) {
+  Slot *bucket = &_slots[(key & _bucketMask) * kWays];
+  int victim = 0;
+  int oldest = -1;
+  for (int i = 0; i < kWays; i++) {
+    std::uint64_t score;
+    std::uint64_t meta;
+    if (Read(bucket[i], key, score, meta) or !(meta & kUsed)) {
+      victim = i;
+      break;
+    }
+    int age = static_cast<std::uint8_t>(_generation - (meta & 0xff));
+    if (age > oldest) {
+      oldest = age;
+      victim = i;
+    }
+  }
+  std::uint64_t score;
+  std::memcpy(&score, &entry.score, sizeof(score));
+  std::uint64_t meta = Pack(entry, _generation);
+  Slot &slot = bucket[victim];
+  slot.score.store(score, std::memory_order_relaxed);
+  slot.meta.store(meta, std::memory_order_relaxed);
+  slot.check.store(key ^ score ^ meta, std::memory_order_relaxed);
+}
@@ -0,0 +1,73 @@
+#ifndef TRANSPOSITION_TABLE_H
+#define TRANSPOSITION_TABLE_H
+
+#include "field.h"
+#include "shape.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// bounded cache of evaluated placements, shared by the search threads without
+// locks. A placement is keyed by the hash and size of the field it is made
+// on, the piece type, its rotation and column and the row the piece starts
+// from, which together determine the board it leads to.
+//
+// The table is split into buckets of kWays slots. A slot is three words: the
+// score, the other values and their XOR with the key. A reader only accepts a
+// slot whose words XOR to the key it looks for, so a slot torn by concurrent
+// writers is a miss rather than a wrong value. A new entry takes the slot of
+// its key, an empty one or the one stored the most searches ago
+class TranspositionTable {
+public:
+  static constexpr int kWays{4};
+
+  struct Entry {
+    double score{0}; // score of the board, without the rows cleared
+    int y{0};        // row the piece lands on
+    int lines{0};    // rows the placement clears
+  };
+
+  // the number of entries is rounded up to a power of two, at least kWays
+  explicit TranspositionTable(std::size_t entries);
+
+  TranspositionTable(const TranspositionTable &) = delete;
+  TranspositionTable &operator=(const TranspositionTable &) = delete;
+
+  template <int Width, int Height>
+  static std::uint64_t Key(const BasicField<Width, Height> &field,
+                           PieceType type, int rotation, int x, int startY) {
+    return Key(field.GetHash(), field.GetWidth(), field.GetHeight(), type,
+               rotation, x, startY);
+  };
+  static std::uint64_t Key(std::uint64_t fieldHash, int width, int height,
+                           PieceType type, int rotation, int x, int startY);
+
+  // returns true and the entry if the key is stored
+  bool Probe(std::uint64_t key, Entry &entry) const;
+  void Store(std::uint64_t key, const Entry &entry);
+
+  // starts a new search, the entries of older searches are replaced first
+  void NewGeneration() { _generation++; };
+
+  std::size_t GetCapacity() const { return _slots.size(); };
+
+private:
+  struct Slot {
+    std::atomic<std::uint64_t> check{0}; // key ^ score ^ meta
+    std::atomic<std::uint64_t> score{0}; // bits of the double
+    std::atomic<std::uint64_t> meta{0};  // see Pack
+  };
+
+  static constexpr std::uint64_t kUsed{std::uint64_t{1} << 32};
+
+  static std::uint64_t Pack(const Entry &entry, std::uint8_t generation);
+  bool Read(const Slot &slot, std::uint64_t key, std::uint64_t &score,
+            std::uint64_t &meta) const;
+
+  std::vector<Slot> _slots;
+  std::size_t _bucketMask; // buckets - 1
+  std::uint8_t _generation{0};
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// lock-free hand-off of the latest value from one producer thread to one
+// consumer thread. The producer fills its back slot and publishes it by
+// swapping it with the middle slot, the consumer swaps the middle slot with
+// its front slot whenever a new value was published. Neither side ever waits,
+// values the consumer is too slow to see are simply replaced
+template <typename T> class TripleBuffer {
+public:
+  TripleBuffer() = default;
+  // every slot starts as a copy of the input value, e.g. to preallocate them
+  explicit TripleBuffer(const T &value) : _slots{{value, value, value}} {}
+
+  // producer side: the slot to fill next, it holds some older value that must
+  // be overwritten completely
+  T &GetBack() { return _slots[_back]; }
+
+  // producer side: makes the back slot the latest value
+  void Publish() {
+    _back = _middle.exchange(_back | kFresh, std::memory_order_acq_rel) &
+            kIndexMask;
+  }
+
+  // consumer side: takes the latest published value if there is one newer
+  // than the front slot, returns false if nothing was published since
+  bool Update() {
+    if (!(_middle.load(std::memory_order_relaxed) & kFresh))
+      return false;
+    _front =
+        _middle.exchange(_front, std::memory_order_acq_rel) & kIndexMask;
+    return true;
+  }
+
+  // consumer side: the value taken by the last Update, stays unchanged until
+  // the next one
+  const T &GetFront() const { return _slots[_front]; }
+
+private:
+  static constexpr std::uint8_t kIndexMask{0x3};
+  static constexpr std::uint8_t kFresh{0x4}; // middle slot not yet consumed
+
+  std::array<T, 3> _slots;
+  // the producer and the consumer each own one slot, the middle one is
+  // exchanged between them
+  alignas(64) int _back{0};
+  alignas(64) std::atomic<std::uint8_t> _middle{1};
+  alignas(64) int _front{2};
+};
+
+#endif
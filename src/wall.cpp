@@ -0,0 +1,131 @@
+#include "wall.h"
+#include "SDL.h"
+#include <chrono>
+#include <thread>
+
+namespace {
+// the bots search on the pool's threads, one game each, and keep small caches
+// as a wall may hold hundreds of them
+AutoPlayer::Config BotConfig() {
+  AutoPlayer::Config config;
+  config.threads = 1;
+  config.cacheEntries = 1 << 12;
+  return config;
+}
+} // namespace
+
+Wall::Board::Board(int gridWidth, int gridHeight, std::uint32_t seed)
+    : simulation(gridWidth, gridHeight, seed), player(BotConfig()) {}
+
+Wall::Wall(int boards, int gridWidth, int gridHeight, std::uint32_t seed)
+    : _gridWidth(gridWidth), _gridHeight(gridHeight), _seed(seed),
+      _scheduler(std::chrono::milliseconds(Simulation::kTickMs),
+                 kMaxTicksPerUpdate),
+      _frames(std::vector<FrameSnapshot>(
+          boards, FrameSnapshot(gridWidth, gridHeight))) {
+  for (int i = 0; i < boards; i++)
+    _boards.push_back(std::make_unique<Board>(gridWidth, gridHeight, seed + i));
+}
+
+void Wall::Run(Controller const &controller, WallRenderer &renderer,
+               FramePacer &pacer) {
+  Uint32 title_timestamp = SDL_GetTicks();
+  int frame_count = 0;
+  bool running = true;
+  bool overlay = false;
+  std::vector<KeyEvent> keys;
+
+  _running = true;
+  std::thread simulation(&Wall::Simulate, this);
+  pacer.Start();
+
+  while (running) {
+    _profiler.BeginFrame();
+    keys.clear();
+    controller.HandleInput(running, overlay, keys);
+    _profiler.EndPhase(FramePhase::kInput);
+
+    _frames.Update();
+    const std::vector<FrameSnapshot> &frames = _frames.GetFront();
+    _profiler.EndPhase(FramePhase::kUpdate);
+
+    renderer.Render(frames);
+    _profiler.EndPhase(FramePhase::kRender);
+    renderer.Present();
+    _profiler.EndPhase(FramePhase::kPresent);
+
+    frame_count++;
+    Uint32 frame_end = SDL_GetTicks();
+    if (frame_end - title_timestamp >= 1000) {
+      renderer.UpdateWindowTitle(frame_count);
+      frame_count = 0;
+      title_timestamp = frame_end;
+    }
+
+    pacer.Wait([&] {
+      keys.clear();
+      controller.HandleInput(running, overlay, keys);
+    });
+    _profiler.EndPhase(FramePhase::kSleep);
+    _profiler.EndFrame();
+  }
+
+  _running = false;
+  simulation.join();
+}
+
+// runs on the simulation thread: advances every game by the ticks that are
+// due, then publishes the snapshots of all games at once
+void Wall::Simulate() {
+  _scheduler.Start();
+  while (_running.load(std::memory_order_relaxed)) {
+    int ticks = _scheduler.Update();
+    if (ticks > 0) {
+      std::vector<FrameSnapshot> &frames = _frames.GetBack();
+      _pool.ParallelFor(static_cast<int>(_boards.size()), [&](int i) {
+        Advance(*_boards[i], i, ticks);
+        frames[i].Capture(_boards[i]->simulation);
+      });
+      _frames.Publish();
+    }
+    std::this_thread::sleep_until(_scheduler.GetNextTick());
+  }
+}
+
+// the bot plans each piece as soon as it appears, its inputs are applied one
+// every kInputIntervalTicks while gravity keeps pulling the piece down
+void Wall::Advance(Board &board, int index, int ticks) {
+  for (int t = 0; t < ticks; t++) {
+    if (board.simulation.IsGameOver()) {
+      board.games++;
+      board.pieces += board.simulation.GetPieceCount();
+      // every board plays its own series of seeds
+      auto seed = static_cast<std::uint32_t>(
+          _seed + index + board.games * _boards.size());
+      board.simulation = Simulation(_gridWidth, _gridHeight, seed);
+      board.inputs.clear();
+    }
+    board.player.HandleInput(board.simulation, board.inputs);
+    Input input;
+    if (++board.wait >= kInputIntervalTicks and !board.inputs.empty()) {
+      input = board.inputs.front();
+      board.inputs.erase(board.inputs.begin());
+      board.wait = 0;
+    }
+    board.simulation.Step(input);
+  }
+}
+
+std::uint64_t Wall::GetGamesPlayed() const {
+  std::uint64_t games = 0;
+  for (const auto &board : _boards)
+    games += board->games;
+  return games;
+}
+
+std::uint64_t Wall::GetPiecesPlayed() const {
+  std::uint64_t pieces = 0;
+  for (const auto &board : _boards)
+    pieces += board->pieces + board->simulation.GetPieceCount();
+  return pieces;
+}
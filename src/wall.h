@@ -0,0 +1,66 @@
+#ifndef WALL_H
+#define WALL_H
+
+#include "autoplayer.h"
+#include "controller.h"
+#include "frame_pacer.h"
+#include "frame_profiler.h"
+#include "frame_snapshot.h"
+#include "scheduler.h"
+#include "simulation.h"
+#include "thread_pool.h"
+#include "triple_buffer.h"
+#include "wall_renderer.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// spectator mode: many autoplayer games run side by side and are shown
+// together in one window. The games are advanced by fixed ticks on a
+// simulation thread, spread over a thread pool, and published to the render
+// loop as one set of snapshots through a TripleBuffer, like Game does for a
+// single game. A game that ends is restarted with the next seed
+class Wall {
+public:
+  Wall(int boards, int gridWidth, int gridHeight, std::uint32_t seed);
+
+  // runs the games until the window is closed
+  void Run(Controller const &controller, WallRenderer &renderer,
+           FramePacer &pacer);
+
+  // the games are only read while Run is not running
+  std::uint64_t GetGamesPlayed() const;
+  std::uint64_t GetPiecesPlayed() const;
+  const FrameProfiler &GetFrameProfiler() const { return _profiler; };
+
+private:
+  static constexpr int kMaxTicksPerUpdate{250}; // catch up at most 250 ms
+  // the bots give one input every 40 ms so their games can be followed
+  static constexpr int kInputIntervalTicks{40 / Simulation::kTickMs};
+
+  struct Board {
+    Board(int gridWidth, int gridHeight, std::uint32_t seed);
+    Simulation simulation;
+    AutoPlayer player;
+    std::vector<Input> inputs; // planned inputs not yet applied
+    int wait{0};               // ticks since the last input
+    std::uint64_t games{0};    // games finished
+    std::uint64_t pieces{0};   // pieces of the finished games
+  };
+
+  void Simulate();
+  void Advance(Board &board, int index, int ticks);
+
+  int _gridWidth;
+  int _gridHeight;
+  std::uint32_t _seed; // seed of the first game of the first board
+  std::vector<std::unique_ptr<Board>> _boards;
+  ThreadPool _pool;
+  Scheduler _scheduler;
+  TripleBuffer<std::vector<FrameSnapshot>> _frames;
+  std::atomic<bool> _running{false};
+  FrameProfiler _profiler;
+};
+
+#endif
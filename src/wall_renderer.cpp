@@ -0,0 +1,173 @@
+#include "wall_renderer.h"
+#include "shape.h"
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+namespace {
+constexpr int kTileSize{16}; // pixels of one atlas tile
+const SDL_Color kBackground{0x1E, 0x1E, 0x1E, 0xFF};
+const SDL_Color kSettled{0xC8, 0xC8, 0xC8, 0xFF};
+} // namespace
+
+WallRenderer::WallRenderer(int screenWidth, int screenHeight, int boards,
+                           int gridWidth, int gridHeight, bool vsync,
+                           bool software)
+    : _boards(boards), _gridWidth(gridWidth), _gridHeight(gridHeight) {
+  if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+    std::cerr << "SDL could not initialize.\n";
+    std::cerr << "SDL_Error: " << SDL_GetError() << "\n";
+  }
+
+  _window = SDL_CreateWindow("Tetris Wall", SDL_WINDOWPOS_CENTERED,
+                             SDL_WINDOWPOS_CENTERED, screenWidth, screenHeight,
+                             SDL_WINDOW_SHOWN);
+  if (nullptr == _window) {
+    std::cerr << "Window could not be created.\n";
+    std::cerr << " SDL_Error: " << SDL_GetError() << "\n";
+  }
+
+  Uint32 flags = software ? SDL_RENDERER_SOFTWARE : SDL_RENDERER_ACCELERATED;
+  if (vsync)
+    flags |= SDL_RENDERER_PRESENTVSYNC;
+  _renderer = SDL_CreateRenderer(_window, -1, flags);
+  if (nullptr == _renderer) {
+    std::cerr << "Renderer could not be created.\n";
+    std::cerr << "SDL_Error: " << SDL_GetError() << "\n";
+  }
+  CreateAtlas();
+
+  // picks the number of boards per row giving the largest cells, every board
+  // is followed by a gap of one cell
+  for (int columns = 1; columns <= boards; columns++) {
+    int rows = (boards + columns - 1) / columns;
+    float cell = std::min<float>(
+        screenWidth / static_cast<float>(columns * (gridWidth + 1)),
+        screenHeight / static_cast<float>(rows * (gridHeight + 1)));
+    cell = std::max(1.0f, static_cast<float>(static_cast<int>(cell)));
+    if (columns == 1 or cell > _cell) {
+      _cell = cell;
+      _columns = columns;
+    }
+  }
+  int rows = (boards + _columns - 1) / _columns;
+  _originX = (screenWidth - _columns * (gridWidth + 1) * _cell + _cell) / 2;
+  _originY = (screenHeight - rows * (gridHeight + 1) * _cell + _cell) / 2;
+
+  // at most a background, every cell, the ghost and the piece per board
+  std::size_t quads =
+      static_cast<std::size_t>(boards) * (1 + gridWidth * gridHeight + 8);
+  _vertices.reserve(4 * quads);
+  _indices.reserve(6 * quads);
+  for (std::size_t q = 0; q < quads; q++) {
+    int v = static_cast<int>(4 * q);
+    for (int i : {v, v + 1, v + 2, v + 2, v + 3, v})
+      _indices.push_back(i);
+  }
+}
+
+WallRenderer::~WallRenderer() {
+  if (_atlas != nullptr)
+    SDL_DestroyTexture(_atlas);
+  SDL_DestroyRenderer(_renderer);
+  SDL_DestroyWindow(_window);
+  SDL_Quit();
+}
+
+// the block tile is white with a transparent one pixel border and a darker
+// inner rim, the plain tile is white; both are tinted by the vertex colors
+void WallRenderer::CreateAtlas() {
+  std::vector<std::uint32_t> pixels(2 * kTileSize * kTileSize);
+  for (int y = 0; y < kTileSize; y++) {
+    for (int x = 0; x < kTileSize; x++) {
+      bool border = x == 0 or y == 0 or x == kTileSize - 1 or
+                    y == kTileSize - 1;
+      bool rim = x == 1 or y == 1 or x == kTileSize - 2 or y == kTileSize - 2;
+      std::uint32_t block = border ? 0x00000000 : rim ? 0xFFB4B4B4 : 0xFFFFFFFF;
+      pixels[y * 2 * kTileSize + x] = block;
+      pixels[y * 2 * kTileSize + kTileSize + x] = 0xFFFFFFFF;
+    }
+  }
+  _atlas = SDL_CreateTexture(_renderer, SDL_PIXELFORMAT_ARGB8888,
+                             SDL_TEXTUREACCESS_STATIC, 2 * kTileSize,
+                             kTileSize);
+  if (nullptr == _atlas) {
+    std::cerr << "Atlas texture could not be created.\n";
+    std::cerr << "SDL_Error: " << SDL_GetError() << "\n";
+    return;
+  }
+  SDL_UpdateTexture(_atlas, nullptr, pixels.data(),
+                    2 * kTileSize * sizeof(std::uint32_t));
+  SDL_SetTextureBlendMode(_atlas, SDL_BLENDMODE_BLEND);
+}
+
+void WallRenderer::AddQuad(float x, float y, float width, float height,
+                           SDL_Color color, Tile tile) {
+  // the plain tile is sampled half a texel inside its edges, so filtering
+  // never reaches into the block tile next to it
+  constexpr float kHalfTexel{0.5f / (2 * kTileSize)};
+  float u0 = tile == Tile::kBlock ? 0.0f : 0.5f + kHalfTexel;
+  float u1 = tile == Tile::kBlock ? 0.5f : 1.0f - kHalfTexel;
+  _vertices.push_back(SDL_Vertex{{x, y}, color, {u0, 0.0f}});
+  _vertices.push_back(SDL_Vertex{{x + width, y}, color, {u1, 0.0f}});
+  _vertices.push_back(SDL_Vertex{{x + width, y + height}, color, {u1, 1.0f}});
+  _vertices.push_back(SDL_Vertex{{x, y + height}, color, {u0, 1.0f}});
+}
+
+// adds the background, the settled cells, the ghost and the piece of a board
+// with its top left corner at the input pixel
+void WallRenderer::AddBoard(const FrameSnapshot &frame, float x, float y) {
+  AddQuad(x, y, _gridWidth * _cell, _gridHeight * _cell, kBackground,
+          Tile::kPlain);
+  int height = std::min(frame.height, _gridHeight);
+  for (int r = 0; r < height; r++) {
+    // visits the occupied cells of the row, lowest bit first
+    for (Field::Row row = frame.rows[r]; row != 0; row &= row - 1) {
+      AddQuad(x + __builtin_ctzll(row) * _cell, y + r * _cell, _cell, _cell,
+              kSettled, Tile::kBlock);
+    }
+  }
+
+  const std::array<std::uint8_t, 4> &c = GetPieceShapes(frame.pieceType).color;
+  SDL_Color color{c[0], c[1], c[2], c[3]};
+  SDL_Color ghost{c[0], c[1], c[2], 0x50};
+  for (int pass = 0; pass < 2; pass++) {
+    int drop = pass == 0 ? frame.ghostDrop : 0;
+    if (pass == 0 and drop == 0)
+      continue;
+    for (const Cell &cell : frame.body) {
+      int cy = cell.y + drop;
+      if (cell.x < 0 or cell.x >= _gridWidth or cy < 0 or cy >= height)
+        continue;
+      AddQuad(x + cell.x * _cell, y + cy * _cell, _cell, _cell,
+              pass == 0 ? ghost : color, Tile::kBlock);
+    }
+  }
+}
+
+// rebuilds the vertices of every board and draws them with one call
+void WallRenderer::Render(const std::vector<FrameSnapshot> &frames) {
+  SDL_SetRenderDrawColor(_renderer, 0, 0, 0, 0xFF);
+  SDL_RenderClear(_renderer);
+
+  _vertices.clear();
+  int boards = std::min(static_cast<int>(frames.size()), _boards);
+  for (int i = 0; i < boards; i++) {
+    float x = _originX + (i % _columns) * (_gridWidth + 1) * _cell;
+    float y = _originY + (i / _columns) * (_gridHeight + 1) * _cell;
+    AddBoard(frames[i], x, y);
+  }
+  int quads = static_cast<int>(_vertices.size() / 4);
+  SDL_RenderGeometry(_renderer, _atlas, _vertices.data(),
+                     static_cast<int>(_vertices.size()), _indices.data(),
+                     6 * quads);
+}
+
+void WallRenderer::Present() { SDL_RenderPresent(_renderer); }
+
+void WallRenderer::UpdateWindowTitle(int fps) {
+  std::string title{"Tetris Wall: " + std::to_string(_boards) +
+                    " boards FPS: " + std::to_string(fps)};
+  SDL_SetWindowTitle(_window, title.c_str());
+}
@@ -0,0 +1,49 @@
+#ifndef WALL_RENDERER_H
+#define WALL_RENDERER_H
+
+#include "SDL.h"
+#include "frame_snapshot.h"
+#include <vector>
+
+// draws many boards side by side in one window. Every cell of every board is
+// a textured quad of one vertex batch, so the whole wall takes a single
+// SDL_RenderGeometry call however many boards it shows: the quads sample a
+// small atlas with a block tile (drawn with a border, so cells stay apart at
+// any size) and a plain tile for the board backgrounds, and are tinted by
+// their vertex colors
+class WallRenderer {
+public:
+  WallRenderer(int screenWidth, int screenHeight, int boards, int gridWidth,
+               int gridHeight, bool vsync, bool software);
+  ~WallRenderer();
+
+  WallRenderer(const WallRenderer &) = delete;
+  WallRenderer &operator=(const WallRenderer &) = delete;
+
+  void Render(const std::vector<FrameSnapshot> &frames);
+  void Present();
+  void UpdateWindowTitle(int fps);
+
+private:
+  enum class Tile { kBlock = 0, kPlain };
+
+  void CreateAtlas();
+  void AddQuad(float x, float y, float width, float height, SDL_Color color,
+               Tile tile);
+  void AddBoard(const FrameSnapshot &frame, float x, float y);
+
+  SDL_Window *_window{nullptr};
+  SDL_Renderer *_renderer{nullptr};
+  SDL_Texture *_atlas{nullptr};
+  int _boards;
+  int _gridWidth;
+  int _gridHeight;
+  int _columns{1};  // boards per row of the wall
+  float _cell{1};   // size of a cell in pixels
+  float _originX{0}; // top left corner of the wall, centered in the window
+  float _originY{0};
+  std::vector<SDL_Vertex> _vertices; // rebuilt every frame
+  std::vector<int> _indices;         // fixed, two triangles per quad
+};
+
+#endif
@@ -0,0 +1,194 @@
+// Checks that archives reproduce their games: every game plays from its
+// first piece to its recorded end, seeking to any piece restores the same
+// state as playing up to it from the start, and malformed archives or seeks
+// are rejected.
+//
+//   archive_test [--seed 1]
+
+#include "archive.h"
+#include "check.h"
+#include "replay.h"
+#include "simulation.h"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int kInterval{4}; // pieces per keyframe
+
+std::string ReadFile(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), {});
+}
+
+void WriteFile(const std::string &path, const std::string &data) {
+  std::ofstream(path, std::ios::binary | std::ios::trunc)
+      .write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+std::uint64_t GetU64(const std::string &data, std::size_t at) {
+  std::uint64_t v = 0;
+  for (int i = 0; i < 8; i++)
+    v |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(data[at + i]))
+         << (8 * i);
+  return v;
+}
+
+void PutU32(std::string &data, std::size_t at, std::uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    data[at + i] = static_cast<char>(v >> (8 * i));
+}
+
+// writes games of a random player on grids of several sizes
+bool Generate(const std::string &path, std::mt19937 &rng, int games) {
+  ArchiveWriter writer(kInterval);
+  if (!writer.Open(path))
+    return false;
+  for (int g = 0; g < games; g++) {
+    Simulation simulation(4 + g % 3 * 6, 8 + g % 4 * 10, rng());
+    writer.BeginGame(simulation);
+    while (!simulation.IsGameOver() and simulation.GetTick() < 200000) {
+      Input input;
+      if (rng() % 16 == 0)
+        input.actions = static_cast<std::uint8_t>(rng() % 16);
+      writer.Record(simulation, input);
+      simulation.Step(input);
+    }
+    writer.EndGame(simulation);
+  }
+  return writer.Close();
+}
+
+bool SameState(const Simulation &a, const Simulation &b) {
+  return a.GetTick() == b.GetTick() and a.GetScore() == b.GetScore() and
+         a.GetPieceCount() == b.GetPieceCount() and
+         Replay::HashField(a.GetField()) == Replay::HashField(b.GetField()) and
+         a.GetPiece().GetCenterCellX() == b.GetPiece().GetCenterCellX() and
+         a.GetPiece().GetCenterCellY() == b.GetPiece().GetCenterCellY();
+}
+
+// plays every game from its first piece to the end, seeks to each of its
+// pieces and compares the state with the one reached from the start
+void CheckSeeks(const std::string &path) {
+  ArchiveReader reader;
+  if (!Check::That(reader.Open(path), "open archive"))
+    return;
+  for (int g = 0; g < reader.GetGameCount(); g++) {
+    std::string name = "game " + std::to_string(g);
+    ArchiveReader::GameInfo info = reader.GetGame(g);
+    ArchiveReader::Cursor cursor;
+    std::unique_ptr<Simulation> game = reader.Seek(g, 1, cursor);
+    if (!Check::That(game != nullptr and info.keyframeInterval == kInterval,
+                     name + ": first piece"))
+      continue;
+    for (std::uint64_t piece = 2; piece <= info.pieces; piece++) {
+      while (game->GetPieceCount() < piece and !cursor.IsDone(*game))
+        game->Step(cursor.GetInput(game->GetTick()));
+      ArchiveReader::Cursor seekCursor;
+      std::unique_ptr<Simulation> seek = reader.Seek(g, piece, seekCursor);
+      if (!Check::That(seek != nullptr and SameState(*seek, *game),
+                       name + ": seek to piece " + std::to_string(piece)))
+        break;
+    }
+    while (!cursor.IsDone(*game))
+      game->Step(cursor.GetInput(game->GetTick()));
+    Check::That(cursor.Matches(*game), name + ": recorded end");
+    Check::That(reader.Seek(g, 0, cursor) == nullptr and
+                    reader.Seek(g, info.pieces + 1, cursor) == nullptr,
+                name + ": seek outside the game");
+  }
+  ArchiveReader::Cursor cursor;
+  Check::That(reader.Seek(-1, 1, cursor) == nullptr and
+                  reader.Seek(reader.GetGameCount(), 1, cursor) == nullptr,
+              "seek to a missing game");
+}
+
+// archives are changed in place: the footer at the end holds the offset of
+// the index, whose first entry holds the first game's size and interval
+void CheckMalformed(const std::string &path) {
+  const std::string original = ReadFile(path);
+  ArchiveReader reader;
+  auto open = [&](const std::string &data) {
+    WriteFile(path, data);
+    return reader.Open(path);
+  };
+  Check::That(open(original), "original archive");
+  std::size_t footer = original.size() - Archive::kFooterSize;
+  std::size_t entry = GetU64(original, footer);
+
+  std::string data = original;
+  data[0] = 'X';
+  Check::That(!open(data), "bad magic");
+  data = original;
+  data[footer + 16] = 'X';
+  Check::That(!open(data), "bad footer magic");
+  data = original;
+  PutU32(data, footer, static_cast<std::uint32_t>(original.size()));
+  Check::That(!open(data), "index past the end");
+  data = original;
+  PutU32(data, footer + 8, 1u << 30);
+  Check::That(!open(data), "more games than the index holds");
+  data = original;
+  PutU32(data, entry + 16, 3);
+  Check::That(!open(data), "3 columns");
+  data = original;
+  PutU32(data, entry + 20, 0);
+  Check::That(!open(data), "no rows");
+  data = original;
+  PutU32(data, entry + 28, 0);
+  Check::That(!open(data), "no keyframe interval");
+
+  // the first keyframe of the first game follows the header, a damaged one
+  // opens but cannot be seeked into
+  ArchiveReader::Cursor cursor;
+  auto seeks = [&](const std::string &data) {
+    return open(data) and reader.Seek(0, 1, cursor) != nullptr;
+  };
+  const std::size_t keyframe = Archive::kHeaderSize;
+  Check::That(seeks(original), "seek into the original archive");
+  data = original;
+  PutU32(data, keyframe + 56, 1000);
+  Check::That(!seeks(data), "keyframe piece right of the grid");
+  data = original;
+  PutU32(data, keyframe + 56, static_cast<std::uint32_t>(-1));
+  Check::That(!seeks(data), "keyframe piece left of the grid");
+  data = original;
+  PutU32(data, keyframe + 60, 1000);
+  Check::That(!seeks(data), "keyframe piece below the grid");
+  data = original;
+  data[keyframe + 64] = kNumPieceTypes;
+  Check::That(!seeks(data), "keyframe with an unknown piece");
+  data = original;
+  data[keyframe + 65] = kMaxRotations;
+  Check::That(!seeks(data), "keyframe with an unknown rotation");
+  data = original;
+  data[keyframe + 67] = kNumPieceTypes;
+  Check::That(!seeks(data), "keyframe with an unknown preview");
+  Check::That(!open(original.substr(0, original.size() - 1)),
+              "truncated archive");
+  Check::That(!open(""), "empty archive");
+  std::remove(path.c_str());
+  Check::That(!reader.Open(path), "missing archive");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::uint32_t seed{1};
+  if (!Check::ParseSeed(argc, argv, seed))
+    return 2;
+  std::mt19937 rng(seed);
+  std::string path = Check::TempPath("archive_test.tarc");
+  if (Check::That(Generate(path, rng, 12), "write archive")) {
+    CheckSeeks(path);
+    CheckMalformed(path);
+  }
+  std::remove(path.c_str());
+  return Check::Finish();
+}
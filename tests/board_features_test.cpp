@@ -0,0 +1,123 @@
+// Checks the board features: the scalar computation matches a cell by cell
+// count of every feature, and every vector kernel the CPU supports matches
+// the scalar one.
+//
+//   board_features_test [--seed 1]
+
+#include "board_features.h"
+#include "check.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Row = std::uint64_t;
+
+// features of one board, computed cell by cell
+BoardFeatures NaiveFeatures(const Row *rows, int width, int height) {
+  auto cell = [&](int x, int y) {
+    if (x < 0 or x >= width or y >= height)
+      return true; // the walls and the floor count as filled
+    return y >= 0 and ((rows[y] >> x) & 1) != 0;
+  };
+  std::vector<int> tops(width);
+  for (int x = 0; x < width; x++) {
+    tops[x] = 0;
+    while (tops[x] < height and !cell(x, tops[x]))
+      tops[x]++;
+  }
+  int stackTop = *std::min_element(tops.begin(), tops.end());
+  BoardFeatures f;
+  for (int x = 0; x < width; x++) {
+    int h = height - tops[x];
+    f.aggregateHeight += h;
+    f.maxHeight = std::max(f.maxHeight, h);
+    if (x + 1 < width)
+      f.bumpiness += std::abs(h - (height - tops[x + 1]));
+    for (int y = tops[x]; y < height; y++)
+      f.holes += !cell(x, y);
+    for (int y = stackTop; y <= height; y++)
+      f.columnTransitions += cell(x, y) != cell(x, y - 1);
+  }
+  for (int y = stackTop; y < height; y++) {
+    for (int x = -1; x < width; x++)
+      f.rowTransitions += cell(x, y) != cell(x + 1, y);
+    for (int x = 0; x < width; x++) {
+      auto seen = [&](int c) { return c < 0 or c >= width or y >= tops[c]; };
+      f.wells += !seen(x) and seen(x - 1) and seen(x + 1);
+    }
+  }
+  return f;
+}
+
+bool operator==(const BoardFeatures &a, const BoardFeatures &b) {
+  return a.aggregateHeight == b.aggregateHeight and
+         a.maxHeight == b.maxHeight and a.holes == b.holes and
+         a.bumpiness == b.bumpiness and
+         a.rowTransitions == b.rowTransitions and
+         a.columnTransitions == b.columnTransitions and a.wells == b.wells;
+}
+
+// boards of every stack height with random cells, so every feature occurs
+std::vector<Row> RandomBoards(std::mt19937 &rng, std::size_t count,
+                              int width, int height) {
+  Row full = width >= 64 ? ~Row{0} : (Row{1} << width) - 1;
+  std::vector<Row> boards(count * height);
+  for (std::size_t b = 0; b < count; b++) {
+    int top = static_cast<int>(rng() % (height + 1));
+    for (int y = top; y < height; y++) {
+      Row row = (std::uint64_t{rng()} << 32 | rng()) & full;
+      boards[b * height + y] = row | (rng() % 2 ? row >> 1 : 0);
+    }
+  }
+  return boards;
+}
+
+// counts that leave a partly filled vector are included
+void CheckKernels(std::mt19937 &rng) {
+  const int sizes[][2] = {{4, 8}, {10, 20}, {13, 32}, {64, 24}};
+  for (const auto &size : sizes) {
+    int width = size[0];
+    int height = size[1];
+    std::string name = std::to_string(width) + "x" + std::to_string(height);
+    for (std::size_t count : {1, 2, 3, 37}) {
+      std::vector<Row> boards = RandomBoards(rng, count, width, height);
+      std::vector<BoardFeatures> scalar(count);
+      for (std::size_t b = 0; b < count; b++) {
+        const Row *rows = &boards[b * height];
+        scalar[b] = ComputeFeatures(rows, width, height);
+        Check::That(scalar[b] == NaiveFeatures(rows, width, height),
+                    "features " + name + " board " + std::to_string(b));
+      }
+      for (FeatureKernel kernel : {FeatureKernel::kScalar,
+                                   FeatureKernel::kSse2,
+                                   FeatureKernel::kAvx2}) {
+        if (!IsSupported(kernel))
+          continue;
+        BoardFeatureBatch batch;
+        ComputeFeatures(boards.data(), count, width, height, batch, kernel);
+        bool same = batch.GetSize() == count;
+        for (std::size_t b = 0; same and b < count; b++)
+          same = batch.Get(b) == scalar[b];
+        Check::That(same, std::string("kernel ") +
+                              GetFeatureKernelName(kernel) + " " + name +
+                              " count " + std::to_string(count));
+      }
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::uint32_t seed{1};
+  if (!Check::ParseSeed(argc, argv, seed))
+    return 2;
+  std::mt19937 rng(seed);
+  CheckKernels(rng);
+  return Check::Finish();
+}
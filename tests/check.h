@@ -0,0 +1,76 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+// minimal harness shared by the test executables: each records its checks,
+// prints the failed ones and returns the exit code of its run from Finish
+namespace Check {
+
+inline int checks{0};
+inline int failures{0};
+
+// records one check, prints it if it failed
+inline bool That(bool passed, const std::string &what) {
+  checks++;
+  if (!passed) {
+    failures++;
+    std::cerr << "FAILED: " << what << "\n";
+  }
+  return passed;
+}
+
+// returns true if the function throws std::invalid_argument
+template <typename F> bool Throws(F &&f) {
+  try {
+    f();
+  } catch (const std::invalid_argument &) {
+    return true;
+  }
+  return false;
+}
+
+// reads the optional --seed of a test, returns false after printing the
+// usage if the arguments are anything else
+inline bool ParseSeed(int argc, char **argv, std::uint32_t &seed) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg != "--seed" or i + 1 >= argc) {
+      std::cerr << "usage: " << argv[0] << " [--seed 1]\n";
+      return false;
+    }
+    char *end = nullptr;
+    errno = 0;
+    unsigned long value = std::strtoul(argv[++i], &end, 10);
+    if (end == argv[i] or *end != '\0' or errno != 0 or value > UINT32_MAX) {
+      std::cerr << "usage: " << argv[0] << " [--seed 1]\n";
+      return false;
+    }
+    seed = static_cast<std::uint32_t>(value);
+  }
+  return true;
+}
+
+// returns a path in the temporary directory for a file of this test run
+inline std::string TempPath(const std::string &name) {
+  return (std::filesystem::temp_directory_path() /
+          (std::to_string(getpid()) + "_" + name))
+      .string();
+}
+
+// prints the number of checks passed, returns 1 if any failed
+inline int Finish() {
+  std::cout << checks - failures << " of " << checks << " checks passed\n";
+  return failures == 0 ? 0 : 1;
+}
+
+} // namespace Check
+
+#endif
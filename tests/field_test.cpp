@@ -0,0 +1,223 @@
+// Checks the bitboard field against a naive model of the same rules: random
+// pieces are dropped on fields of several sizes, including tall ones whose
+// clears turn the ring, and after every placement the rows, the skyline and
+// the drop distances of both must be equal, and the field's hash must equal
+// the one of a field set up from scratch. The fixed-size StandardField must
+// behave like a Field of its size.
+//
+//   field_test [--seed 1]
+
+#include "check.h"
+#include "field.h"
+#include "shape.h"
+#include "simulation.h"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Row = Field::Row;
+
+// a grid of one bool per cell, top row first, changed one cell at a time
+class NaiveField {
+public:
+  NaiveField(int width, int height)
+      : _width(width), _height(height),
+        _cells(height, std::vector<bool>(width, false)){};
+
+  int GetWidth() const { return _width; };
+  int GetHeight() const { return _height; };
+
+  Row GetRow(int y) const {
+    Row row{0};
+    for (int x = 0; x < _width; x++)
+      row |= static_cast<Row>(_cells[y][x]) << x;
+    return row;
+  };
+
+  void SetRow(int y, Row row) {
+    for (int x = 0; x < _width; x++)
+      _cells[y][x] = (row >> x) & 1;
+  };
+
+  // cells of the shape with the bounding box at x, y, in field coordinates
+  template <typename F>
+  void ForEachCell(const ShapeMask &shape, int x, int y, F &&f) const {
+    for (int i = 0; i < shape.height; i++) {
+      for (int j = 0; j < shape.width; j++) {
+        if ((shape.rows[i] >> j) & 1)
+          f(x + j, y + i);
+      }
+    }
+  };
+
+  bool Fits(const ShapeMask &shape, int centerX, int centerY) const {
+    bool fits = true;
+    ForEachCell(shape, centerX + shape.left, centerY + shape.top,
+                [&](int x, int y) {
+                  if (x < 0 or x >= _width or y >= _height)
+                    fits = false;
+                  else if (y >= 0 and _cells[y][x])
+                    fits = false;
+                });
+    return fits;
+  };
+
+  int GetDropDistance(const ShapeMask &shape, int centerX,
+                      int centerY) const {
+    int moves{0};
+    while (Fits(shape, centerX, centerY + moves + 1))
+      moves++;
+    return moves;
+  };
+
+  // adds the cells inside the field, then removes every full row and adds
+  // empty rows on top
+  int Place(const ShapeMask &shape, int centerX, int centerY) {
+    ForEachCell(shape, centerX + shape.left, centerY + shape.top,
+                [&](int x, int y) {
+                  if (y >= 0)
+                    _cells[y][x] = true;
+                });
+    std::vector<std::vector<bool>> kept;
+    for (const std::vector<bool> &row : _cells) {
+      if (std::find(row.begin(), row.end(), false) != row.end())
+        kept.push_back(row);
+    }
+    int cleared = _height - static_cast<int>(kept.size());
+    kept.insert(kept.begin(), cleared, std::vector<bool>(_width, false));
+    _cells = kept;
+    return cleared;
+  };
+
+  int GetColumnTop(int x) const {
+    int y = 0;
+    while (y < _height and !_cells[y][x])
+      y++;
+    return y;
+  };
+
+private:
+  int _width;
+  int _height;
+  std::vector<std::vector<bool>> _cells;
+};
+
+// compares every row, the skyline and the hash of a field with the model
+template <typename Board>
+bool Matches(const Board &field, const NaiveField &naive,
+             const std::string &what) {
+  for (int y = 0; y < naive.GetHeight(); y++) {
+    if (!Check::That(field.GetRow(y) == naive.GetRow(y) and
+                         field.GetRows()[y] == naive.GetRow(y),
+                     what + ": row " + std::to_string(y)))
+      return false;
+  }
+  for (int x = 0; x < naive.GetWidth(); x++) {
+    if (!Check::That(field.GetColumnTop(x) == naive.GetColumnTop(x),
+                     what + ": top of column " + std::to_string(x)))
+      return false;
+  }
+  // the hash is kept up to date incrementally, a field set up from scratch
+  // with the same rows must have the same one
+  Field fresh(naive.GetWidth(), naive.GetHeight());
+  std::vector<Row> rows(naive.GetHeight());
+  for (int y = 0; y < naive.GetHeight(); y++)
+    rows[y] = naive.GetRow(y);
+  fresh.SetRows(rows.data());
+  return Check::That(field.GetHash() == fresh.GetHash(), what + ": hash");
+}
+
+// a row with every cell but one or two filled, so placements clear rows
+Row NearlyFullRow(std::mt19937 &rng, int width) {
+  Row full = width >= 64 ? ~Row{0} : (Row{1} << width) - 1;
+  Row row = full & ~(Row{1} << (rng() % width));
+  if (rng() % 2)
+    row &= ~(Row{1} << (rng() % width));
+  return row;
+}
+
+// drops random pieces from random free positions, also below overhangs and
+// deep in the stack so both clearing strategies of the ring run, and checks
+// the field and the model stay equal. Pieces always come to rest as in a
+// game, since clears rely on no empty row lying below an occupied one
+template <typename Board>
+void CheckPlacements(std::mt19937 &rng, int width, int height, int steps) {
+  std::string name = (Board::kFixedSize ? "fixed field " : "field ") +
+                     std::to_string(width) + "x" + std::to_string(height);
+  Board field(width, height);
+  NaiveField naive(width, height);
+  int rowsCleared{0};
+  for (int step = 0; step < steps; step++) {
+    std::string what = name + " step " + std::to_string(step);
+    if (step % 50 == 0) {
+      // refill the lower half with nearly full rows around a shaft, which
+      // lets pieces reach the bottom under a high stack
+      Row shaft = Row{1} << (rng() % width);
+      for (int y = height / 2; y < height; y++) {
+        Row row = NearlyFullRow(rng, width) & ~shaft;
+        field.SetRow(y, row);
+        naive.SetRow(y, row);
+      }
+      if (!Matches(field, naive, what + " after SetRow"))
+        return;
+    }
+    const PieceShapes &shapes =
+        GetPieceShapes(static_cast<PieceType>(rng() % kNumPieceTypes));
+    const ShapeMask &shape = shapes.masks[rng() % shapes.rotations];
+    int x = static_cast<int>(rng() % (width + 4)) - 2;
+    int y = static_cast<int>(rng() % (height + 4)) - 3;
+    bool fits = field.Fits(shape, x, y);
+    if (!Check::That(fits == naive.Fits(shape, x, y), what + ": Fits"))
+      return;
+    if (!fits)
+      continue;
+    int drop = field.GetDropDistance(shape, x, y);
+    if (!Check::That(drop == naive.GetDropDistance(shape, x, y),
+                     what + ": GetDropDistance"))
+      return;
+    y += drop;
+    int cleared = field.Place(shape, x, y);
+    rowsCleared += cleared;
+    if (!Check::That(cleared == naive.Place(shape, x, y),
+                     what + ": rows cleared") or
+        !Check::That(field.GetRowsCleared() == rowsCleared,
+                     what + ": GetRowsCleared") or
+        !Matches(field, naive, what))
+      return;
+  }
+}
+
+// grids narrower than Field::kMinWidth spawn pieces outside of the field, so
+// neither a field nor a simulation can have one
+void CheckSizes() {
+  Check::That(Check::Throws([] { Field(3, 20); }), "Field 3 wide");
+  Check::That(Check::Throws([] { Field(65, 20); }), "Field 65 wide");
+  Check::That(Check::Throws([] { Field(10, 0); }), "Field without rows");
+  Check::That(!Check::Throws([] { Field(4, 1); }), "Field 4x1");
+  Check::That(Check::Throws([] { Simulation(3, 20, 1); }),
+              "Simulation 3 wide");
+  Check::That(Check::Throws([] { StandardField(10, 21); }),
+              "StandardField 10x21");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::uint32_t seed{1};
+  if (!Check::ParseSeed(argc, argv, seed))
+    return 2;
+  std::mt19937 rng(seed);
+  CheckSizes();
+  CheckPlacements<Field>(rng, 4, 8, 4000);
+  CheckPlacements<Field>(rng, 10, 20, 4000);
+  CheckPlacements<StandardField>(rng, 10, 20, 4000);
+  CheckPlacements<Field>(rng, 64, 40, 4000);
+  // tall fields, where clears low in the stack turn the ring
+  CheckPlacements<Field>(rng, 7, 100, 4000);
+  CheckPlacements<Field>(rng, 10, 400, 4000);
+  return Check::Finish();
+}
@@ -0,0 +1,180 @@
+// Checks that a GameState restores a game exactly: a restored simulation
+// continues like the one it was saved from, also after a round trip through
+// a checkpoint file, and states that cannot be restored are rejected without
+// changing the simulation.
+//
+//   game_state_test [--seed 1]
+
+#include "check.h"
+#include "checkpoint.h"
+#include "game_state.h"
+#include "simulation.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// steps a simulation with a random player
+void Play(Simulation &simulation, std::mt19937 &rng, int ticks) {
+  for (int i = 0; i < ticks and !simulation.IsGameOver(); i++) {
+    Input input;
+    input.actions = static_cast<std::uint8_t>(rng() % 16);
+    simulation.Step(input);
+  }
+}
+
+bool SameGame(const Simulation &a, const Simulation &b) {
+  const Field &fa = a.GetField();
+  const Field &fb = b.GetField();
+  if (fa.GetWidth() != fb.GetWidth() or fa.GetHeight() != fb.GetHeight())
+    return false;
+  for (int y = 0; y < fa.GetHeight(); y++) {
+    if (fa.GetRow(y) != fb.GetRow(y))
+      return false;
+  }
+  return a.GetTick() == b.GetTick() and a.GetScore() == b.GetScore() and
+         a.GetRowsCleared() == b.GetRowsCleared() and
+         a.GetPieceCount() == b.GetPieceCount() and
+         a.GetPiece().GetType() == b.GetPiece().GetType() and
+         a.GetPiece().GetRotation() == b.GetPiece().GetRotation() and
+         a.GetPiece().GetCenterCellX() == b.GetPiece().GetCenterCellX() and
+         a.GetPiece().GetCenterCellY() == b.GetPiece().GetCenterCellY() and
+         a.IsGameOver() == b.IsGameOver();
+}
+
+// a restored simulation continues exactly like the original, and saving it
+// again gives the same bytes
+void CheckRoundTrips(std::mt19937 &rng) {
+  for (std::uint32_t seed = 1; seed <= 20; seed++) {
+    std::string name = "seed " + std::to_string(seed);
+    Simulation original(4 + seed % 10, 8 + seed % 24, seed);
+    Play(original, rng, static_cast<int>(rng() % 20000));
+    GameState saved{};
+    if (!Check::That(original.Save(saved), name + ": Save"))
+      continue;
+    Simulation restored(saved);
+    GameState again{};
+    restored.Save(again);
+    Check::That(std::memcmp(&saved, &again, sizeof(GameState)) == 0,
+                name + ": saved twice");
+    Check::That(SameGame(original, restored), name + ": restored");
+    std::mt19937 inputs(seed);
+    Play(original, inputs, 5000);
+    inputs.seed(seed);
+    Play(restored, inputs, 5000);
+    Check::That(SameGame(original, restored), name + ": continued");
+    // restoring into a simulation of another size replaces its field
+    Simulation other(12, 30, seed + 1);
+    other.Restore(saved);
+    Check::That(SameGame(Simulation(saved), other),
+                name + ": restored in place");
+  }
+  GameState tall{};
+  Check::That(!Simulation(10, GameState::kMaxHeight + 1, 1).Save(tall),
+              "Save of a field taller than a GameState");
+}
+
+// a checkpoint reads back the state it was written with, and damaged files
+// or states that cannot be restored are rejected
+void CheckCheckpoints(std::mt19937 &rng) {
+  std::string path = Check::TempPath("game_state_test.ckpt");
+  Simulation simulation(10, 20, 7);
+  Play(simulation, rng, 3000);
+  GameState state{};
+  simulation.Save(state);
+  GameState read{};
+  Check::That(Checkpoint::Write(path, state) and
+                  Checkpoint::Read(path, read) and
+                  std::memcmp(&state, &read, sizeof(GameState)) == 0,
+              "checkpoint round trip");
+
+  std::vector<char> bytes;
+  {
+    std::ifstream in(path, std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(in), {});
+  }
+  auto readDamaged = [&](const std::vector<char> &damaged) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc)
+        .write(damaged.data(), static_cast<std::streamsize>(damaged.size()));
+    return Checkpoint::Read(path, read);
+  };
+  std::vector<char> flipped = bytes;
+  flipped[bytes.size() / 2] ^= 1;
+  Check::That(!readDamaged(flipped), "checkpoint with a flipped bit");
+  std::vector<char> truncated(bytes.begin(), bytes.end() - 1);
+  Check::That(!readDamaged(truncated), "truncated checkpoint");
+  Check::That(!readDamaged({}), "empty checkpoint");
+
+  GameState narrow = state;
+  narrow.width = 3;
+  Check::That(Checkpoint::Write(path, narrow) and
+                  !Checkpoint::Read(path, read),
+              "checkpoint of a 3 column grid");
+  std::remove(path.c_str());
+  Check::That(!Checkpoint::Read(path, read), "missing checkpoint");
+}
+
+// states that cannot be restored throw without changing the simulation
+void CheckInvalidStates() {
+  Simulation simulation(10, 20, 1);
+  GameState state{};
+  simulation.Save(state);
+  Check::That(Simulation::CanRestore(state), "CanRestore of a saved state");
+  std::vector<std::pair<std::string, GameState>> bad;
+  bad.emplace_back("3 columns", state);
+  bad.back().second.width = 3;
+  bad.emplace_back("too many rows", state);
+  bad.back().second.height = GameState::kMaxHeight + 1;
+  bad.emplace_back("no rows", state);
+  bad.back().second.height = 0;
+  bad.emplace_back("unknown piece", state);
+  bad.back().second.pieceType = static_cast<PieceType>(kNumPieceTypes);
+  bad.emplace_back("unknown preview", state);
+  bad.back().second.preview[2] = static_cast<PieceType>(kNumPieceTypes);
+  bad.emplace_back("unknown rotation", state);
+  bad.back().second.pieceRotation = kMaxRotations;
+  bad.emplace_back("piece left of the grid", state);
+  bad.back().second.pieceX = -3;
+  bad.emplace_back("piece right of the grid", state);
+  bad.back().second.pieceX = state.width;
+  bad.emplace_back("piece below the grid", state);
+  bad.back().second.pieceY = state.height;
+  bad.emplace_back("piece far below the grid", state);
+  bad.back().second.pieceY = 30000;
+  bad.emplace_back("piece overlapping the stack", state);
+  for (int y = 0; y < state.height; y++)
+    bad.back().second.rows[y] = 0x2FF;
+  // the piece that ended a game overlaps the stack
+  GameState over = bad.back().second;
+  over.gameOver = 1;
+  Check::That(Simulation::CanRestore(over), "CanRestore of a game over");
+  for (const auto &[name, invalid] : bad) {
+    Check::That(!Simulation::CanRestore(invalid), name + ": CanRestore");
+    Check::That(Check::Throws([&] { Simulation restored(invalid); }),
+                name + ": constructor");
+    Check::That(Check::Throws([&] { simulation.Restore(invalid); }),
+                name + ": Restore");
+    GameState after{};
+    simulation.Save(after);
+    Check::That(std::memcmp(&state, &after, sizeof(GameState)) == 0,
+                name + ": Restore changed the simulation");
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::uint32_t seed{1};
+  if (!Check::ParseSeed(argc, argv, seed))
+    return 2;
+  std::mt19937 rng(seed);
+  CheckRoundTrips(rng);
+  CheckCheckpoints(rng);
+  CheckInvalidStates();
+  return Check::Finish();
+}
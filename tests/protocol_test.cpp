@@ -0,0 +1,219 @@
+// Checks the messages between the server and its clients: joins, inputs and
+// deltas decode to what was encoded, a client applying the deltas of a game
+// keeps the same rows as the game, and malformed or incomplete messages are
+// rejected.
+//
+//   protocol_test [--seed 1]
+
+#include "check.h"
+#include "game_state.h"
+#include "protocol.h"
+#include "simulation.h"
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Protocol::MessageType;
+
+// the only complete message of a stream
+bool ReadMessage(const std::string &stream, MessageType &type,
+                 const std::uint8_t *&payload, std::size_t &size) {
+  std::size_t offset = 0;
+  return Protocol::NextMessage(stream, offset, type, payload, size) and
+         offset == stream.size();
+}
+
+void CheckJoinAndInput() {
+  for (Protocol::Join join : {Protocol::Join{7, 4, 4},
+                              Protocol::Join{0xdeadbeef, 10, 20},
+                              Protocol::Join{1, 64, Protocol::kMaxRows}}) {
+    std::string stream;
+    Protocol::EncodeJoin(stream, join);
+    MessageType type;
+    const std::uint8_t *payload;
+    std::size_t size;
+    Protocol::Join decoded;
+    Check::That(stream.size() == Protocol::kJoinSize and
+                    ReadMessage(stream, type, payload, size) and
+                    type == MessageType::kJoin and
+                    Protocol::DecodeJoin(payload, size, decoded) and
+                    decoded.seed == join.seed and
+                    decoded.width == join.width and
+                    decoded.height == join.height,
+                "join " + std::to_string(join.width) + "x" +
+                    std::to_string(join.height));
+  }
+  std::string stream;
+  Protocol::EncodeInput(stream, 0x5);
+  MessageType type;
+  const std::uint8_t *payload;
+  std::size_t size;
+  Check::That(stream.size() == Protocol::kInputSize and
+                  ReadMessage(stream, type, payload, size) and
+                  type == MessageType::kInput and size == 1 and
+                  payload[0] == 0x5,
+              "input");
+}
+
+// joins for grids the server cannot host, or of the wrong size
+void CheckMalformedJoins() {
+  const Protocol::Join bad[] = {{1, Protocol::kMinWidth - 1, 20},
+                                {1, 65, 20},
+                                {1, 10, Protocol::kMinHeight - 1},
+                                {1, 10, Protocol::kMaxRows + 1}};
+  for (const Protocol::Join &join : bad) {
+    std::string stream;
+    Protocol::EncodeJoin(stream, join);
+    MessageType type;
+    const std::uint8_t *payload;
+    std::size_t size;
+    Protocol::Join decoded;
+    Check::That(ReadMessage(stream, type, payload, size) and
+                    !Protocol::DecodeJoin(payload, size, decoded),
+                "join " + std::to_string(join.width) + "x" +
+                    std::to_string(join.height));
+  }
+  std::string stream;
+  Protocol::EncodeJoin(stream, {1, 10, 20});
+  const auto *payload = reinterpret_cast<const std::uint8_t *>(
+      stream.data() + Protocol::kLengthSize + 1);
+  std::size_t size = stream.size() - Protocol::kLengthSize - 1;
+  Protocol::Join decoded;
+  Check::That(!Protocol::DecodeJoin(payload, size - 1, decoded) and
+                  !Protocol::DecodeJoin(payload, size + 1, decoded),
+              "join of the wrong size");
+}
+
+// a client applying every delta of a game has the game's rows, piece and
+// score after each one. Grids up to 16 columns send two bytes per row
+void CheckDeltas(std::mt19937 &rng) {
+  const int sizes[][2] = {{10, 20}, {16, 32}, {17, 8}, {64, 32}};
+  for (const auto &size : sizes) {
+    int width = size[0];
+    int height = size[1];
+    std::string name = std::to_string(width) + "x" + std::to_string(height);
+    Simulation simulation(width, height, rng());
+    GameState sent{};
+    simulation.Save(sent);
+    std::vector<Field::Row> rows(height, ~Field::Row{0});
+    std::uint32_t inputs{0};
+    std::uint32_t sentInputs{0};
+    std::uint8_t flags = Protocol::kReset;
+    bool same{true};
+    int deltas{0};
+    while (same and !simulation.IsGameOver() and
+           simulation.GetTick() < 100000) {
+      Input input;
+      if (rng() % 8 == 0) {
+        input.actions = static_cast<std::uint8_t>(rng() % 16);
+        inputs++;
+      }
+      simulation.Step(input);
+      if (simulation.GetTick() % 16 != 0)
+        continue;
+      GameState current{};
+      simulation.Save(current);
+      std::string stream;
+      if (!Protocol::EncodeDelta(stream, sent, sentInputs, current, inputs,
+                                 flags)) {
+        same = stream.empty();
+        continue;
+      }
+      MessageType type;
+      const std::uint8_t *payload;
+      std::size_t payloadSize;
+      Protocol::Delta delta;
+      same = ReadMessage(stream, type, payload, payloadSize) and
+             type == MessageType::kDelta and
+             Protocol::DecodeDelta(payload, payloadSize, width, height, delta,
+                                   rows.data()) and
+             delta.flags == flags and delta.inputsApplied == inputs and
+             delta.pieceType == current.pieceType and
+             delta.pieceX == current.pieceX and
+             delta.pieceY == current.pieceY and
+             delta.score == current.score;
+      for (int y = 0; same and y < height; y++)
+        same = rows[y] == current.rows[y];
+      sent = current;
+      sentInputs = inputs;
+      flags = 0;
+      deltas++;
+    }
+    Check::That(same and deltas > 0, "deltas " + name);
+    GameState current{};
+    simulation.Save(current);
+    std::string stream;
+    Check::That(!Protocol::EncodeDelta(stream, current, inputs, current,
+                                       inputs, 0) and
+                    stream.empty(),
+                "unchanged state " + name);
+  }
+}
+
+// a delta with rows below the grid or of the wrong length is rejected
+void CheckMalformedDeltas() {
+  Simulation simulation(10, 20, 3);
+  GameState state{};
+  simulation.Save(state);
+  std::string stream;
+  Protocol::EncodeDelta(stream, state, 0, state, 0, Protocol::kReset);
+  const auto *payload = reinterpret_cast<const std::uint8_t *>(
+      stream.data() + Protocol::kLengthSize + 1);
+  std::size_t size = stream.size() - Protocol::kLengthSize - 1;
+  std::vector<Field::Row> rows(32);
+  Protocol::Delta delta;
+  Check::That(Protocol::DecodeDelta(payload, size, 10, 20, delta, rows.data()),
+              "reset delta");
+  Check::That(!Protocol::DecodeDelta(payload, size, 10, 19, delta,
+                                     rows.data()),
+              "delta with rows below the grid");
+  Check::That(!Protocol::DecodeDelta(payload, size - 1, 10, 20, delta,
+                                     rows.data()) and
+                  !Protocol::DecodeDelta(payload, size + 1, 10, 20, delta,
+                                         rows.data()) and
+                  !Protocol::DecodeDelta(payload, 3, 10, 20, delta,
+                                         rows.data()),
+              "delta of the wrong size");
+}
+
+// a stream holds messages back to back and may end inside one
+void CheckStreams() {
+  std::string stream;
+  Protocol::EncodeJoin(stream, {1, 10, 20});
+  Protocol::EncodeInput(stream, 1);
+  Protocol::EncodeInput(stream, 2);
+  std::string partial = stream.substr(0, stream.size() - 1);
+  std::size_t offset = 0;
+  MessageType type;
+  const std::uint8_t *payload;
+  std::size_t size;
+  int messages{0};
+  while (Protocol::NextMessage(partial, offset, type, payload, size))
+    messages++;
+  Check::That(messages == 2 and
+                  offset == Protocol::kJoinSize + Protocol::kInputSize,
+              "stream ending inside a message");
+  offset = 0;
+  Check::That(!Protocol::NextMessage(std::string(3, '\0'), offset, type,
+                                     payload, size) and
+                  offset == 0,
+              "message of length 0");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::uint32_t seed{1};
+  if (!Check::ParseSeed(argc, argv, seed))
+    return 2;
+  std::mt19937 rng(seed);
+  CheckJoinAndInput();
+  CheckMalformedJoins();
+  CheckDeltas(rng);
+  CheckMalformedDeltas();
+  CheckStreams();
+  return Check::Finish();
+}
@@ -0,0 +1,131 @@
+// Checks that replays reproduce their games: a recorded game loads with the
+// inputs it was recorded with and plays back to the recorded final state,
+// and malformed or damaged files are rejected or fail the playback.
+//
+//   replay_test [--seed 1]
+
+#include "check.h"
+#include "replay.h"
+#include "replay_writer.h"
+#include "simulation.h"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string ReadFile(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(in), {});
+}
+
+void WriteFile(const std::string &path, const std::string &data) {
+  std::ofstream(path, std::ios::binary | std::ios::trunc)
+      .write(data.data(), static_cast<std::streamsize>(data.size()));
+}
+
+// records a game of a random player, returns its inputs
+std::vector<Replay::Event> Record(const std::string &path, int width,
+                                  int height, std::uint32_t seed,
+                                  std::mt19937 &rng) {
+  Simulation simulation(width, height, seed);
+  ReplayWriter writer;
+  std::vector<Replay::Event> events;
+  if (!Check::That(writer.Open(path, simulation), "open " + path))
+    return events;
+  for (int i = 0; i < 30000 and !simulation.IsGameOver(); i++) {
+    Input input;
+    if (rng() % 8 == 0)
+      input.actions = static_cast<std::uint8_t>(rng() % 16);
+    if (input.actions != 0)
+      events.push_back({simulation.GetTick(), input.actions});
+    writer.Record(simulation.GetTick(), input);
+    simulation.Step(input);
+  }
+  writer.Close(simulation);
+  return events;
+}
+
+// the replay of a game loads with its inputs and plays back to its end
+void CheckRoundTrips(std::mt19937 &rng, const std::string &path) {
+  const int sizes[][2] = {{4, 8}, {10, 20}, {64, 300}};
+  for (const auto &size : sizes) {
+    std::uint32_t seed = rng();
+    std::string name = std::to_string(size[0]) + "x" + std::to_string(size[1]);
+    std::vector<Replay::Event> events =
+        Record(path, size[0], size[1], seed, rng);
+    Replay replay;
+    if (!Check::That(Replay::Load(path, replay), name + ": Load"))
+      continue;
+    bool sameEvents = replay.events.size() == events.size();
+    for (std::size_t i = 0; sameEvents and i < events.size(); i++)
+      sameEvents = replay.events[i].tick == events[i].tick and
+                   replay.events[i].actions == events[i].actions;
+    Check::That(replay.width == size[0] and replay.height == size[1] and
+                    replay.seed == seed and replay.finished and sameEvents,
+                name + ": loaded replay");
+    Simulation simulation(replay.width, replay.height, replay.seed);
+    Check::That(ReplayPlayer::Run(replay, simulation), name + ": playback");
+  }
+}
+
+// files are changed in place: the header is the magic, the version byte and
+// the width, height and seed as varints
+void CheckMalformed(std::mt19937 &rng, const std::string &path) {
+  Record(path, 10, 20, 5, rng);
+  const std::string original = ReadFile(path);
+  Replay replay;
+  auto load = [&](const std::string &data) {
+    WriteFile(path, data);
+    return Replay::Load(path, replay);
+  };
+  auto play = [&]() {
+    Simulation simulation(replay.width, replay.height, replay.seed);
+    return ReplayPlayer::Run(replay, simulation);
+  };
+  Check::That(load(original) and play(), "original replay");
+
+  std::string data = original;
+  data[0] = 'X';
+  Check::That(!load(data), "bad magic");
+  data = original;
+  data[4] = static_cast<char>(Replay::kVersion + 1);
+  Check::That(!load(data), "unknown version");
+  data = original;
+  data[5] = 3;
+  Check::That(!load(data), "3 columns");
+  data = original;
+  data[6] = 0;
+  Check::That(!load(data), "no rows");
+  data = original.substr(0, 5) + std::string(11, '\xff');
+  Check::That(!load(data), "varint longer than 64 bits");
+  Check::That(!load(original.substr(0, 3)), "truncated magic");
+  Check::That(!load(original.substr(0, original.size() - 3)),
+              "truncated field hash");
+  Check::That(load(original.substr(0, original.size() / 2)) and
+                  !replay.finished and !play(),
+              "replay cut short");
+  data = original;
+  data.back() ^= 1;
+  Check::That(load(data) and !play(), "wrong field hash");
+  std::remove(path.c_str());
+  Check::That(!Replay::Load(path, replay), "missing replay");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::uint32_t seed{1};
+  if (!Check::ParseSeed(argc, argv, seed))
+    return 2;
+  std::mt19937 rng(seed);
+  std::string path = Check::TempPath("replay_test.trpl");
+  CheckRoundTrips(rng, path);
+  CheckMalformed(rng, path);
+  std::remove(path.c_str());
+  return Check::Finish();
+}
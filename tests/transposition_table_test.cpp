@@ -0,0 +1,90 @@
+// Checks the transposition table: stored entries are found again with their
+// values, other keys miss, a full bucket replaces the entries of older
+// searches first, and keys tell placements and fields apart.
+//
+//   transposition_table_test [--seed 1]
+
+#include "check.h"
+#include "field.h"
+#include "transposition_table.h"
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+void CheckEntries(std::mt19937 &rng) {
+  TranspositionTable table(1 << 16);
+  Check::That(table.GetCapacity() == 1 << 16, "capacity");
+  std::vector<std::uint64_t> keys(1000);
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    keys[i] = (std::uint64_t{rng()} << 32) | rng();
+    table.Store(keys[i], {i * 0.5, static_cast<int>(i % 50) - 3,
+                          static_cast<int>(i % 5)});
+  }
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    TranspositionTable::Entry entry;
+    bool found = table.Probe(keys[i], entry);
+    Check::That(found and entry.score == i * 0.5 and
+                    entry.y == static_cast<int>(i % 50) - 3 and
+                    entry.lines == static_cast<int>(i % 5),
+                "entry " + std::to_string(i));
+    Check::That(!table.Probe(keys[i] ^ 1, entry),
+                "miss " + std::to_string(i));
+  }
+}
+
+// all keys of a table with one bucket share it
+void CheckReplacement() {
+  TranspositionTable bucket(TranspositionTable::kWays);
+  for (int i = 0; i < TranspositionTable::kWays; i++)
+    bucket.Store(i + 1, {static_cast<double>(i), 0, 0});
+  bucket.NewGeneration();
+  TranspositionTable::Entry entry;
+  bucket.Store(2, {5, 0, 0}); // refreshes an entry
+  bucket.Store(100, {6, 0, 0});
+  Check::That(bucket.Probe(2, entry) and entry.score == 5, "refreshed entry");
+  Check::That(bucket.Probe(100, entry) and entry.score == 6, "new entry");
+  int kept{0};
+  for (std::uint64_t key : {1, 3, 4})
+    kept += bucket.Probe(key, entry);
+  Check::That(kept == 2, "replaced one old entry");
+}
+
+// equal fields give equal keys however they were set up, any change to the
+// placement or the field another one
+void CheckKeys() {
+  Field a(10, 20);
+  Field b(10, 20);
+  Field::Row rows[20] = {};
+  rows[19] = 0x1ef;
+  a.SetRows(rows);
+  b.SetRow(19, 0x1ef);
+  std::uint64_t key = TranspositionTable::Key(a, PieceType::kT, 1, 4, 0);
+  Check::That(key == TranspositionTable::Key(b, PieceType::kT, 1, 4, 0),
+              "key of equal fields");
+  Check::That(
+      key != TranspositionTable::Key(a, PieceType::kT, 2, 4, 0) and
+          key != TranspositionTable::Key(a, PieceType::kT, 1, 5, 0) and
+          key != TranspositionTable::Key(a, PieceType::kT, 1, 4, 1) and
+          key != TranspositionTable::Key(a, PieceType::kJ, 1, 4, 0) and
+          key != TranspositionTable::Key(Field(10, 20), PieceType::kT, 1, 4,
+                                         0) and
+          key != TranspositionTable::Key(Field(10, 21), PieceType::kT, 1, 4,
+                                         0),
+      "keys of other placements");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::uint32_t seed{1};
+  if (!Check::ParseSeed(argc, argv, seed))
+    return 2;
+  std::mt19937 rng(seed);
+  CheckEntries(rng);
+  CheckReplacement();
+  CheckKeys();
+  return Check::Finish();
+}